@@ -13,9 +13,20 @@ struct ConfData {
 	std::string sepper;
 	bool header;
 	int lenUnit;
+	size_t sparseDim;
 
 	bool normalize;
 	bool shuffle;
+	bool dataCache; // reuse/write a binary cache of the parsed text data file
+	std::string dataCacheDir; // directory of the cache, empty means next to the data file
+	bool dataByteRange; // each worker reads a contiguous byte range of the data file
+	size_t dataStreamChunk; // out-of-core mode: bytes per chunk of the sliding window, 0 means off
+	std::string dataType; // storage type of x: double, float, uint8, int8
+	bool dataPipeline; // gather the next mini-batch on a helper thread
+	std::string dataOrder; // order of visiting the data in each epoch: sequential, point, block
+	size_t dataOrderBlock; // bytes per block for the block order
+	size_t nThread; // threads computing the gradient in each worker
+	bool float32; // compute in float32 where the kernel supports it, send parameters and deltas in float32
 
 	std::string fnOutput;
 	bool binary;
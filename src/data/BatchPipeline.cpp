@@ -0,0 +1,75 @@
+#include "BatchPipeline.h"
+#include <algorithm>
+
+using namespace std;
+
+BatchPipeline::BatchPipeline(const DataHolder* src, const bool toDouble, const DataOrder* order)
+	: src(src), order(order), toDouble(toDouble)
+{
+	th = thread(&BatchPipeline::run, this);
+}
+
+BatchPipeline::~BatchPipeline()
+{
+	{
+		lock_guard<mutex> lk(mtx);
+		stop = true;
+	}
+	cv.notify_all();
+	th.join();
+}
+
+const DataHolder& BatchPipeline::fetch(const size_t start, const size_t cnt)
+{
+	const size_t n = start < src->size() ? min(cnt, src->size() - start) : 0;
+	unique_lock<mutex> lk(mtx);
+	cv.wait(lk, [&](){ return !busy; });
+	size_t next = 1 - cur;
+	if(prepared && nextStart == start && buf[next].size() >= n){
+		++nhit;
+	} else{
+		if(order == nullptr || order->isSequential())
+			src->hint(start, n);
+		buf[next].gather(*src, start, n, toDouble, order);
+		++nmiss;
+	}
+	cur = next;
+	// prepare the following batch. a batch cut at the end of the data set is followed by
+	// the rest of it, so the size is the largest one asked so far
+	nextStart = src->size() == 0 ? 0 : (start + n) % src->size();
+	nextCnt = max(nextCnt, cnt);
+	prepared = false;
+	busy = true;
+	lk.unlock();
+	cv.notify_all();
+	return buf[cur];
+}
+
+void BatchPipeline::invalidate()
+{
+	unique_lock<mutex> lk(mtx);
+	cv.wait(lk, [&](){ return !busy; });
+	prepared = false;
+}
+
+void BatchPipeline::run()
+{
+	while(true){
+		unique_lock<mutex> lk(mtx);
+		cv.wait(lk, [&](){ return stop || (busy && !prepared); });
+		if(stop)
+			break;
+		DataHolder& dst = buf[1 - cur];
+		const size_t start = nextStart;
+		const size_t n = min(nextCnt, src->size() - start);
+		lk.unlock();
+		if(order == nullptr || order->isSequential())
+			src->hint(start, n);
+		dst.gather(*src, start, n, toDouble, order);
+		lk.lock();
+		prepared = true;
+		busy = false;
+		lk.unlock();
+		cv.notify_all();
+	}
+}
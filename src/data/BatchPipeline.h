@@ -0,0 +1,48 @@
+#pragma once
+#include "DataHolder.h"
+#include "DataOrder.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Stages mini-batches for a trainer. While the current batch is used, the next one is gathered
+// on a helper thread into a contiguous staging DataHolder (dequantized to double if asked).
+// A batch is the points [start, start+cnt) of the source, cut at the end of the data set.
+// With a DataOrder, the positions [start, start+cnt) of the order are used instead.
+// The next batch is guessed to start where the current one ends, with the largest size asked
+// so far. A batch not covered by the guess is gathered on the calling thread.
+class BatchPipeline {
+	const DataHolder* src;
+	const DataOrder* order;
+	bool toDouble;
+	DataHolder buf[2]; // buf[cur] is returned by the last fetch(), the other one is being prepared
+	size_t cur = 0;
+
+	std::thread th;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool stop = false;
+	bool busy = false; // the helper is preparing a batch
+	bool prepared = false; // buf[1-cur] holds the points from <nextStart>
+	size_t nextStart = 0, nextCnt = 0;
+	size_t nhit = 0, nmiss = 0;
+
+public:
+	BatchPipeline(const DataHolder* src, const bool toDouble, const DataOrder* order = nullptr);
+	~BatchPipeline();
+	BatchPipeline(const BatchPipeline&) = delete;
+	BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+	// the points [start, start+cnt) of the source, as points [0, cnt) of the result.
+	// it stays valid until the next call
+	const DataHolder& fetch(const size_t start, const size_t cnt);
+	// drop the prepared batch, call it before changing the order
+	void invalidate();
+
+	// number of batches that were / were not prepared in advance
+	size_t hitCount() const { return nhit; }
+	size_t missCount() const { return nmiss; }
+
+private:
+	void run();
+};
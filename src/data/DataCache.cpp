@@ -0,0 +1,248 @@
+#include "DataCache.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static_assert(sizeof(size_t) == sizeof(uint64_t), "cache stores offsets as 64-bit integers");
+
+namespace {
+
+const char MAGIC[8] = { 'P', 'S', 'G', 'D', 'D', 'A', 'T', 'A' };
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t varx;
+	uint64_t nx, ny;
+	uint64_t count; // number of data points
+	uint64_t xlength; // number of x values of all data points
+	uint64_t npart, pid, localOnly, topk;
+	uint64_t srcSize;
+	int64_t srcMTime; // in nanoseconds
+	uint64_t paramHash; // format, separator, skips, yIds, header, unit, partition mode
+};
+
+// FNV-1a
+uint64_t hashBytes(uint64_t h, const void* p, const size_t n){
+	const unsigned char* c = static_cast<const unsigned char*>(p);
+	for(size_t i = 0; i < n; ++i){
+		h ^= c[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+uint64_t hashParam(const DataCacheKey& key){
+	uint64_t h = 14695981039346656037ull;
+	auto addString = [&](const string& s){
+		uint64_t l = s.size();
+		h = hashBytes(h, &l, sizeof(l));
+		h = hashBytes(h, s.data(), s.size());
+	};
+	auto addList = [&](const vector<int>& v){
+		uint64_t l = v.size();
+		h = hashBytes(h, &l, sizeof(l));
+		h = hashBytes(h, v.data(), v.size() * sizeof(int));
+	};
+	addString(key.format);
+	addString(key.sepper);
+	addList(key.skips);
+	addList(key.yIds);
+	int64_t t = key.header ? 1 : 0;
+	h = hashBytes(h, &t, sizeof(t));
+	t = key.lunit;
+	h = hashBytes(h, &t, sizeof(t));
+	t = key.byteRange ? 1 : 0;
+	h = hashBytes(h, &t, sizeof(t));
+	return h;
+}
+
+bool statSource(const string& fpath, uint64_t& size, int64_t& mtime){
+	struct stat st;
+	if(stat(fpath.c_str(), &st) != 0)
+		return false;
+	size = static_cast<uint64_t>(st.st_size);
+	mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+// fill the fields that do not depend on the content
+bool makeHeader(CacheHeader& h, const string& fpath, const DataCacheKey& key){
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = DataCache::VERSION;
+	h.npart = key.npart;
+	h.pid = key.pid;
+	h.localOnly = key.localOnly ? 1 : 0;
+	h.topk = key.topk;
+	h.paramHash = hashParam(key);
+	return statSource(fpath, h.srcSize, h.srcMTime);
+}
+
+bool sameSource(const CacheHeader& a, const CacheHeader& b){
+	return memcmp(a.magic, b.magic, sizeof(a.magic)) == 0 && a.version == b.version
+		&& a.npart == b.npart && a.pid == b.pid && a.localOnly == b.localOnly && a.topk == b.topk
+		&& a.srcSize == b.srcSize && a.srcMTime == b.srcMTime && a.paramHash == b.paramHash;
+}
+
+string tempPath(const string& cpath){
+	return cpath + ".tmp" + to_string(getpid());
+}
+
+} // namespace
+
+std::string DataCache::cachePath(const std::string& fpath, const DataCacheKey& key)
+{
+	string base = fpath;
+	if(!key.dir.empty()){
+		const size_t p = fpath.find_last_of('/');
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx",
+			static_cast<unsigned long long>(hashBytes(14695981039346656037ull, fpath.data(), fpath.size())));
+		base = key.dir + '/' + (p == string::npos ? fpath : fpath.substr(p + 1)) + "." + hash;
+	}
+	if(key.localOnly)
+		return base + (key.byteRange ? ".b" : ".p") + to_string(key.pid) + "-" + to_string(key.npart) + ".cache";
+	return base + ".cache";
+}
+
+bool DataCache::load(DataHolder& dh, const std::string& fpath, const DataCacheKey& key)
+{
+	CacheHeader expect;
+	if(!makeHeader(expect, fpath, key))
+		return false;
+	auto file = make_shared<MappedFile>();
+	// private writable mapping: normalize() may change the data in memory, the file stays intact
+	if(!file->open(cachePath(fpath, key), true) || file->size() < sizeof(CacheHeader))
+		return false;
+	CacheHeader h;
+	memcpy(&h, file->data(), sizeof(h));
+	if(!sameSource(h, expect) || (h.varx != 0) != dh.varx)
+		return false;
+	const size_t noff = h.varx ? h.count + 1 : 0;
+	const size_t fsize = sizeof(h) + (noff + h.xlength + h.count * h.ny) * sizeof(double);
+	if(file->size() != fsize || (!h.varx && h.xlength != h.count * h.nx))
+		return false;
+	char* base = file->data() + sizeof(h);
+
+	dh.xbuf.clear();
+	dh.xlow.clear();
+	dh.xtype = DType::Double;
+	dh.ybuf.clear();
+	dh.xoff.clear();
+	dh.mapping = file;
+	dh.streamer.reset();
+	dh.mapChanged = false;
+	dh.xoffmap = h.varx ? reinterpret_cast<const size_t*>(base) : nullptr;
+	dh.xmap = reinterpret_cast<double*>(base + noff * sizeof(uint64_t));
+	dh.ymap = dh.xmap + h.xlength;
+	dh.nx = h.nx;
+	dh.ny = h.ny;
+	dh.npoint = h.count;
+	return true;
+}
+
+bool DataCache::dump(const DataHolder& dh, const std::string& fpath, const DataCacheKey& key)
+{
+	CacheHeader h;
+	// the cache holds dense parsed values, not the converted ones
+	if(dh.xtype != DType::Double || dh.sparse || !makeHeader(h, fpath, key))
+		return false;
+	const size_t n = dh.size();
+	h.varx = dh.varx ? 1 : 0;
+	h.nx = dh.nx;
+	h.ny = dh.ny;
+	h.count = n;
+	const double* px = dh.mapping ? dh.xmap : dh.xbuf.data();
+	const double* py = dh.mapping ? dh.ymap : dh.ybuf.data();
+	const size_t* po = dh.mapping ? dh.xoffmap : dh.xoff.data();
+	h.xlength = dh.varx ? po[n] : n * dh.nx;
+	const string cpath = cachePath(fpath, key);
+	// write to a temporary file then rename, so that a reader never sees a partial cache
+	const string tpath = tempPath(cpath);
+	{
+		ofstream fout(tpath, ios::binary);
+		if(fout.fail())
+			return false;
+		fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
+		if(dh.varx)
+			fout.write(reinterpret_cast<const char*>(po), (n + 1) * sizeof(size_t));
+		fout.write(reinterpret_cast<const char*>(px), h.xlength * sizeof(double));
+		fout.write(reinterpret_cast<const char*>(py), n * dh.ny * sizeof(double));
+		if(fout.fail()){
+			fout.close();
+			remove(tpath.c_str());
+			return false;
+		}
+	}
+	if(rename(tpath.c_str(), cpath.c_str()) != 0){
+		remove(tpath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool DataCache::create(DataHolder& dh, const std::string& fpath, const DataCacheKey& key, const size_t n)
+{
+	CacheHeader h;
+	if(dh.varx || !makeHeader(h, fpath, key))
+		return false;
+	h.nx = dh.nx;
+	h.ny = dh.ny;
+	h.count = n;
+	h.xlength = n * dh.nx;
+	auto file = make_shared<MappedFile>();
+	const string tpath = tempPath(cachePath(fpath, key));
+	if(!file->create(tpath, sizeof(h) + (h.xlength + n * h.ny) * sizeof(double))){
+		remove(tpath.c_str());
+		return false;
+	}
+	memcpy(file->data(), &h, sizeof(h));
+	double* base = reinterpret_cast<double*>(file->data() + sizeof(h));
+	dh.xbuf.clear();
+	dh.xlow.clear();
+	dh.xtype = DType::Double;
+	dh.ybuf.clear();
+	dh.mapping = file;
+	dh.streamer.reset();
+	dh.mapChanged = false;
+	dh.xoffmap = nullptr;
+	dh.xmap = base;
+	dh.ymap = base + h.xlength;
+	dh.npoint = n;
+	return true;
+}
+
+bool DataCache::commit(DataHolder& dh, const std::string& fpath, const DataCacheKey& key)
+{
+	auto file = static_pointer_cast<MappedFile>(dh.mapping);
+	const string cpath = cachePath(fpath, key);
+	const string tpath = tempPath(cpath);
+	// the current mapping stays valid even if the file is removed
+	if(!file->sync() || rename(tpath.c_str(), cpath.c_str()) != 0){
+		remove(tpath.c_str());
+		return false;
+	}
+	// a shared mapping would write normalize() etc. into the cache
+	if(!load(dh, fpath, key)){
+		remove(cpath.c_str());
+		return false;
+	}
+	return true;
+}
+
+void DataCache::discard(DataHolder& dh, const std::string& fpath, const DataCacheKey& key)
+{
+	dh.mapping.reset();
+	dh.xmap = nullptr;
+	dh.ymap = nullptr;
+	dh.npoint = 0;
+	remove(tempPath(cachePath(fpath, key)).c_str());
+}
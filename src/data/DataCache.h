@@ -0,0 +1,50 @@
+#pragma once
+#include "DataHolder.h"
+#include <string>
+#include <vector>
+
+// Everything that decides the content of a parsed text dataset.
+// A cache file is reused only if all of them match.
+struct DataCacheKey {
+	std::string format; // dataset type, i.e. csv, tsv, customize, list
+	std::string sepper;
+	std::vector<int> skips;
+	std::vector<int> yIds;
+	bool header = false;
+	int lunit = 0;
+	size_t npart = 1;
+	size_t pid = 0;
+	bool localOnly = false;
+	bool byteRange = false; // the local part is a byte range instead of every npart-th line
+	size_t topk = 0;
+	// where the cache file is stored, empty means next to the source file. it does not change the content
+	std::string dir;
+};
+
+// Binary cache of a parsed dataset, stored next to the source file or in a given directory.
+// Layout (native endian): header | xoff (varx only, count+1 uint64) | x (double) | y (double)
+// The header records the version, the shape (nx, ny, count), the partition and
+// the size/mtime of the source file, so any change of them invalidates the cache.
+class DataCache {
+public:
+	static constexpr unsigned VERSION = 1;
+
+	// cache file of <fpath>, one per partition when only the local part is loaded.
+	// in a cache directory, the name also has a hash of <fpath> to tell apart the files of the same name
+	static std::string cachePath(const std::string& fpath, const DataCacheKey& key);
+
+	// map a valid cache of <fpath> into <dh>. return false if there is no valid cache.
+	static bool load(DataHolder& dh, const std::string& fpath, const DataCacheKey& key);
+	// write <dh> as the cache of <fpath>. return false on failure (i.e. read-only directory).
+	static bool dump(const DataHolder& dh, const std::string& fpath, const DataCacheKey& key);
+
+	// create a cache of <fpath> for <n> fixed-length data points and bind <dh> to it (zero-filled),
+	// so that a parser writes the data directly into the file without holding it all in memory.
+	// call commit() after filling it. return false on failure, <dh> is then unchanged.
+	static bool create(DataHolder& dh, const std::string& fpath, const DataCacheKey& key, const size_t n);
+	// flush a cache made by create(), make it visible to later runs and remap it privately.
+	// on failure <dh> keeps the data but no cache file is left.
+	static bool commit(DataHolder& dh, const std::string& fpath, const DataCacheKey& key);
+	// drop a cache made by create() that could not be filled, <dh> is left empty.
+	static void discard(DataHolder& dh, const std::string& fpath, const DataCacheKey& key);
+};
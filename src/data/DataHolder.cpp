@@ -1,13 +1,43 @@
 #include "DataHolder.h"
+#include "MappedFile.h"
+#include "DataStreamer.h"
+#include "DataOrder.h"
 #include <algorithm>
 #include <unordered_set>
 #include <fstream>
+#include <stdexcept>
+#include <cmath>
 
 using namespace std;
 
-DataHolder::DataHolder(const size_t nparts, const size_t localid, const bool varx)
-	:  npart(nparts), pid(localid), varx(varx)
-{}
+DataHolder::DataHolder(const size_t nparts, const size_t localid, const bool varx, const bool sparse)
+	:  npart(nparts), pid(localid), varx(varx), sparse(sparse)
+{
+	if(varx && sparse)
+		throw invalid_argument("variable-length data cannot be sparse");
+	if(varx || sparse)
+		xoff.push_back(0);
+}
+
+DataHolder::DataHolder(const DataHolder& o)
+	: xbuf(o.xbuf), ybuf(o.ybuf), xoff(o.xoff), xcol(o.xcol), xtype(o.xtype), xlow(o.xlow),
+	qscale(o.qscale), qoffset(o.qoffset), npoint(o.npoint), npart(o.npart), pid(o.pid),
+	varx(o.varx), sparse(o.sparse), nx(o.nx), ny(o.ny)
+{
+	if(o.mapping){
+		xbuf.assign(o.xmap, o.xmap + (varx ? o.xoffmap[npoint] : npoint * nx));
+		ybuf.assign(o.ymap, o.ymap + npoint * ny);
+		if(varx)
+			xoff.assign(o.xoffmap, o.xoffmap + npoint + 1);
+	}
+}
+
+DataHolder& DataHolder::operator=(const DataHolder& o)
+{
+	if(this != &o)
+		*this = DataHolder(o);
+	return *this;
+}
 
 void DataHolder::setLength(const size_t lx, const size_t ly){
 	nx = lx;
@@ -32,6 +62,16 @@ size_t DataHolder::nparts() const
 	return npart;
 }
 
+bool DataHolder::isVarX() const
+{
+	return varx;
+}
+
+bool DataHolder::isSparse() const
+{
+	return sparse;
+}
+
 void DataHolder::load(const std::string& fpath, const std::string& sepper,
 	const std::vector<int> skips, const std::vector<int>& yIds,
 	const bool header, const bool onlyLocalPart, const size_t topk)
@@ -79,91 +119,479 @@ void DataHolder::load(const std::string& fpath, const std::string& sepper,
 		if(topk != 0 && lid > topk)
 			break;
 		DataPoint dp = parseLine(line, sepper, xIds, yIds_u);
-		data.push_back(move(dp));
+		add(move(dp));
 	}
 }
 
+void DataHolder::reserve(const size_t n, const size_t nunit)
+{
+	detach();
+	if(sparse) // the number of non-zero values is unknown
+		xoff.reserve(n + 1);
+	else if(xtype == DType::Double)
+		xbuf.reserve(n * nunit * nx);
+	else
+		xlow.reserve(n * nunit * nx * dtypeSize(xtype));
+	ybuf.reserve(n * ny);
+	if(varx)
+		xoff.reserve(n + 1);
+}
+
+void DataHolder::resize(const size_t n)
+{
+	if(varx || sparse)
+		throw invalid_argument("resize() does not support variable-length or sparse data");
+	detach();
+	if(xtype == DType::Double)
+		xbuf.resize(n * nx, 0.0);
+	else
+		xlow.resize(n * nx * dtypeSize(xtype), 0);
+	ybuf.resize(n * ny, 0.0);
+	npoint = n;
+}
+
+double* DataHolder::xdata(const size_t idx)
+{
+	if(xtype != DType::Double || sparse)
+		throw invalid_argument("xdata() requires dense double storage");
+	return (mapping ? xmap : xbuf.data()) + (varx ? (mapping ? xoffmap : xoff.data())[idx] : idx * nx);
+}
+
+double* DataHolder::ydata(const size_t idx)
+{
+	return (mapping ? ymap : ybuf.data()) + idx * ny;
+}
+
+void DataHolder::setDataType(const DType type, const std::vector<double>& minv, const std::vector<double>& maxv)
+{
+	if(varx || sparse)
+		throw invalid_argument("setDataType() does not support variable-length or sparse data");
+	if(npoint != 0)
+		throw invalid_argument("setDataType() must be called before adding data points");
+	detach();
+	setScales(type, minv, maxv);
+	xtype = type;
+	vector<double>().swap(xbuf);
+	xlow.clear();
+}
+
+void DataHolder::setX(const size_t idx, const double* p)
+{
+	if(xtype == DType::Double)
+		copy(p, p + nx, xdata(idx));
+	else
+		storeLow(xlow.data() + idx * nx * dtypeSize(xtype), p, nx);
+}
+
 void DataHolder::add(const std::vector<double>& x, const std::vector<double>& y){
-	DataPoint dp{ {x},y };
-	data.push_back(move(dp));
+	appendX(x.data(), x.size());
+	appendY(y.data(), y.size());
+	finishPoint();
 }
 
 void DataHolder::add(std::vector<double>&& x, std::vector<double>&& y){
-	DataPoint dp;
-	dp.x.resize(1);
-	dp.x[0] = move(x);
-	dp.y = move(y);
-	data.push_back(move(dp));
+	add(static_cast<const vector<double>&>(x), static_cast<const vector<double>&>(y));
 }
 
 void DataHolder::add(const std::vector<std::vector<double>>& x, const std::vector<double>& y){
-	DataPoint dp{ x,y };
-	data.push_back(move(dp));
+	if(!varx && x.size() != 1)
+		throw invalid_argument("multiple x units require a variable-length DataHolder");
+	for(auto& unit : x)
+		appendX(unit.data(), unit.size());
+	appendY(y.data(), y.size());
+	finishPoint();
 }
 
 void DataHolder::add(std::vector<std::vector<double>>&& x, std::vector<double>&& y){
-	DataPoint dp{ move(x), move(y) };
-	data.push_back(move(dp));
+	add(static_cast<const vector<vector<double>>&>(x), static_cast<const vector<double>&>(y));
 }
 
 void DataHolder::add(const DataPoint & dp)
 {
-	data.push_back(dp);
+	add(dp.x, dp.y);
 }
 
 void DataHolder::add(DataPoint && dp)
 {
-	data.push_back(move(dp));
+	add(dp.x, dp.y);
+}
+
+void DataHolder::addSparse(const std::vector<uint32_t>& idx, const std::vector<double>& val,
+	const std::vector<double>& y)
+{
+	if(!sparse)
+		throw invalid_argument("addSparse() requires a sparse DataHolder");
+	if(idx.size() != val.size())
+		throw invalid_argument("the numbers of indices and values differ");
+	for(size_t i = 0; i < idx.size(); ++i){
+		if(idx[i] >= nx || (i != 0 && idx[i] <= idx[i - 1]))
+			throw invalid_argument("sparse indices are not ascending or out of range: " + to_string(idx[i]));
+	}
+	xbuf.insert(xbuf.end(), val.begin(), val.end());
+	xcol.insert(xcol.end(), idx.begin(), idx.end());
+	appendY(y.data(), y.size());
+	finishPoint();
+}
+
+void DataHolder::detach()
+{
+	if(!mapping)
+		return;
+	xbuf.assign(xmap, xmap + (varx ? xoffmap[npoint] : npoint * nx));
+	ybuf.assign(ymap, ymap + npoint * ny);
+	if(varx)
+		xoff.assign(xoffmap, xoffmap + npoint + 1);
+	mapping.reset();
+	streamer.reset();
+	mapChanged = false;
+	xmap = ymap = nullptr;
+	xoffmap = nullptr;
+}
+
+void DataHolder::appendX(const double* p, const size_t n)
+{
+	detach();
+	if(nx == 0)
+		nx = n;
+	// a broken line gives a shorter unit, pad it with 0 to keep the layout
+	size_t l = min(n, nx);
+	if(sparse){
+		for(size_t i = 0; i < l; ++i){
+			if(p[i] != 0.0){
+				xbuf.push_back(p[i]);
+				xcol.push_back(static_cast<uint32_t>(i));
+			}
+		}
+		return;
+	}
+	if(xtype == DType::Double){
+		xbuf.insert(xbuf.end(), p, p + l);
+		if(l < nx)
+			xbuf.resize(xbuf.size() + nx - l, 0.0);
+		return;
+	}
+	appendLow(p, l);
+}
+
+void DataHolder::appendLow(const double* p, const size_t l)
+{
+	size_t first = xlow.size();
+	xlow.resize(first + nx * dtypeSize(xtype));
+	storeLow(xlow.data() + first, p, l);
+}
+
+void DataHolder::storeLow(char* dst, const double* p, const size_t l) const
+{
+	for(size_t i = 0; i < nx; ++i){
+		double v = i < l ? p[i] : 0.0;
+		switch(xtype){
+		case DType::Float:
+			reinterpret_cast<float*>(dst)[i] = static_cast<float>(v);
+			break;
+		case DType::UInt8:
+			reinterpret_cast<uint8_t*>(dst)[i] = static_cast<uint8_t>(
+				max(0.0, min(255.0, round((v - qoffset[i]) / qscale[i]))));
+			break;
+		default:
+			reinterpret_cast<int8_t*>(dst)[i] = static_cast<int8_t>(
+				max(-127.0, min(127.0, round(v / qscale[i]))));
+			break;
+		}
+	}
+}
+
+void DataHolder::appendY(const double* p, const size_t n)
+{
+	detach();
+	if(npoint == 0 && ny == 0)
+		ny = n;
+	size_t l = min(n, ny);
+	ybuf.insert(ybuf.end(), p, p + l);
+	if(l < ny)
+		ybuf.resize(ybuf.size() + ny - l, 0.0);
+}
+
+void DataHolder::finishPoint()
+{
+	if(varx || sparse)
+		xoff.push_back(xcount());
+	++npoint;
+}
+
+size_t DataHolder::xcount() const
+{
+	return xtype == DType::Double ? xbuf.size() : xlow.size() / dtypeSize(xtype);
 }
 
 void DataHolder::shuffle()
 {
-	random_shuffle(data.begin(), data.end());
+	vector<size_t> order(npoint);
+	for(size_t i = 0; i < npoint; ++i)
+		order[i] = i;
+	random_shuffle(order.begin(), order.end());
+	if(sparse){
+		vector<double> nval, nybuf;
+		vector<uint32_t> ncol;
+		vector<size_t> nxoff;
+		nval.reserve(xbuf.size());
+		ncol.reserve(xcol.size());
+		nybuf.reserve(ybuf.size());
+		nxoff.reserve(npoint + 1);
+		nxoff.push_back(0);
+		for(size_t i : order){
+			nval.insert(nval.end(), xbuf.begin() + xoff[i], xbuf.begin() + xoff[i + 1]);
+			ncol.insert(ncol.end(), xcol.begin() + xoff[i], xcol.begin() + xoff[i + 1]);
+			nybuf.insert(nybuf.end(), ybuf.begin() + i * ny, ybuf.begin() + (i + 1) * ny);
+			nxoff.push_back(nval.size());
+		}
+		xbuf = move(nval);
+		xcol = move(ncol);
+		ybuf = move(nybuf);
+		xoff = move(nxoff);
+		return;
+	}
+	// x is moved as raw bytes, so it works for all storage types
+	const size_t esize = dtypeSize(xtype);
+	vector<char> nxraw;
+	vector<double> nybuf;
+	nxraw.reserve((varx ? (mapping ? xoffmap[npoint] : xoff.back()) : npoint * nx) * esize);
+	nybuf.reserve(npoint * ny);
+	vector<size_t> nxoff;
+	if(varx){
+		nxoff.reserve(npoint + 1);
+		nxoff.push_back(0);
+	}
+	for(size_t i : order){
+		DataPointView dp = get(i);
+		const char* px = static_cast<const char*>(dp.x.data());
+		nxraw.insert(nxraw.end(), px, px + dp.x.length() * esize);
+		const double* py = static_cast<const double*>(dp.y.data());
+		nybuf.insert(nybuf.end(), py, py + dp.y.size());
+		if(varx)
+			nxoff.push_back(nxraw.size() / esize);
+	}
+	if(xtype == DType::Double){
+		const double* p = reinterpret_cast<const double*>(nxraw.data());
+		xbuf.assign(p, p + nxraw.size() / esize);
+	} else{
+		xlow = move(nxraw);
+	}
+	ybuf = move(nybuf);
+	if(varx)
+		xoff = move(nxoff);
+	mapping.reset();
+	streamer.reset();
+	mapChanged = false;
+	xmap = ymap = nullptr;
+	xoffmap = nullptr;
+}
+
+void DataHolder::gather(const DataHolder& src, const size_t start, const size_t cnt, const bool toDouble,
+	const DataOrder* order)
+{
+	mapping.reset();
+	streamer.reset();
+	mapChanged = false;
+	xmap = ymap = nullptr;
+	xoffmap = nullptr;
+	npart = src.npart;
+	pid = src.pid;
+	varx = src.varx;
+	sparse = src.sparse;
+	nx = src.nx;
+	ny = src.ny;
+	xtype = toDouble ? DType::Double : src.xtype;
+	qscale = src.qscale;
+	qoffset = src.qoffset;
+	// clear() keeps the capacity
+	xbuf.clear();
+	ybuf.clear();
+	xoff.clear();
+	xcol.clear();
+	xlow.clear();
+	if(varx || sparse)
+		xoff.push_back(0);
+	npoint = 0;
+	const size_t esize = dtypeSize(xtype);
+	const size_t end = min(start + cnt, src.size());
+	for(size_t i = start; i < end; ++i){
+		DataPointView dp = src.get(order ? (*order)[i] : i);
+		if(sparse){
+			const double* pv = static_cast<const double*>(dp.x.data());
+			xbuf.insert(xbuf.end(), pv, pv + dp.x.nnz);
+			xcol.insert(xcol.end(), dp.x.idx, dp.x.idx + dp.x.nnz);
+		} else if(dp.x.type == DType::Double){
+			const double* p = static_cast<const double*>(dp.x.data());
+			xbuf.insert(xbuf.end(), p, p + dp.x.length());
+		} else if(xtype != DType::Double){
+			// keep the reduced-precision bytes
+			const char* p = static_cast<const char*>(dp.x.data());
+			xlow.insert(xlow.end(), p, p + dp.x.length() * esize);
+		} else{
+			size_t first = xbuf.size();
+			xbuf.resize(first + dp.x.length());
+			for(size_t u = 0; u < dp.x.size(); ++u)
+				dp.x[u].copyTo(xbuf.data() + first + u * nx);
+		}
+		const double* py = static_cast<const double*>(dp.y.data());
+		ybuf.insert(ybuf.end(), py, py + ny);
+		finishPoint();
+	}
 }
 
 // normalize to [-1, 1]
+// x (of all units) and y are row-major matrices, so the normalization is done column by column
 void DataHolder::normalize(const bool onY)
 {
-	if(data.size() < 2)
+	if(npoint < 2)
 		return;
-	vector<double> max_x = data.front().x.front();
-	vector<double> min_x = data.front().x.front();
-	vector<double> max_y = data.front().y;
-	vector<double> min_y = data.front().y;
-	for(const auto& d : data){
-		for(auto& x : d.x){
-			for(size_t i = 0; i < nx; ++i){
-				if(x[i] > max_x[i])
-					max_x[i] = x[i];
-				else if(x[i] < min_x[i])
-					min_x[i] = x[i];
+	if(xtype != DType::Double)
+		throw invalid_argument("normalize() must be called before convert()");
+	if(sparse){
+		vector<double> maxabs(nx, 0.0);
+		for(size_t k = 0; k < xbuf.size(); ++k)
+			maxabs[xcol[k]] = max(maxabs[xcol[k]], fabs(xbuf[k]));
+		for(size_t k = 0; k < xbuf.size(); ++k)
+			if(xbuf[k] != 0.0)
+				xbuf[k] /= maxabs[xcol[k]];
+	}
+	// works in place, a mapped cache is modified only in memory (copy-on-write)
+	auto fun = [](double* buf, const size_t length, const size_t width){
+		if(width == 0 || length == 0)
+			return;
+		const size_t nrow = length / width;
+		vector<double> max_v(buf, buf + width);
+		vector<double> min_v(buf, buf + width);
+		for(size_t r = 1; r < nrow; ++r){
+			const double* p = buf + r * width;
+			for(size_t i = 0; i < width; ++i){
+				if(p[i] > max_v[i])
+					max_v[i] = p[i];
+				else if(p[i] < min_v[i])
+					min_v[i] = p[i];
 			}
 		}
-		if(onY){
-			for(size_t i = 0; i < ny; ++i){
-				if(d.y[i] > max_y[i])
-					max_y[i] = d.y[i];
-				else if(d.y[i] < min_y[i])
-					min_y[i] = d.y[i];
+		vector<double> range(width);
+		for(size_t i = 0; i < width; ++i){
+			range[i] = max_v[i] - min_v[i];
+			if(range[i] == 0.0)
+				range[i] = 1.0;
+		}
+		for(size_t r = 0; r < nrow; ++r){
+			double* p = buf + r * width;
+			for(size_t i = 0; i < width; ++i)
+				p[i] = 2 * (p[i] - min_v[i]) / range[i] - 1;
+		}
+	};
+	// the changed pages of a mapping exist only in memory, they must not be dropped
+	mapChanged = static_cast<bool>(mapping);
+	if(streamer)
+		streamer->setRelease(false);
+	if(!sparse){
+		const size_t xlen = varx ? (mapping ? xoffmap[npoint] : xoff.back()) : npoint * nx;
+		fun(mapping ? xmap : xbuf.data(), xlen, nx);
+	}
+	if(onY)
+		fun(mapping ? ymap : ybuf.data(), npoint * ny, ny);
+}
+
+void DataHolder::convert(const DType type)
+{
+	if(type == xtype)
+		return;
+	if(xtype != DType::Double)
+		throw invalid_argument("data is already stored as " + dtypeName(xtype));
+	if(sparse)
+		throw invalid_argument("sparse data cannot be converted");
+	const double* px = mapping ? xmap : xbuf.data();
+	const size_t xlen = varx ? (mapping ? xoffmap[npoint] : xoff.back()) : npoint * nx;
+	const size_t nrow = nx == 0 ? 0 : xlen / nx;
+	// per-column range over all rows (all units of varx data)
+	vector<double> max_v(nx, 0.0), min_v(nx, 0.0);
+	if(nrow != 0 && type != DType::Float){
+		max_v.assign(px, px + nx);
+		min_v.assign(px, px + nx);
+		for(size_t r = 1; r < nrow; ++r){
+			const double* p = px + r * nx;
+			for(size_t i = 0; i < nx; ++i){
+				max_v[i] = max(max_v[i], p[i]);
+				min_v[i] = min(min_v[i], p[i]);
 			}
 		}
 	}
-	vector<double> range_x(nx);
-	vector<double> range_y(ny);
+	setScales(type, min_v, max_v);
+	xtype = type;
+	xlow.clear();
+	xlow.reserve(xlen * dtypeSize(type));
+	for(size_t r = 0; r < nrow; ++r)
+		appendLow(px + r * nx, nx);
+	// release the double copy of x, y and the offsets move to owned buffers
+	if(mapping){
+		ybuf.assign(ymap, ymap + npoint * ny);
+		if(varx)
+			xoff.assign(xoffmap, xoffmap + npoint + 1);
+		mapping.reset();
+		streamer.reset();
+		mapChanged = false;
+		xmap = ymap = nullptr;
+		xoffmap = nullptr;
+	}
+	vector<double>().swap(xbuf);
+}
+
+void DataHolder::setScales(const DType type, const std::vector<double>& minv, const std::vector<double>& maxv)
+{
+	qscale.clear();
+	qoffset.clear();
+	if(type != DType::UInt8 && type != DType::Int8)
+		return;
+	qscale.resize(nx);
+	qoffset.resize(nx);
 	for(size_t i = 0; i < nx; ++i){
-		range_x[i] = max_x[i] - min_x[i];
-		if(range_x[i] == 0.0)
-			range_x[i] = 1.0;
-	}
-	for(size_t i = 0; i < ny; ++i)
-		range_y[i] = max_y[i] - min_y[i];
-	for(auto&d : data){
-		for(auto& x : d.x)
-			for(size_t i = 0; i < nx; ++i)
-				x[i] = 2 * (x[i] - min_x[i]) / range_x[i] - 1;
-		if(onY){
-			for(size_t i = 0; i < ny; ++i)
-				d.y[i] = 2 * (d.y[i] - min_y[i]) / range_y[i] - 1;
-		}
+		double range = type == DType::UInt8 ? (maxv[i] - minv[i]) / 255
+			: max(fabs(maxv[i]), fabs(minv[i])) / 127;
+		qscale[i] = range == 0.0 ? 1.0 : range;
+		qoffset[i] = type == DType::UInt8 ? minv[i] : 0.0;
 	}
 }
+
+size_t DataHolder::memoryBytes() const
+{
+	size_t res = npoint * ny * sizeof(double);
+	if(xtype != DType::Double)
+		res += xlow.size();
+	else
+		res += (mapping ? (varx ? xoffmap[npoint] : npoint * nx) : xbuf.size()) * sizeof(double);
+	if(varx || sparse)
+		res += (npoint + 1) * sizeof(size_t);
+	res += xcol.size() * sizeof(uint32_t);
+	return res;
+}
+
+void DataHolder::enableStreaming(const size_t chunkBytes, const size_t ahead)
+{
+	// sparse data is never cached, so it would always stay in memory
+	if(sparse)
+		throw invalid_argument("Out-of-core mode does not support sparse data");
+	if(!mapping || npoint == 0)
+		return;
+	const char* base = mapping->data();
+	const size_t xlen = varx ? xoffmap[npoint] : npoint * nx;
+	const size_t bytesPerPoint = max<size_t>(1, (xlen + npoint * ny) * sizeof(double) / npoint);
+	const size_t chunkPoints = max<size_t>(1, chunkBytes / bytesPerPoint);
+	const size_t nchunk = (npoint + chunkPoints - 1) / chunkPoints;
+	vector<size_t> xbound(nchunk + 1), ybound(nchunk + 1);
+	for(size_t c = 0; c <= nchunk; ++c){
+		size_t idx = min(c * chunkPoints, npoint);
+		xbound[c] = reinterpret_cast<const char*>(xmap + (varx ? xoffmap[idx] : idx * nx)) - base;
+		ybound[c] = reinterpret_cast<const char*>(ymap + idx * ny) - base;
+	}
+	streamer = make_shared<DataStreamer>(mapping, npoint, chunkPoints, move(xbound), move(ybound), ahead);
+	streamer->setRelease(!mapChanged);
+}
+
+void DataHolder::hint(const size_t start, const size_t cnt) const
+{
+	if(streamer)
+		streamer->hint(start, cnt);
+}
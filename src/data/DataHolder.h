@@ -2,23 +2,61 @@
 #include "DataPoint.h"
 #include <vector>
 #include <string>
+#include <memory>
 
+class MappedFile;
+class DataStreamer;
+class DataOrder;
+
+// All data points are stored in contiguous buffers:
+//   x: one row-major matrix. Fixed-length data has <nx> values per point.
+//      Variable-length data (varx) has several units of <nx> values per point,
+//      and <xoff> records where each point starts.
+//   y: one row-major matrix with <ny> values per point.
+//   sparse x: CSR, the non-zero values are in <xbuf>, their columns in <xcol>,
+//      and the ones of point i are [xoff[i], xoff[i+1]). <nx> is the number of columns.
+// The buffers are either owned vectors or a private mapping of a binary cache file (see DataCache).
+// After convert(), x is kept in <xlow> in a reduced-precision type and dequantized on read.
 class DataHolder {
-	std::vector<DataPoint> data;
+	std::vector<double> xbuf; // x of all data points
+	std::vector<double> ybuf; // y of all data points
+	std::vector<size_t> xoff; // varx/sparse only: (size()+1) entries, x of point i is xbuf[xoff[i], xoff[i+1])
+	std::vector<uint32_t> xcol; // sparse only: column of each value of xbuf
+	// set when the buffers come from a mapped cache file, copy-on-write, never written back
+	std::shared_ptr<MappedFile> mapping;
+	double* xmap = nullptr;
+	double* ymap = nullptr;
+	const size_t* xoffmap = nullptr;
+	std::shared_ptr<DataStreamer> streamer; // out-of-core mode, only for mapped data
+	bool mapChanged = false; // the mapped data is modified in memory
+	DType xtype = DType::Double; // storage type of x
+	std::vector<char> xlow; // x of all data points when xtype is not Double
+	std::vector<double> qscale, qoffset; // per-column dequantization of the 8-bit types
+	size_t npoint = 0; // number of data points
 	size_t npart; // total number of parts
 	size_t pid; // part id
 
 	bool varx = false;
-	size_t nx; // length of x
-	size_t ny; // length of y
+	bool sparse = false;
+	size_t nx = 0; // length of x (length of a unit for varx)
+	size_t ny = 0; // length of y
 public:
 	// <nparts> <localid>: used for distributed case
-	DataHolder(const size_t nparts = 1, const size_t localid = 0, const bool varx = false);
+	DataHolder(const size_t nparts = 1, const size_t localid = 0, const bool varx = false,
+		const bool sparse = false);
+	// a copy owns its data: mapped data is copied into memory, so that modifying one of them
+	// (i.e. normalize()) does not change the other. it is not streaming
+	DataHolder(const DataHolder& o);
+	DataHolder& operator=(const DataHolder& o);
+	DataHolder(DataHolder&& o) = default;
+	DataHolder& operator=(DataHolder&& o) = default;
 	void setLength(const size_t lx, const size_t ly);
 	size_t xlength() const;
 	size_t ylength() const;
 	size_t nparts() const;
 	size_t partid() const;
+	bool isVarX() const;
+	bool isSparse() const;
 
 	// give the column id of y and the skipped ones, the rest are x. id starts from 0
 	// throw exceptions if something wrong
@@ -26,22 +64,109 @@ public:
 		const std::vector<int> skips, const std::vector<int>& yIds,
 		const bool header, const bool onlyLocalPart = false, const size_t topk = 0);
 
+	// reserve space for <n> data points (<nunit> units each for varx)
+	void reserve(const size_t n, const size_t nunit = 1);
+	// fixed-length only: hold <n> zero-filled data points, to be filled in place via xdata()/ydata(),
+	// or setX() for a reduced-precision type
+	void resize(const size_t n);
+	// double storage only
+	double* xdata(const size_t idx);
+	double* ydata(const size_t idx);
+	// fixed-length only: store x in <type> from now on, call it before adding any point.
+	// <minv> and <maxv> are the range of each column, which sets the scales of the 8-bit types
+	void setDataType(const DType type, const std::vector<double>& minv, const std::vector<double>& maxv);
+	// fixed-length only: set x of point <idx> to the <nx> values at <p>, converted to the storage type.
+	// different points can be set by different threads
+	void setX(const size_t idx, const double* p);
+
 	void add(const std::vector<double>& x, const std::vector<double>& y);
 	void add(std::vector<double>&& x, std::vector<double>&& y);
 	void add(const std::vector<std::vector<double>>& x, const std::vector<double>& y);
 	void add(std::vector<std::vector<double>>&& x, std::vector<double>&& y);
 	void add(const DataPoint& dp);
 	void add(DataPoint&& dp);
-	
+	// sparse only: <idx> are the ascending columns of the values <val>.
+	// dense points added to a sparse DataHolder keep their non-zero values
+	void addSparse(const std::vector<uint32_t>& idx, const std::vector<double>& val,
+		const std::vector<double>& y);
+
 	void shuffle();
+	// copy the points [start, start+cnt) of <src> into this one, the buffers are reused.
+	// with <order>, they are the points at these positions of <order>.
+	// <toDouble>: store x in double even if <src> uses a reduced-precision type
+	void gather(const DataHolder& src, const size_t start, const size_t cnt, const bool toDouble,
+		const DataOrder* order = nullptr);
 
 	size_t size() const {
-		return data.size();
+		return npoint;
 	}
-	const DataPoint& get(const size_t idx) const {
-		return data[idx];
+	DataPointView get(const size_t idx) const {
+		const double* py = mapping ? ymap : ybuf.data();
+		if(sparse)
+			return DataPointView{ FeatureView(xbuf.data() + xoff[idx], xcol.data() + xoff[idx],
+				xoff[idx + 1] - xoff[idx], nx), FeatureView(py + idx * ny, ny) };
+		size_t first = idx * nx, nunit = 1;
+		if(varx){
+			const size_t* po = mapping ? xoffmap : xoff.data();
+			first = po[idx];
+			nunit = (po[idx + 1] - po[idx]) / nx;
+		}
+		if(xtype == DType::Double){
+			const double* px = mapping ? xmap : xbuf.data();
+			return DataPointView{ FeatureListView(px + first, nunit, nx),
+				FeatureView(py + idx * ny, ny) };
+		}
+		return DataPointView{ FeatureListView(xlow.data() + first * dtypeSize(xtype), nunit, nx,
+			xtype, qscale.data(), qoffset.data()), FeatureView(py + idx * ny, ny) };
+	}
+	// whether the data is backed by a mapped cache file
+	bool isMapped() const {
+		return static_cast<bool>(mapping);
 	}
 
-	// normalize to [-1, 1]
+	// normalize to [-1, 1]. must be called before convert()
+	// sparse data is scaled by the max absolute value of each column, to keep the zeros
 	void normalize(const bool onY);
+
+	// store x in a reduced-precision type to cut the memory footprint and bandwidth:
+	//   Float: cast to float32.
+	//   UInt8: per-column affine quantization over [min, max] of the column.
+	//   Int8: per-column symmetric quantization over [-maxabs, maxabs].
+	// y stays in double. a mapped cache is released (its x is copied in the new type).
+	// points added later are quantized with the same scales (and clipped).
+	// throw exceptions if x is already in a reduced-precision type or is sparse
+	void convert(const DType type);
+	DType dataType() const {
+		return xtype;
+	}
+	// bytes used by x and y
+	size_t memoryBytes() const;
+
+	// out-of-core mode for data backed by a mapped cache (no effect otherwise):
+	// keep a window of chunks (<chunkBytes> each) in memory, read the next <ahead> chunks
+	// in the background and drop the passed ones. call it when the DataHolder is at its final place.
+	// variable-length data is streamed once it is loaded from the cache (i.e. from the second run).
+	// throw exceptions if something wrong, including sparse data
+	void enableStreaming(const size_t chunkBytes, const size_t ahead = 2);
+	bool isStreaming() const {
+		return static_cast<bool>(streamer);
+	}
+	// points [start, start+cnt) are going to be used soon
+	void hint(const size_t start, const size_t cnt) const;
+
+private:
+	// copy mapped data into owned buffers before modifying them
+	void detach();
+	void appendX(const double* p, const size_t n);
+	// quantize <l> values into a new unit of <xlow>, the rest of the unit is 0
+	void appendLow(const double* p, const size_t l);
+	void storeLow(char* dst, const double* p, const size_t l) const;
+	// the scales of the 8-bit types for the column ranges [minv, maxv]
+	void setScales(const DType type, const std::vector<double>& minv, const std::vector<double>& maxv);
+	void appendY(const double* p, const size_t n);
+	void finishPoint();
+	// number of x values stored in the owned buffer
+	size_t xcount() const;
+
+	friend class DataCache;
 };
@@ -1,14 +1,92 @@
 #include "DataLoader.h"
+#include "MappedFile.h"
+#include "TableParser.h"
 #include <fstream>
+#include <iostream>
 #include <limits>
 #include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstring>
 using namespace std;
 
+namespace {
+
+// start of the first line at or after <q>, within the data part [first, last)
+const char* alignLine(const char* first, const char* last, const char* q){
+	if(q <= first)
+		return first;
+	if(q >= last)
+		return last;
+	const void* p = memchr(q - 1, '\n', last - q + 1);
+	return p == nullptr ? last : static_cast<const char*>(p) + 1;
+}
+
+// run fun(0), ..., fun(nt-1) on <nt> threads, fun(0) on the calling one
+void runParallel(const size_t nt, const function<void(size_t)>& fun){
+	vector<thread> ths;
+	for(size_t t = 1; t < nt; ++t)
+		ths.emplace_back(fun, t);
+	fun(0);
+	for(auto& th : ths)
+		th.join();
+}
+
+// map a binary data file, throw exceptions on failure
+void mapDataFile(MappedFile& file, const string& fpath){
+	if(!file.open(fpath))
+		throw invalid_argument("Error in reading file: " + fpath);
+	file.adviseSequential(0, 0);
+}
+
+// libsvm line "<y> <index>:<value> ...", the indices in <idx> start from 0.
+// return false on a malformed line
+bool parseSparseLine(const string& line, double& y, vector<uint32_t>& idx, vector<double>& val){
+	idx.clear();
+	val.clear();
+	const char* p = line.c_str();
+	char* q;
+	y = strtod(p, &q);
+	if(q == p)
+		return false;
+	p = q;
+	while(true){
+		while(*p == ' ' || *p == '\t' || *p == '\r')
+			++p;
+		if(*p == '\0' || *p == '#')
+			break;
+		unsigned long i = strtoul(p, &q, 10);
+		if(q == p || *q != ':' || i == 0)
+			return false;
+		p = q + 1;
+		double v = strtod(p, &q);
+		if(q == p)
+			return false;
+		p = q;
+		idx.push_back(static_cast<uint32_t>(i - 1));
+		val.push_back(v);
+	}
+	return true;
+}
+
+// the largest index of a libsvm line, which is the last one
+size_t lastSparseIndex(const string& line){
+	size_t p = line.rfind(':', line.find('#'));
+	if(p == string::npos)
+		return 0;
+	size_t b = line.find_last_of(" \t", p);
+	return strtoul(line.c_str() + (b == string::npos ? 0 : b + 1), nullptr, 10);
+}
+
+} // namespace
+
 // -------- DataLoader basic --------
 
 std::vector<std::string> DataLoader::supportList()
 {
-	static vector<string> supported{ "customize", "csv", "tsv", "list",
+	static vector<string> supported{ "customize", "csv", "tsv", "list", "libsvm",
 		"mnist", "cifar10", "cifar100" };
 	return supported;
 }
@@ -44,19 +122,42 @@ void DataLoader::bindParameterVarLen(const std::string& sepper, const int lenUni
 	this->yIds = yIds;
 }
 
+void DataLoader::bindParameterSparse(const size_t dim)
+{
+	sparseDim = dim;
+}
+
+void DataLoader::setThreads(const size_t n)
+{
+	nthread = n;
+}
+
+void DataLoader::setByteRangePartition(const bool use)
+{
+	byteRange = use;
+}
+
+void DataLoader::setDataType(const DType type, const bool normalize)
+{
+	dtype = type;
+	normalizeX = normalize;
+}
+
+void DataLoader::setCache(const bool use, const std::string& dir)
+{
+	useCache = use;
+	cacheDir = dir;
+}
+
 DataHolder DataLoader::load(
 	const std::string & path, const bool trainPart, const size_t topk)
 {
-	DataHolder dh(npart, pid);
+	DataHolder dh(npart, pid, ds_type == "list", ds_type == "libsvm");
 	size_t limit = topk == 0 ? numeric_limits<size_t>::max() : topk;
-	if(ds_type == "csv"){
-		load_customized(dh, path, ",", skips, yIds, header, limit);
-	} else if(ds_type == "tsv"){
-		load_customized(dh, path, "\t", skips, yIds, header, limit);
-	} else if(ds_type == "customize"){
-		load_customized(dh, path, sepper, skips, yIds, header, limit);
-	} else if(ds_type == "list"){
-		load_varlist(dh, path, lunit, sepper, yIds, limit);
+	if(load_text(dh, path, limit)){
+		// csv, tsv, customize, list
+	} else if(ds_type == "libsvm"){
+		load_libsvm(dh, path, sparseDim, limit);
 	} else if(ds_type == "mnist"){
 		load_mnist(dh, trainPart, path, limit);
 	} else if(ds_type == "cifar10"){
@@ -64,20 +165,246 @@ DataHolder DataLoader::load(
 	} else if(ds_type == "cifar100"){
 		load_cifar100(dh, trainPart, path, limit);
 	}
+	// the text tables without cache are done while parsing
+	if(dtype == DType::Double || dh.dataType() == DType::Double){
+		if(normalizeX)
+			dh.normalize(false);
+		dh.convert(dtype);
+	}
 	return dh;
 }
 
+// -------- load text file (csv, tsv, customize, list) --------
+bool DataLoader::load_text(DataHolder& dh, const std::string& path, const size_t topk)
+{
+	DataCacheKey key;
+	key.format = ds_type;
+	if(ds_type == "csv")
+		key.sepper = ",";
+	else if(ds_type == "tsv")
+		key.sepper = "\t";
+	else if(ds_type == "customize" || ds_type == "list")
+		key.sepper = sepper;
+	else
+		return false;
+	if(ds_type == "list")
+		key.lunit = lunit;
+	else
+		key.skips = skips;
+	key.yIds = yIds;
+	key.header = header;
+	key.npart = npart;
+	key.pid = pid;
+	key.localOnly = localOnly;
+	key.byteRange = localOnly && byteRange;
+	key.topk = topk;
+	key.dir = cacheDir;
+
+	if(useCache && DataCache::load(dh, path, key))
+		return true;
+	if(ds_type == "list")
+		load_varlist(dh, path, lunit, key.sepper, yIds, topk);
+	else
+		load_customized(dh, path, key.sepper, skips, yIds, header, topk, useCache ? &key : nullptr);
+	// a failed write only costs the next run a re-parse
+	if(useCache && dh.isMapped())
+		DataCache::commit(dh, path, key);
+	else if(useCache)
+		DataCache::dump(dh, path, key);
+	return true;
+}
+
 // -------- load customized file --------
+// The file is mapped and split into <nthread> byte ranges on line boundaries.
+// pass 1 counts the data lines of each range, which gives the global line id of
+// each line, so that the local-part and topk selection is the same as a sequential scan.
+// pass 2 parses the selected lines directly into their final place in <dh>,
+// which is the cache file when caching is on, so the data never needs to fit in memory.
+// Without cache, x is normalized and converted to <dtype> line by line (see setDataType()).
+// With byte-range partition, only the local 1/npart of the file (in bytes) is touched.
 void DataLoader::load_customized(DataHolder & dh, const std::string & fpath,
 	const std::string& sepper, const std::vector<int> skips, const std::vector<int>& yIds,
-	const bool header, const size_t topk)
+	const bool header, const size_t topk, const DataCacheKey* cacheKey)
+{
+	MappedFile file;
+	if(!file.open(fpath)){
+		throw invalid_argument("Error in reading file: " + fpath);
+	}
+	const char* pf = file.data();
+	const char* pend = pf + file.size();
+	auto lineEnd = [pend](const char* p){
+		if(p == pend)
+			return pend;
+		const void* q = memchr(p, '\n', pend - p);
+		return q == nullptr ? pend : static_cast<const char*>(q);
+	};
+	// calculate number of x and y
+	const char* p = lineEnd(pf);
+	TableParser parser(sepper, TableParser::countColumn(pf, p, sepper), skips, yIds);
+	dh.setLength(parser.xlength(), parser.ylength());
+
+	// deal with header
+	const char* pdata = header ? (p == pend ? pend : p + 1) : pf;
+	// local byte range
+	const bool blockPart = localOnly && byteRange;
+	if(blockPart){
+		const size_t len = pend - pdata;
+		const char* pb = alignLine(pdata, pend, pdata + len / npart * pid);
+		const char* pe = pid + 1 == npart ? pend : alignLine(pdata, pend, pdata + len / npart * (pid + 1));
+		pdata = pb;
+		pend = pe;
+	}
+	file.adviseSequential(pdata - pf, pend - pdata);
+	// split into byte ranges for threads
+	size_t nt = nthread != 0 ? nthread : thread::hardware_concurrency();
+	nt = max<size_t>(1, min<size_t>(nt, (pend - pdata) / MIN_BYTES_PER_THREAD + 1));
+	vector<const char*> bounds(nt + 1, pend);
+	bounds[0] = pdata;
+	for(size_t t = 1; t < nt; ++t)
+		bounds[t] = max(alignLine(pdata, pend, pdata + (pend - pdata) / nt * t), bounds[t - 1]);
+	// whether the <i>-th data line (of the range) is used
+	auto selected = [&](const size_t i){
+		return i < topk && (!localOnly || blockPart || i % npart == pid);
+	};
+
+	// pass 1: count data lines (no need to go beyond topk)
+	vector<size_t> nline(nt, 0);
+	runParallel(nt, [&](const size_t t){
+		size_t c = 0;
+		for(const char* q = bounds[t]; q < bounds[t + 1] && c < topk;){
+			const char* e = lineEnd(q);
+			if(parser.isData(q, e))
+				++c;
+			q = e == pend ? pend : e + 1;
+		}
+		nline[t] = c;
+	});
+	// global id of the first data line and first output point of each range
+	vector<size_t> lineStart(nt + 1, 0), pointStart(nt + 1, 0);
+	for(size_t t = 0; t < nt; ++t){
+		lineStart[t + 1] = lineStart[t] + nline[t];
+		size_t c = 0;
+		for(size_t i = lineStart[t]; i < lineStart[t + 1] && i < topk; ++i)
+			c += selected(i);
+		pointStart[t + 1] = pointStart[t] + c;
+	}
+	const size_t npoint = pointStart[nt];
+
+	// pass 2: parse. <fun>(t, k, q, e) parses line [q, e) as point k on thread t, false on a malformed line.
+	// a range stops at its first malformed line, the earliest one is reported
+	auto parseLines = [&](const function<bool(size_t, size_t, const char*, const char*)>& fun){
+		mutex merr;
+		size_t errId = numeric_limits<size_t>::max();
+		string errLine;
+		runParallel(nt, [&](const size_t t){
+			size_t i = lineStart[t];
+			size_t k = pointStart[t];
+			for(const char* q = bounds[t]; q < bounds[t + 1] && i < lineStart[t + 1];){
+				const char* e = lineEnd(q);
+				if(parser.isData(q, e)){
+					if(selected(i)){
+						if(!fun(t, k, q, e)){
+							lock_guard<mutex> lg(merr);
+							if(i < errId){
+								errId = i;
+								errLine.assign(q, e);
+							}
+							return;
+						}
+						++k;
+					}
+					++i;
+				}
+				q = e == pend ? pend : e + 1;
+			}
+		});
+		if(errId != numeric_limits<size_t>::max()){
+			if(dh.isMapped())
+				DataCache::discard(dh, fpath, *cacheKey);
+			throw invalid_argument("Error on line: " + errLine);
+		}
+	};
+	if(cacheKey != nullptr && DataCache::create(dh, fpath, *cacheKey, npoint)){
+		parseLines([&](const size_t t, const size_t k, const char* q, const char* e){
+			return parser.parse(q, e, dh.xdata(k), dh.ydata(k));
+		});
+		return;
+	}
+	if(dtype == DType::Double){
+		dh.resize(npoint);
+		parseLines([&](const size_t t, const size_t k, const char* q, const char* e){
+			return parser.parse(q, e, dh.xdata(k), dh.ydata(k));
+		});
+		return;
+	}
+
+	// convert while parsing: x goes through a row of its thread into the storage type, it is never all in double.
+	// the 8-bit types and the normalization need the range of each column, which takes one more parse first
+	const size_t nx = parser.xlength();
+	vector<vector<double>> row(nt, vector<double>(nx));
+	vector<double> minv(nx, 0.0), maxv(nx, 0.0);
+	const bool norm = normalizeX && npoint >= 2; // like DataHolder::normalize()
+	if(npoint != 0 && (norm || dtype != DType::Float)){
+		vector<vector<double>> tmin(nt, vector<double>(nx, numeric_limits<double>::infinity()));
+		vector<vector<double>> tmax(nt, vector<double>(nx, -numeric_limits<double>::infinity()));
+		vector<vector<double>> y(nt, vector<double>(parser.ylength()));
+		parseLines([&](const size_t t, const size_t k, const char* q, const char* e){
+			double* x = row[t].data();
+			fill(x, x + nx, 0.0);
+			if(!parser.parse(q, e, x, y[t].data()))
+				return false;
+			for(size_t i = 0; i < nx; ++i){
+				tmin[t][i] = min(tmin[t][i], x[i]);
+				tmax[t][i] = max(tmax[t][i], x[i]);
+			}
+			return true;
+		});
+		minv = tmin[0];
+		maxv = tmax[0];
+		for(size_t t = 1; t < nt; ++t){
+			for(size_t i = 0; i < nx; ++i){
+				minv[i] = min(minv[i], tmin[t][i]);
+				maxv[i] = max(maxv[i], tmax[t][i]);
+			}
+		}
+	}
+	// normalize to [-1, 1] with the same arithmetic as DataHolder::normalize()
+	vector<double> low(minv), range(nx);
+	for(size_t i = 0; i < nx; ++i){
+		range[i] = maxv[i] - minv[i];
+		if(range[i] == 0.0)
+			range[i] = 1.0;
+	}
+	auto normalize = [&](double* x){
+		for(size_t i = 0; i < nx; ++i)
+			x[i] = 2 * (x[i] - low[i]) / range[i] - 1;
+	};
+	if(norm){
+		normalize(minv.data());
+		normalize(maxv.data());
+	}
+	dh.setDataType(dtype, minv, maxv);
+	dh.resize(npoint);
+	parseLines([&](const size_t t, const size_t k, const char* q, const char* e){
+		double* x = row[t].data();
+		fill(x, x + nx, 0.0);
+		if(!parser.parse(q, e, x, dh.ydata(k)))
+			return false;
+		if(norm)
+			normalize(x);
+		dh.setX(k, x);
+		return true;
+	});
+}
+
+void DataLoader::load_varlist(DataHolder& dh, const std::string & fpath, const int lunit,
+	const std::string& sepper, const std::vector<int>& yIds, const size_t topk)
 {
 	ifstream fin(fpath);
 	if(fin.fail()){
 		throw invalid_argument("Error in reading file: " + fpath);
 	}
 	// calculate number of x
-	size_t nx = 0;
 	int n = 0;
 	string line;
 	getline(fin, line);
@@ -87,187 +414,212 @@ void DataLoader::load_customized(DataHolder & dh, const std::string & fpath,
 		p = line.find(sepper, p + 1);
 	}
 	++n;
-	// calculate xIds and yId
-	unordered_set<int> xIds;
+	// calculate yId
 	unordered_set<int> yIds_u;
 	for(int i = 0; i < n; ++i){
-		if(find(skips.begin(), skips.end(), i) != skips.end())
-			continue;
 		if(find(yIds.begin(), yIds.end(), i) != yIds.end())
 			yIds_u.insert(i);
-		else
-			xIds.insert(i);
 	}
 	//nx = n - skips.size() - 1; // does not work when skips contains placeholders like -1
-	nx = xIds.size();
 	size_t ny = yIds_u.size();
-	dh.setLength(nx, ny);
+	dh.setLength(static_cast<size_t>(lunit), ny);
 
 	// deal with header
 	if(!header)
 		fin.seekg(0);
+	// local byte range [pb, pe), a line belongs to the range where it starts
+	const bool blockPart = localOnly && byteRange;
+	streamoff pe = numeric_limits<streamoff>::max();
+	if(blockPart){
+		streamoff pdata = fin.tellg();
+		fin.seekg(0, ios::end);
+		streamoff len = static_cast<streamoff>(fin.tellg()) - pdata;
+		streamoff pb = pdata + len / npart * pid;
+		if(pid + 1 != npart)
+			pe = pdata + len / npart * (pid + 1);
+		if(pb == pdata){
+			fin.seekg(pb);
+		} else{
+			fin.seekg(pb - 1);
+			getline(fin, line); // skip the rest of the line started in the previous range
+		}
+	}
 	// parse lines
 	size_t i = 0; // line id;
-	while(getline(fin, line)){
-		if(line.size() < nx || line.front() == '#') // invalid line
+	while(fin.tellg() < pe && getline(fin, line)){
+		if(line.empty() || line.front() == '#') // invalid line
 			continue;
-		if(localOnly && i++ % npart != pid) // not local line
+		if(localOnly && !blockPart && i++ % npart != pid) // not local line
 			continue;
-		if(topk != 0 && i > topk)
+		if(!localOnly || blockPart)
+			++i;
+		if(i > topk)
 			break;
-		DataPoint dp = parseLine(line, sepper, xIds, yIds_u);
+		DataPoint dp = parseLineVarLen(line, sepper, lunit, yIds_u);
 		dh.add(move(dp));
 	}
 }
 
-void DataLoader::load_varlist(DataHolder& dh, const std::string & fpath, const int lunit,
-	const std::string& sepper, const std::vector<int>& yIds, const size_t topk)
+// -------- load libsvm file --------
+// The points are stored as CSR, so only the non-zero values take memory.
+// Without a given dimension, it is the largest index of the whole file (not only the local part),
+// so that all workers agree on it.
+void DataLoader::load_libsvm(DataHolder& dh, const std::string & fpath, const size_t dim, const size_t topk)
 {
 	ifstream fin(fpath);
 	if(fin.fail()){
 		throw invalid_argument("Error in reading file: " + fpath);
 	}
-	// calculate number of x
-	size_t nx = 0;
-	int n = 0;
 	string line;
-	getline(fin, line);
-	size_t p = line.find(sepper);
-	while(p != string::npos){
-		++n;
-		p = line.find(sepper, p + 1);
-	}
-	++n;
-	// calculate yId
-	unordered_set<int> yIds_u;
-	for(int i = 0; i < n; ++i){
-		if(find(yIds.begin(), yIds.end(), i) != yIds.end())
-			yIds_u.insert(i);
+	size_t nx = dim;
+	if(nx == 0){
+		while(getline(fin, line)){
+			if(!line.empty() && line.front() != '#')
+				nx = max(nx, lastSparseIndex(line));
+		}
+		fin.clear();
+		fin.seekg(0);
 	}
-	//nx = n - skips.size() - 1; // does not work when skips contains placeholders like -1
-	size_t ny = yIds_u.size();
-	dh.setLength(static_cast<size_t>(lunit), ny);
+	dh.setLength(nx, 1);
 
-	// deal with header
-	if(!header)
-		fin.seekg(0);
-	// parse lines
+	// local byte range [pb, pe), a line belongs to the range where it starts
+	const bool blockPart = localOnly && byteRange;
+	streamoff pe = numeric_limits<streamoff>::max();
+	if(blockPart){
+		fin.seekg(0, ios::end);
+		streamoff len = static_cast<streamoff>(fin.tellg());
+		streamoff pb = len / npart * pid;
+		if(pid + 1 != npart)
+			pe = len / npart * (pid + 1);
+		if(pb == 0){
+			fin.seekg(pb);
+		} else{
+			fin.seekg(pb - 1);
+			getline(fin, line); // skip the rest of the line started in the previous range
+		}
+	}
+	// parse lines, the buffers are reused for all lines
+	vector<uint32_t> idx;
+	vector<double> val;
+	vector<double> y(1);
 	size_t i = 0; // line id;
-	while(getline(fin, line)){
-		if(line.size() < nx || line.front() == '#') // invalid line
+	while(fin.tellg() < pe && getline(fin, line)){
+		if(line.empty() || line.front() == '#') // invalid line
 			continue;
-		if(localOnly && i++ % npart != pid) // not local line
+		if(localOnly && !blockPart && i++ % npart != pid) // not local line
 			continue;
-		if(topk != 0 && i > topk)
+		if(!localOnly || blockPart)
+			++i;
+		if(i > topk)
 			break;
-		DataPoint dp = parseLineVarLen(line, sepper, lunit, yIds_u);
-		dh.add(move(dp));
+		if(!parseSparseLine(line, y[0], idx, val))
+			throw invalid_argument("Error in parsing libsvm line: " + line);
+		dh.addSparse(idx, val, y);
 	}
 }
 
+// -------- load binary image datasets (MNIST, CIFAR) --------
+// The files are mapped, and the selected records are decoded by <nthread> threads
+// directly into the preallocated storage of <dh>.
+// The local part is every npart-th record, or a contiguous 1/npart of them with byte-range partition.
+void DataLoader::load_records(DataHolder& dh, const size_t n, const size_t len, const size_t ny,
+	const size_t topk, const RecordFun& px, const RecordFun& py)
+{
+	size_t first = 0, last = min(n, topk), step = 1;
+	if(localOnly && byteRange){
+		first = n * pid / npart;
+		last = pid + 1 == npart ? n : n * (pid + 1) / npart;
+		last = min(last, first + min(topk, n)); // topk limits the local points
+	} else if(localOnly){
+		first = pid;
+		step = npart;
+	}
+	const size_t cnt = first < last ? (last - first + step - 1) / step : 0;
+	dh.setLength(len, ny);
+	dh.resize(cnt);
+	size_t nt = nthread != 0 ? nthread : thread::hardware_concurrency();
+	nt = max<size_t>(1, min<size_t>(nt, cnt * len / MIN_BYTES_PER_THREAD + 1));
+	atomic<bool> bad(false);
+	runParallel(nt, [&](const size_t t){
+		for(size_t k = cnt * t / nt; k < cnt * (t + 1) / nt; ++k){
+			const size_t i = first + k * step;
+			// the pixels are unsigned bytes
+			const unsigned char* p = px(i);
+			double* x = dh.xdata(k);
+			for(size_t j = 0; j < len; ++j)
+				x[j] = static_cast<double>(p[j]);
+			const unsigned char lbl = *py(i);
+			if(lbl < ny)
+				dh.ydata(k)[lbl] = 1.0;
+			else
+				bad = true;
+		}
+	});
+	if(bad)
+		throw invalid_argument("Invalid label in the data file");
+}
+
 // -------- load MNIST --------
 void DataLoader::load_mnist(DataHolder & dh, const bool trainPart,
 	const std::string & dpath, const size_t topk)
 {
 	string prefix = trainPart ? "train" : "t10k";
-	size_t n = trainPart ? 60000 : 10000;
-	n = n < topk ? n : topk;
-	ifstream fimg(dpath + '/' + prefix + "-images.idx3-ubyte");
-	if(fimg.fail()){
-		throw invalid_argument("Error in reading file: " + dpath + '/' + prefix + "-images.idx3-ubyte");
-	}
-	ifstream flbl(dpath + '/' + prefix + "-labels.idx1-ubyte");
-	if(flbl.fail()){
-		throw invalid_argument("Error in reading file: " + dpath + '/' + prefix + "-labels.idx3-ubyte");
-	}
-	constexpr int len = 28 * 28;
-	dh.setLength(len, 10);
-	char buffer[len];
-	fimg.read(buffer, 16);
-	flbl.read(buffer, 8);
-	for(size_t i = 0; i < n && fimg && flbl; ++i){
-		fimg.read(buffer, len);
-		int lbl = flbl.get();
-		if(localOnly && i % npart != pid) // not local line
-			continue;
-		vector<double> x(len), y(10, 0.0);
-		for(int j = 0; j < len; ++j)
-			x[j] = static_cast<double>(buffer[j]);
-		y[lbl] = 1.0;
-		dh.add(move(x), move(y));
-	}
+	MappedFile fimg, flbl;
+	mapDataFile(fimg, dpath + '/' + prefix + "-images.idx3-ubyte");
+	mapDataFile(flbl, dpath + '/' + prefix + "-labels.idx1-ubyte");
+	constexpr size_t len = 28 * 28;
+	constexpr size_t himg = 16, hlbl = 8; // header sizes
+	const size_t nimg = fimg.size() < himg ? 0 : (fimg.size() - himg) / len;
+	const size_t nlbl = flbl.size() < hlbl ? 0 : flbl.size() - hlbl;
+	const unsigned char* pimg = reinterpret_cast<const unsigned char*>(fimg.data()) + himg;
+	const unsigned char* plbl = reinterpret_cast<const unsigned char*>(flbl.data()) + hlbl;
+	load_records(dh, min(nimg, nlbl), len, 10, topk,
+		[=](const size_t i){ return pimg + i * len; },
+		[=](const size_t i){ return plbl + i; });
 }
 
 // -------- load CIFAR10 --------
+// the training set is split into 5 files, which are mapped as needed
 void DataLoader::load_cifar10(DataHolder & dh, const bool trainPart,
 	const std::string & dpath, const size_t topk)
 {
-	auto func = [&](const std::string& name, const size_t n){
-		ifstream fin(name);
-		if(fin.fail()){
-			throw invalid_argument("Error in reading file: " + name);
-		}
-		constexpr int len = 3 * 32 * 32; // RGB - X - Y
-		char buffer[len+1];
-		for(size_t i = 0; i < n && fin; ++i){
-			fin.read(buffer, len+1);
-			if(localOnly && i % npart != pid) // not local line
-				continue;
-			vector<double> x(len), y(10, 0.0);
-			const int p = static_cast<int>(buffer[0]);
-			y[p] = 1.0;
-			for(int j = 0; j < len; ++j)
-				x[j] = static_cast<double>(buffer[j + 1]);
-			dh.add(move(x), move(y));
-		}
-	};
-	dh.setLength(3 * 32 * 32, 10);
+	constexpr size_t len = 3 * 32 * 32; // RGB - X - Y
+	constexpr size_t rlen = len + 1; // label - pixels
+	vector<string> names;
 	if(trainPart){
-		size_t n = topk == 0 ? 50000 : topk;
-		for(int fileId = 1; fileId <= 5; ++fileId){
-			func(dpath + "/data_batch_" + to_string(fileId) + ".bin",
-				(n <= 10000 ? n : 10000));
-			if(n <= 10000)
-				break;
-			n -= 10000;
-		}
+		for(int fileId = 1; fileId <= 5; ++fileId)
+			names.push_back(dpath + "/data_batch_" + to_string(fileId) + ".bin");
 	} else{
-		size_t n = topk == 0 ? 10000 : topk;
-		func(dpath + "/test_batch.bin", topk);
+		names.push_back(dpath + "/test_batch.bin");
 	}
+	vector<MappedFile> files;
+	vector<size_t> starts{ 0 }; // first record of each file
+	for(auto& name : names){
+		if(!(localOnly && byteRange) && starts.back() >= topk)
+			break;
+		files.emplace_back();
+		mapDataFile(files.back(), name);
+		starts.push_back(starts.back() + files.back().size() / rlen);
+	}
+	auto record = [&](const size_t i){
+		size_t f = upper_bound(starts.begin(), starts.end(), i) - starts.begin() - 1;
+		return reinterpret_cast<const unsigned char*>(files[f].data()) + (i - starts[f]) * rlen;
+	};
+	load_records(dh, starts.back(), len, 10, topk,
+		[&](const size_t i){ return record(i) + 1; },
+		[&](const size_t i){ return record(i); });
 }
 
 // -------- load CIFAR100 --------
 void DataLoader::load_cifar100(DataHolder & dh, const bool trainPart,
 	const std::string & dpath, const size_t topk)
 {
-	auto func = [&](const std::string& name, const size_t n){
-		ifstream fin(name);
-		if(fin.fail()){
-			throw invalid_argument("Error in reading file: " + name);
-		}
-		constexpr int len = 3 * 32 * 32; // RGB - X - Y
-		char buffer[len + 2];
-		for(size_t i = 0; i < n && fin; ++i){
-			fin.read(buffer, len + 2);
-			if(localOnly && i % npart != pid) // not local line
-				continue;
-			vector<double> x(len), y(100, 0.0);
-			const int p = static_cast<int>(buffer[1]);
-			y[p] = 1.0;
-			for(int j = 0; j < len; ++j)
-				x[j] = static_cast<double>(buffer[j + 2]);
-			dh.add(move(x), move(y));
-		}
-	};
-	dh.setLength(3 * 32 * 32, 100);
-	if(trainPart){
-		size_t n = topk == 0 ? 50000 : topk;
-		func(dpath + "/train.bin", n);
-	} else{
-		size_t n = topk == 0 ? 10000 : topk;
-		func(dpath + "/test.bin", n);
-	}
-
+	constexpr size_t len = 3 * 32 * 32; // RGB - X - Y
+	constexpr size_t rlen = len + 2; // coarse label - fine label - pixels
+	MappedFile file;
+	mapDataFile(file, dpath + (trainPart ? "/train.bin" : "/test.bin"));
+	const unsigned char* pf = reinterpret_cast<const unsigned char*>(file.data());
+	load_records(dh, file.size() / rlen, len, 100, topk,
+		[=](const size_t i){ return pf + i * rlen + 2; },
+		[=](const size_t i){ return pf + i * rlen + 1; });
 }
-
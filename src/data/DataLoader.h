@@ -1,7 +1,9 @@
 #pragma once
 #include "DataHolder.h"
+#include "DataCache.h"
 #include <string>
 #include <vector>
+#include <functional>
 
 class DataLoader{
 	std::string ds_type;
@@ -13,6 +15,19 @@ class DataLoader{
 	int lunit = 0;
 	std::vector<int> skips, yIds;
 	bool header = false;
+	// parameters for sparse format (libsvm): number of features, 0 means the largest index in the file
+	size_t sparseDim = 0;
+	// local part is a contiguous byte range of the file, instead of every npart-th line
+	bool byteRange = false;
+	// binary cache for the text formats, off by default. an empty <cacheDir> puts it next to the data file
+	bool useCache = false;
+	std::string cacheDir;
+	// storage type of x, and whether x is normalized
+	DType dtype = DType::Double;
+	bool normalizeX = false;
+	// number of threads for parsing text files and decoding binary ones, 0 means all hardware threads
+	size_t nthread = 0;
+	static constexpr size_t MIN_BYTES_PER_THREAD = 1 << 20;
 public:
 	static std::vector<std::string> supportList();
 	static bool isSupported(const std::string& name);
@@ -23,15 +38,39 @@ public:
 	void bindParameterTable(const std::string& sepper,
 		const std::vector<int> skips, const std::vector<int>& yIds, const bool header);
 	void bindParameterVarLen(const std::string& sepper, const int lenUnit, const std::vector<int>& yIds);
+	// libsvm: "<y> <index>:<value> ..." with ascending indices starting from 1
+	void bindParameterSparse(const size_t dim);
+	void setThreads(const size_t n);
+	// with localOnly, read only the local 1/nparts (in bytes) of a text file, aligned to lines.
+	// the parts then differ slightly in size, and topk limits the number of local points.
+	// for the binary formats (mnist, cifar) it is a contiguous range of records.
+	void setByteRangePartition(const bool use);
+	// whether to reuse/write a binary cache of a text data file (default: false).
+	// it is stored in <dir>, or next to the data file if <dir> is empty
+	void setCache(const bool use, const std::string& dir = "");
+	// normalize x (see DataHolder::normalize()) and store it in <type> (see DataHolder::convert()).
+	// the text tables (csv, tsv, customize) without cache are converted while parsing, so x is never
+	// held in double. the 8-bit types and the normalization then parse the file twice, the first
+	// pass finds the range of each column. the other formats are converted after loading
+	void setDataType(const DType type, const bool normalize = false);
 
 	DataHolder load(const std::string& path, const bool trainPart, const size_t topk = 0);
 
 private:
+	bool load_text(DataHolder& dh, const std::string& path, const size_t topk);
+	// <cacheKey>: if given, parse directly into a new cache file
 	void load_customized(DataHolder& dh, const std::string & fpath,
 		const std::string& sepper, const std::vector<int> skips, const std::vector<int>& yIds,
-		const bool header, const size_t topk);
+		const bool header, const size_t topk, const DataCacheKey* cacheKey = nullptr);
 	void load_varlist(DataHolder& dh, const std::string & fpath, const int lunit,
 		const std::string& sepper, const std::vector<int>& yIds, const size_t topk);
+	void load_libsvm(DataHolder& dh, const std::string & fpath, const size_t dim, const size_t topk);
+	// start of (the x or the label of) record i
+	using RecordFun = std::function<const unsigned char*(const size_t)>;
+	// decode record i of <n> fixed-size records: <len> bytes of x at px(i), a label byte at py(i),
+	// y is the one-hot vector of <ny> classes
+	void load_records(DataHolder& dh, const size_t n, const size_t len, const size_t ny,
+		const size_t topk, const RecordFun& px, const RecordFun& py);
 	void load_mnist(DataHolder& dh, const bool trainPart,
 		const std::string & dpath, const size_t topk);
 	void load_cifar10(DataHolder& dh, const bool trainPart, 
@@ -0,0 +1,43 @@
+#include "DataOrder.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+void DataOrder::init(const size_t n, const Mode mode, const size_t block, const unsigned seed)
+{
+	this->n = n;
+	this->mode = mode;
+	this->block = max<size_t>(1, block);
+	gen.seed(seed);
+	nepoch = 0;
+	perm.clear();
+	if(mode == Mode::Point){
+		perm.resize(n);
+		for(size_t i = 0; i < n; ++i)
+			perm[i] = i;
+	} else if(mode == Mode::Block){
+		nfull = n / this->block * this->block;
+		perm.resize(n / this->block);
+		for(size_t i = 0; i < perm.size(); ++i)
+			perm[i] = i;
+	}
+	shuffle();
+}
+
+void DataOrder::shuffle()
+{
+	std::shuffle(perm.begin(), perm.end(), gen);
+	++nepoch;
+}
+
+DataOrder::Mode DataOrder::parseMode(const std::string& name)
+{
+	if(name == "sequential" || name == "seq")
+		return Mode::Sequential;
+	else if(name == "point")
+		return Mode::Point;
+	else if(name == "block")
+		return Mode::Block;
+	throw invalid_argument("unknown data order: " + name);
+}
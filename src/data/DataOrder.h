@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <random>
+
+// The order of visiting the data points in an epoch, the points themselves are not moved.
+// position p of an epoch is data point order[p].
+//   Sequential: p itself.
+//   Point: a random permutation of all points.
+//   Block: a random permutation of blocks of <block> consecutive points, the points in a block
+//     keep their order, so that the memory is read in cache-line or page sized pieces.
+//     A last partial block stays at the end.
+// shuffle() draws a new random order, call it at the start of each epoch.
+class DataOrder {
+public:
+	enum class Mode : char { Sequential, Point, Block };
+private:
+	Mode mode = Mode::Sequential;
+	size_t n = 0;
+	size_t block = 1;
+	size_t nfull = 0; // number of points in the full blocks
+	std::vector<size_t> perm; // Point: n entries. Block: one entry per full block
+	std::mt19937 gen;
+	size_t nepoch = 0;
+public:
+	// <block>: points per block, only used by Block mode
+	void init(const size_t n, const Mode mode, const size_t block = 1, const unsigned seed = 0);
+	void shuffle();
+
+	Mode getMode() const { return mode; }
+	bool isSequential() const { return mode == Mode::Sequential; }
+	size_t size() const { return n; }
+	// number of calls to shuffle()
+	size_t epoch() const { return nepoch; }
+
+	size_t operator[](const size_t p) const {
+		switch(mode){
+		case Mode::Point: return perm[p];
+		case Mode::Block: return p < nfull ? perm[p / block] * block + p % block : p;
+		default: return p;
+		}
+	}
+
+	// throw exceptions if <name> is not one of: sequential, point, block
+	static Mode parseMode(const std::string& name);
+};
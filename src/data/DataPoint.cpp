@@ -1,6 +1,8 @@
 #include "DataPoint.h"
 #include <iostream>
 #include <string>
+#include <stdexcept>
+#include <algorithm>
 
 using namespace std;
 
@@ -74,3 +76,54 @@ DataPoint parseLineVarLen(const std::string& line, const std::string& sepper,
 	return DataPoint{ x, y };
 }
 
+
+std::string dtypeName(const DType t)
+{
+	switch(t){
+	case DType::Double: return "double";
+	case DType::Float: return "float";
+	case DType::UInt8: return "uint8";
+	default: return "int8";
+	}
+}
+
+DType parseDType(const std::string& name)
+{
+	if(name == "double" || name == "float64")
+		return DType::Double;
+	else if(name == "float" || name == "float32")
+		return DType::Float;
+	else if(name == "uint8")
+		return DType::UInt8;
+	else if(name == "int8")
+		return DType::Int8;
+	throw invalid_argument("unknown data type: " + name);
+}
+
+double FeatureView::sparseAt(const size_t i) const
+{
+	const uint32_t* last = idx + nnz;
+	const uint32_t* p = lower_bound(idx, last, static_cast<uint32_t>(i));
+	return p != last && *p == i ? static_cast<const double*>(ptr)[p - idx] : 0.0;
+}
+
+std::vector<double> FeatureView::toVector() const
+{
+	vector<double> res(n);
+	copyTo(res.data());
+	return res;
+}
+
+std::vector<std::vector<double>> FeatureListView::toVector() const
+{
+	vector<vector<double>> res;
+	res.reserve(nunit);
+	for(size_t i = 0; i < nunit; ++i)
+		res.push_back(operator[](i).toVector());
+	return res;
+}
+
+DataPoint DataPointView::toDataPoint() const
+{
+	return DataPoint{ x.toVector(), y.toVector() };
+}
@@ -1,6 +1,12 @@
 #pragma once
 #include <vector>
+#include <string>
 #include <unordered_set>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include "math/simd.h"
 
 struct DataPoint {
 	std::vector<std::vector<double>> x;
@@ -12,3 +18,223 @@ DataPoint parseLine(const std::string& line, const std::string& sepper,
 
 DataPoint parseLineVarLen(const std::string& line, const std::string& sepper,
 	const int lenUnit, const std::unordered_set<int>& yIds);
+
+// storage type of feature values.
+// the quantized types store q, and the value is q * scale[i] + offset[i] for column i
+enum class DType : char { Double, Float, UInt8, Int8 };
+
+size_t dtypeSize(const DType t);
+std::string dtypeName(const DType t);
+// throw exceptions if <name> is not a known type
+DType parseDType(const std::string& name);
+
+// read-only view of <n> contiguous values (one unit of x, or the y of a data point).
+// it does not own the data, the underlying buffer must outlive the view.
+// values may be stored in reduced precision, they are converted to double on read.
+// a sparse view stores <nnz> doubles at the ascending columns <idx>, the other values are 0.
+// hot loops should use forEach/dot/axpy/copyTo, which dispatch on the type once per call
+// and only visit the stored values of a sparse view. dot/axpy of dense doubles use the SIMD kernels.
+struct FeatureView {
+	const void* ptr = nullptr;
+	size_t n = 0;
+	DType type = DType::Double;
+	const double* scale = nullptr; // quantized types only
+	const double* offset = nullptr; // quantized types only
+	const uint32_t* idx = nullptr; // sparse only
+	size_t nnz = 0; // sparse only
+
+	struct iterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = double;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const double*;
+		using reference = double;
+		const FeatureView* v;
+		size_t i;
+		double operator*() const { return (*v)[i]; }
+		iterator& operator++() { ++i; return *this; }
+		iterator operator++(int) { iterator t = *this; ++i; return t; }
+		bool operator==(const iterator& o) const { return i == o.i; }
+		bool operator!=(const iterator& o) const { return i != o.i; }
+	};
+
+	FeatureView() = default;
+	FeatureView(const double* p, const size_t n) : ptr(p), n(n) {}
+	FeatureView(const void* p, const size_t n, const DType type, const double* scale, const double* offset)
+		: ptr(p), n(n), type(type), scale(scale), offset(offset) {}
+	FeatureView(const std::vector<double>& v) : ptr(v.data()), n(v.size()) {}
+	// sparse
+	FeatureView(const double* val, const uint32_t* idx, const size_t nnz, const size_t n)
+		: ptr(val), n(n), idx(idx), nnz(nnz) {}
+
+	size_t size() const { return n; }
+	bool empty() const { return n == 0; }
+	bool isDouble() const { return type == DType::Double; }
+	bool isSparse() const { return idx != nullptr; }
+	// the raw storage, valid as double* only if isDouble(). the stored values only for a sparse view
+	const void* data() const { return ptr; }
+	double operator[](const size_t i) const {
+		if(idx != nullptr)
+			return sparseAt(i);
+		switch(type){
+		case DType::Double: return static_cast<const double*>(ptr)[i];
+		case DType::Float: return static_cast<const float*>(ptr)[i];
+		case DType::UInt8: return static_cast<const uint8_t*>(ptr)[i] * scale[i] + offset[i];
+		default: return static_cast<const int8_t*>(ptr)[i] * scale[i] + offset[i];
+		}
+	}
+	double front() const { return operator[](0); }
+	double back() const { return operator[](n - 1); }
+	iterator begin() const { return iterator{ this, 0 }; }
+	iterator end() const { return iterator{ this, n }; }
+
+	// call f(i, value) for each value, the type dispatch is done once
+	template <class Fun>
+	void forEach(Fun f) const;
+	// sum_i x[i] * w[i]
+	double dot(const double* w) const;
+	// out[i] += a * x[i]
+	void axpy(const double a, double* out) const;
+	// out[i] = x[i], <out> is double or float
+	template <typename T>
+	void copyTo(T* out) const;
+	std::vector<double> toVector() const;
+
+private:
+	double sparseAt(const size_t i) const;
+};
+
+// read-only view of the x part of a data point: <nunit> units of <lunit> values each,
+// stored one after another in a contiguous buffer.
+// fixed-length data has exactly one unit, variable-length ("list") data has several.
+// all units share the per-column <scale> and <offset> of quantized types.
+// sparse data has one sparse unit.
+struct FeatureListView {
+	const void* ptr = nullptr;
+	size_t nunit = 0;
+	size_t lunit = 0;
+	DType type = DType::Double;
+	const double* scale = nullptr;
+	const double* offset = nullptr;
+	const uint32_t* idx = nullptr;
+	size_t nnz = 0;
+
+	struct iterator {
+		const FeatureListView* v;
+		size_t i;
+		FeatureView operator*() const { return (*v)[i]; }
+		iterator& operator++() { ++i; return *this; }
+		bool operator==(const iterator& o) const { return i == o.i; }
+		bool operator!=(const iterator& o) const { return i != o.i; }
+	};
+
+	FeatureListView() = default;
+	FeatureListView(const double* p, const size_t nunit, const size_t lunit)
+		: ptr(p), nunit(nunit), lunit(lunit) {}
+	FeatureListView(const void* p, const size_t nunit, const size_t lunit,
+		const DType type, const double* scale, const double* offset)
+		: ptr(p), nunit(nunit), lunit(lunit), type(type), scale(scale), offset(offset) {}
+	// a single unit
+	FeatureListView(const std::vector<double>& v) : ptr(v.data()), nunit(1), lunit(v.size()) {}
+	FeatureListView(const FeatureView& v)
+		: ptr(v.ptr), nunit(1), lunit(v.n), type(v.type), scale(v.scale), offset(v.offset),
+		idx(v.idx), nnz(v.nnz) {}
+
+	// number of units
+	size_t size() const { return nunit; }
+	bool empty() const { return nunit == 0; }
+	// total number of values in all units
+	size_t length() const { return nunit * lunit; }
+	bool isSparse() const { return idx != nullptr; }
+	const void* data() const { return ptr; }
+	FeatureView operator[](const size_t i) const {
+		if(idx != nullptr)
+			return FeatureView(static_cast<const double*>(ptr), idx, nnz, lunit);
+		return FeatureView(static_cast<const char*>(ptr) + i * lunit * dtypeSize(type), lunit, type, scale, offset);
+	}
+	FeatureView front() const { return operator[](0); }
+	FeatureView back() const { return operator[](nunit - 1); }
+	iterator begin() const { return iterator{ this, 0 }; }
+	iterator end() const { return iterator{ this, nunit }; }
+
+	std::vector<std::vector<double>> toVector() const;
+};
+
+// light-weight reference to one data point inside a DataHolder
+struct DataPointView {
+	FeatureListView x;
+	FeatureView y;
+
+	DataPoint toDataPoint() const;
+};
+
+inline size_t dtypeSize(const DType t){
+	switch(t){
+	case DType::Double: return sizeof(double);
+	case DType::Float: return sizeof(float);
+	default: return 1;
+	}
+}
+
+template <class Fun>
+inline void FeatureView::forEach(Fun f) const
+{
+	if(idx != nullptr){
+		const double* p = static_cast<const double*>(ptr);
+		for(size_t k = 0; k < nnz; ++k)
+			f(static_cast<size_t>(idx[k]), p[k]);
+		return;
+	}
+	switch(type){
+	case DType::Double:{
+		const double* p = static_cast<const double*>(ptr);
+		for(size_t i = 0; i < n; ++i)
+			f(i, p[i]);
+		break;
+	}
+	case DType::Float:{
+		const float* p = static_cast<const float*>(ptr);
+		for(size_t i = 0; i < n; ++i)
+			f(i, static_cast<double>(p[i]));
+		break;
+	}
+	case DType::UInt8:{
+		const uint8_t* p = static_cast<const uint8_t*>(ptr);
+		for(size_t i = 0; i < n; ++i)
+			f(i, p[i] * scale[i] + offset[i]);
+		break;
+	}
+	case DType::Int8:{
+		const int8_t* p = static_cast<const int8_t*>(ptr);
+		for(size_t i = 0; i < n; ++i)
+			f(i, p[i] * scale[i] + offset[i]);
+		break;
+	}
+	}
+}
+
+inline double FeatureView::dot(const double* w) const
+{
+	if(idx == nullptr && type == DType::Double)
+		return simd_dot(static_cast<const double*>(ptr), w, n);
+	double res = 0.0;
+	forEach([&](const size_t i, const double v){ res += v * w[i]; });
+	return res;
+}
+
+inline void FeatureView::axpy(const double a, double* out) const
+{
+	if(idx == nullptr && type == DType::Double){
+		simd_axpy(a, static_cast<const double*>(ptr), out, n);
+		return;
+	}
+	forEach([&](const size_t i, const double v){ out[i] += a * v; });
+}
+
+template <typename T>
+inline void FeatureView::copyTo(T* out) const
+{
+	if(idx != nullptr)
+		std::fill(out, out + n, T(0));
+	forEach([&](const size_t i, const double v){ out[i] = static_cast<T>(v); });
+}
@@ -0,0 +1,119 @@
+#include "DataStreamer.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <unistd.h>
+
+using namespace std;
+
+DataStreamer::DataStreamer(std::shared_ptr<MappedFile> file, const size_t npoint, const size_t chunkPoints,
+	std::vector<size_t> xbound, std::vector<size_t> ybound, const size_t ahead)
+	: file(move(file)), npoint(npoint), chunkPoints(max<size_t>(1, chunkPoints)), ahead(ahead),
+	xbound(move(xbound)), ybound(move(ybound)), doRelease(true)
+{
+	nchunk = (npoint + this->chunkPoints - 1) / this->chunkPoints;
+	resident.assign(nchunk, false);
+	th = thread(&DataStreamer::run, this);
+}
+
+DataStreamer::~DataStreamer()
+{
+	{
+		lock_guard<mutex> lk(mtx);
+		stop = true;
+	}
+	cv.notify_all();
+	th.join();
+}
+
+void DataStreamer::hint(const size_t start, const size_t cnt)
+{
+	if(nchunk == 0)
+		return;
+	size_t first = (start % npoint) / chunkPoints;
+	size_t last = (start % npoint + max<size_t>(cnt, 1) - 1) / chunkPoints; // may go beyond nchunk (wrap)
+	{
+		lock_guard<mutex> lk(mtx);
+		if(first == reqFirst && last == reqLast && version != 0)
+			return;
+		reqFirst = first;
+		reqLast = last;
+		++version;
+	}
+	cv.notify_all();
+}
+
+void DataStreamer::setRelease(const bool release)
+{
+	doRelease = release;
+}
+
+void DataStreamer::run()
+{
+	size_t done = 0;
+	vector<bool> inWindow(nchunk);
+	while(true){
+		size_t first, last, ver;
+		{
+			unique_lock<mutex> lk(mtx);
+			cv.wait(lk, [&](){ return stop || version != done; });
+			if(stop)
+				break;
+			first = reqFirst;
+			last = reqLast;
+			ver = version;
+		}
+		// the window, in the order of use
+		size_t wsize = min(last - first + 1 + ahead, nchunk);
+		fill(inWindow.begin(), inWindow.end(), false);
+		bool renewed = false;
+		for(size_t k = 0; k < wsize && !renewed; ++k){
+			size_t c = (first + k) % nchunk;
+			inWindow[c] = true;
+			if(!resident[c]){
+				fetch(c);
+				resident[c] = true;
+			}
+			// follow a newer request as soon as possible
+			lock_guard<mutex> lk(mtx);
+			renewed = stop || version != ver;
+		}
+		if(renewed)
+			continue;
+		if(doRelease){
+			for(size_t c = 0; c < nchunk; ++c){
+				if(resident[c] && !inWindow[c]){
+					drop(c);
+					resident[c] = false;
+				}
+			}
+		}
+		done = ver;
+	}
+}
+
+void DataStreamer::fetch(const size_t c)
+{
+	const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const char* data = file->data();
+	volatile char sink = 0;
+	auto touch = [&](const size_t first, const size_t last){
+		if(first >= last)
+			return;
+		file->adviseWillNeed(first, last - first);
+		// read one byte per page to make sure the pages are in memory before the trainer needs them
+		char s = 0;
+		for(size_t p = first; p < last; p += page)
+			s ^= data[p];
+		s ^= data[last - 1];
+		sink = s;
+	};
+	touch(xbound[c], xbound[c + 1]);
+	touch(ybound[c], ybound[c + 1]);
+	(void)sink;
+}
+
+void DataStreamer::drop(const size_t c)
+{
+	file->release(xbound[c], xbound[c + 1] - xbound[c]);
+	file->release(ybound[c], ybound[c + 1] - ybound[c]);
+}
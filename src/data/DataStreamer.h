@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class MappedFile;
+
+// Sliding window over a DataHolder backed by a mapped cache file, for data larger than the memory.
+// The points are split into chunks of consecutive points. After hint(), the chunks from the
+// current one to <ahead> chunks later are read in on a background thread, and the chunks out of
+// the window are dropped from memory. The page cache works as the recycled buffer pool, so the
+// views returned by DataHolder::get() stay valid all the time.
+class DataStreamer {
+	std::shared_ptr<MappedFile> file;
+	size_t npoint;
+	size_t chunkPoints;
+	size_t nchunk;
+	size_t ahead;
+	// byte ranges of chunk c in the file: [xbound[c], xbound[c+1]) and [ybound[c], ybound[c+1])
+	std::vector<size_t> xbound, ybound;
+	std::atomic<bool> doRelease;
+
+	std::vector<bool> resident;
+	std::thread th;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool stop = false;
+	size_t reqFirst = 0, reqLast = 0; // requested chunks
+	size_t version = 0; // increased by each new request
+
+public:
+	DataStreamer(std::shared_ptr<MappedFile> file, const size_t npoint, const size_t chunkPoints,
+		std::vector<size_t> xbound, std::vector<size_t> ybound, const size_t ahead);
+	~DataStreamer();
+	DataStreamer(const DataStreamer&) = delete;
+	DataStreamer& operator=(const DataStreamer&) = delete;
+
+	size_t chunkSize() const { return chunkPoints; }
+	size_t chunkNumber() const { return nchunk; }
+
+	// points [start, start+cnt) are going to be used, it does not block
+	void hint(const size_t start, const size_t cnt);
+	// whether to drop the passed chunks. must be off once the mapped data is modified in memory.
+	void setRelease(const bool release);
+
+private:
+	void run();
+	void fetch(const size_t c);
+	void drop(const size_t c);
+};
@@ -0,0 +1,128 @@
+#include "MappedFile.h"
+#include <utility>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& o)
+	: addr(o.addr), len(o.len)
+{
+	o.addr = nullptr;
+	o.len = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& o)
+{
+	if(this != &o){
+		close();
+		swap(addr, o.addr);
+		swap(len, o.len);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string& fpath, const bool privateWrite)
+{
+	close();
+	int fd = ::open(fpath.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0){
+		::close(fd);
+		return false;
+	}
+	if(st.st_size == 0){ // mmap does not accept an empty range
+		::close(fd);
+		len = 0;
+		addr = nullptr;
+		return true;
+	}
+	int prot = privateWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+	void* p = mmap(nullptr, static_cast<size_t>(st.st_size), prot, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED)
+		return false;
+	addr = static_cast<char*>(p);
+	len = static_cast<size_t>(st.st_size);
+	return true;
+}
+
+bool MappedFile::create(const std::string& fpath, const size_t size)
+{
+	close();
+	int fd = ::open(fpath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		return false;
+	if(ftruncate(fd, static_cast<off_t>(size)) != 0){
+		::close(fd);
+		return false;
+	}
+	if(size == 0){
+		::close(fd);
+		return true;
+	}
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED)
+		return false;
+	addr = static_cast<char*>(p);
+	len = size;
+	return true;
+}
+
+bool MappedFile::sync()
+{
+	return addr == nullptr || msync(addr, len, MS_SYNC) == 0;
+}
+
+void MappedFile::close()
+{
+	if(addr != nullptr)
+		munmap(addr, len);
+	addr = nullptr;
+	len = 0;
+}
+
+void MappedFile::adviseSequential(const size_t offset, const size_t length)
+{
+	if(addr == nullptr || offset >= len)
+		return;
+	// madvise needs a page-aligned start
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t first = offset / page * page;
+	size_t last = length == 0 || offset + length > len ? len : offset + length;
+	madvise(addr + first, last - first, MADV_SEQUENTIAL);
+}
+
+void MappedFile::adviseWillNeed(const size_t offset, const size_t length)
+{
+	if(addr == nullptr || offset >= len)
+		return;
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t first = offset / page * page;
+	size_t last = length == 0 || offset + length > len ? len : offset + length;
+	madvise(addr + first, last - first, MADV_WILLNEED);
+}
+
+void MappedFile::release(const size_t offset, const size_t length)
+{
+	if(addr == nullptr || offset >= len)
+		return;
+	// only whole pages, the partial ones at both ends may still be in use
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t first = (offset + page - 1) / page * page;
+	size_t last = offset + length > len ? len : offset + length;
+	if(last != len)
+		last = last / page * page;
+	if(first < last)
+		madvise(addr + first, last - first, MADV_DONTNEED);
+}
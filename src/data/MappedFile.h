@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+
+// A whole file mapped into memory.
+// Read-only by default. With <privateWrite> the pages are copy-on-write:
+// they can be modified in memory, but the changes never reach the file.
+class MappedFile {
+	char* addr = nullptr;
+	size_t len = 0;
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& o);
+	MappedFile& operator=(MappedFile&& o);
+
+	// return false if the file cannot be opened or mapped
+	bool open(const std::string& fpath, const bool privateWrite = false);
+	// create (or truncate) a zero-filled file of <size> bytes, mapped writable and shared with the file
+	bool create(const std::string& fpath, const size_t size);
+	// write the changes of a created file back to disk
+	bool sync();
+	void close();
+
+	char* data() { return addr; }
+	const char* data() const { return addr; }
+	size_t size() const { return len; }
+
+	// hint the kernel about the access pattern of [offset, offset+length)
+	void adviseSequential(const size_t offset = 0, const size_t length = 0);
+	void adviseWillNeed(const size_t offset = 0, const size_t length = 0);
+	// drop the pages fully inside [offset, offset+length) from memory.
+	// the content is read from the file again on next access, in-memory changes of a private mapping are lost.
+	void release(const size_t offset, const size_t length);
+};
@@ -0,0 +1,161 @@
+#include "TableParser.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// powers of 10 that are exact in double
+const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+inline bool isDigit(const char c){
+	return c >= '0' && c <= '9';
+}
+
+// the slow but exact way, for the numbers out of the fast path (long mantissa, large exponent, nan, inf, hex)
+bool parseDoubleSlow(const char* first, const char* last, double& v){
+	char buffer[128];
+	size_t n = static_cast<size_t>(last - first);
+	char* end;
+	if(n < sizeof(buffer)){
+		memcpy(buffer, first, n);
+		buffer[n] = '\0';
+		v = strtod(buffer, &end);
+		return end != buffer;
+	}
+	string tmp(first, last);
+	v = strtod(tmp.c_str(), &end);
+	return end != tmp.c_str();
+}
+
+} // namespace
+
+bool parseDouble(const char* first, const char* last, double& v)
+{
+	const char* p = first;
+	while(p != last && (*p == ' ' || *p == '\t'))
+		++p;
+	bool neg = false;
+	if(p != last && (*p == '-' || *p == '+')){
+		neg = *p == '-';
+		++p;
+	}
+	uint64_t m = 0; // mantissa
+	int nd = 0; // number of significant digits in <m>
+	int e10 = 0;
+	bool any = false;
+	for(; p != last && isDigit(*p); ++p){
+		any = true;
+		if(nd < 19){
+			m = m * 10 + (*p - '0');
+			nd += m != 0;
+		} else{
+			++e10;
+			nd = 20; // mark as truncated
+		}
+	}
+	if(p != last && *p == '.'){
+		++p;
+		for(; p != last && isDigit(*p); ++p){
+			any = true;
+			if(nd < 19){
+				m = m * 10 + (*p - '0');
+				nd += m != 0;
+				--e10;
+			} else{
+				nd = 20;
+			}
+		}
+	}
+	if(!any)
+		return parseDoubleSlow(first, last, v);
+	if(p != last && (*p == 'e' || *p == 'E')){
+		const char* q = p + 1;
+		bool eneg = false;
+		if(q != last && (*q == '-' || *q == '+')){
+			eneg = *q == '-';
+			++q;
+		}
+		if(q != last && isDigit(*q)){
+			int e = 0;
+			for(; q != last && isDigit(*q); ++q)
+				if(e < 100000)
+					e = e * 10 + (*q - '0');
+			e10 += eneg ? -e : e;
+		}
+	}
+	// exact when both the mantissa and the power of 10 are exact doubles
+	if(nd <= 15 && e10 >= -22 && e10 <= 22){
+		double d = static_cast<double>(m);
+		d = e10 < 0 ? d / POW10[-e10] : d * POW10[e10];
+		v = neg ? -d : d;
+		return true;
+	}
+	return parseDoubleSlow(first, last, v);
+}
+
+TableParser::TableParser(const std::string& sepper, const size_t ncol,
+	const std::vector<int>& skips, const std::vector<int>& yIds)
+	: sepper(sepper), roles(ncol, Role::X)
+{
+	for(size_t i = 0; i < ncol; ++i){
+		const int id = static_cast<int>(i);
+		if(find(skips.begin(), skips.end(), id) != skips.end())
+			roles[i] = Role::Skip;
+		else if(find(yIds.begin(), yIds.end(), id) != yIds.end())
+			roles[i] = Role::Y;
+	}
+	nx = count(roles.begin(), roles.end(), Role::X);
+	ny = count(roles.begin(), roles.end(), Role::Y);
+	// trailing skipped columns do not need to be scanned
+	while(!roles.empty() && roles.back() == Role::Skip)
+		roles.pop_back();
+}
+
+size_t TableParser::countColumn(const char* first, const char* last, const std::string& sepper)
+{
+	size_t n = 1;
+	const char* p = search(first, last, sepper.begin(), sepper.end());
+	while(p != last){
+		++n;
+		p = search(p + 1, last, sepper.begin(), sepper.end());
+	}
+	return n;
+}
+
+const char* TableParser::findSepper(const char* first, const char* last) const
+{
+	if(sepper.size() == 1){
+		const void* p = memchr(first, sepper[0], last - first);
+		return p == nullptr ? last : static_cast<const char*>(p);
+	}
+	return search(first, last, sepper.begin(), sepper.end());
+}
+
+bool TableParser::parse(const char* first, const char* last, double* x, double* y) const
+{
+	const size_t ncol = roles.size();
+	const char* p = first;
+	for(size_t col = 0; col < ncol; ++col){
+		const char* q = findSepper(p, last);
+		const Role r = roles[col];
+		if(r != Role::Skip){
+			double v;
+			if(!parseDouble(p, q, v))
+				return false;
+			if(r == Role::X)
+				*x++ = v;
+			else
+				*y++ = v;
+		}
+		if(q == last)
+			break;
+		p = q + sepper.size();
+	}
+	return true;
+}
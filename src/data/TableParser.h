@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// parse a floating point number at the beginning of [first, last), like stod.
+// leading spaces and trailing characters are ignored. return false if there is no number.
+bool parseDouble(const char* first, const char* last, double& v);
+
+// Allocation-free parser for one line of a delimited text table.
+// The role of each column (x, y or skipped) is precomputed in a lookup table.
+class TableParser {
+public:
+	enum class Role : char { Skip, X, Y };
+private:
+	std::string sepper;
+	std::vector<Role> roles; // role of column i, columns beyond the table are skipped
+	size_t nx = 0, ny = 0;
+public:
+	// <ncol>: number of columns of the table
+	TableParser(const std::string& sepper, const size_t ncol,
+		const std::vector<int>& skips, const std::vector<int>& yIds);
+
+	// number of columns in a line (the first line decides the table width)
+	static size_t countColumn(const char* first, const char* last, const std::string& sepper);
+
+	size_t xlength() const { return nx; }
+	size_t ylength() const { return ny; }
+
+	// whether [first, last) (without '\n') is a data line
+	bool isData(const char* first, const char* last) const {
+		return first != last && static_cast<size_t>(last - first) >= nx && *first != '#';
+	}
+	// write the values of a data line into <x> (<nx> values) and <y> (<ny> values).
+	// missing columns leave their values untouched. return false on a malformed field,
+	// the fields after it are not parsed.
+	bool parse(const char* first, const char* last, double* x, double* y) const;
+
+private:
+	const char* findSepper(const char* first, const char* last) const;
+};
@@ -397,7 +397,7 @@ void Master::sendParameter(const int target)
 {
 	Timer tmr;
 	DVLOG(3) << "send parameter to " << target << " with: " << model.getParameter().weights;
-	net->send(wm.lid2nid(target), MType::DParameter, model.getParameter().weights);
+	net->send(wm.lid2nid(target), MType::DParameter, serializeWeights(model.getParameter().weights));
 	mtParameterSum += tmr.elapseSd();
 	++stat.n_par_send;
 }
@@ -407,7 +407,7 @@ void Master::broadcastParameter()
 	Timer tmr;
 	const auto& m = model.getParameter().weights;
 	DVLOG(3) << "broadcast parameter: " << m;
-	net->broadcast(MType::DParameter, m);
+	net->broadcast(MType::DParameter, serializeWeights(m));
 	mtParameterSum += tmr.elapseSd();
 	stat.n_par_send += nWorker;
 }
@@ -420,7 +420,7 @@ void Master::multicastParameter(const int source)
 	DVLOG(3) << "multicast parameter: " << m << " to " << targets;
 	for(int& v : targets)
 		v=wm.lid2nid(v);
-	net->multicast(targets, MType::DParameter, m);
+	net->multicast(targets, MType::DParameter, serializeWeights(m));
 	mtParameterSum += tmr.elapseSd();
 	stat.n_par_send += targets.size();
 }
@@ -793,7 +793,7 @@ void Master::handleClosed(const std::string & data, const RPCInfo & info)
 void Master::handleParameter(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	vector<double> param = deserialize<vector<double>>(data);
+	vector<double> param = deserializeWeights(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	tmr.restart();
 	int s = wm.nid2lid(info.source);
@@ -814,7 +814,7 @@ void Master::handleLoss(const std::string& data, const RPCInfo& info)
 void Master::handleDeltaTail(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -840,7 +840,7 @@ void Master::handleReportPap(const std::string& data, const RPCInfo& info)
 void Master::handleDeltaBsp(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -854,7 +854,7 @@ void Master::handleDeltaBsp(const std::string & data, const RPCInfo & info)
 void Master::handleDeltaTap(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -870,7 +870,7 @@ void Master::handleDeltaTap(const std::string & data, const RPCInfo & info)
 void Master::handleDeltaSsp(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	size_t n = get<0>(deltaMsg);
@@ -895,7 +895,7 @@ void Master::handleDeltaSsp(const std::string & data, const RPCInfo & info)
 void Master::handleDeltaSap(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -911,7 +911,7 @@ void Master::handleDeltaSap(const std::string & data, const RPCInfo & info)
 void Master::handleDeltaFsp(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	int s = wm.nid2lid(info.source);
 	size_t n = get<0>(deltaMsg);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -926,7 +926,7 @@ void Master::handleDeltaFsp(const std::string & data, const RPCInfo & info)
 void Master::handleDeltaAap(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -946,7 +946,7 @@ void Master::handleDeltaAap(const std::string & data, const RPCInfo & info)
 void Master::handleDeltaPap(const std::string& data, const RPCInfo& info)
 {
 	Timer tmr;
-	auto deltaMsg = deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto deltaMsg = deserializeDelta(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	int s = wm.nid2lid(info.source);
 	commonHandleDelta(s, get<0>(deltaMsg), get<2>(deltaMsg), tmrTrain.elapseSd());
@@ -2,6 +2,7 @@
 #include "network/NetworkThread.h"
 #include "message/MType.h"
 #include "logging/logging.h"
+#include "serial/serialization.h"
 #include <sstream>
 using namespace std;
 
@@ -184,3 +185,34 @@ void Runner::sendReply(const RPCInfo & info, const int type){
 	net->send(info.source, CType::NormalControl,
 		make_pair(MType::CReply, type));
 }
+
+std::string Runner::serializeWeights(const std::vector<double>& w) const
+{
+	if(!conf->float32)
+		return serialize(w);
+	return serialize(vector<float>(w.begin(), w.end()));
+}
+
+std::vector<double> Runner::deserializeWeights(const std::string& data) const
+{
+	if(!conf->float32)
+		return deserialize<vector<double>>(data);
+	vector<float> t = deserialize<vector<float>>(data);
+	return vector<double>(t.begin(), t.end());
+}
+
+std::string Runner::serializeDelta(const size_t cnt, const std::vector<double>& delta, const double loss) const
+{
+	if(!conf->float32)
+		return serialize(make_tuple(cnt, delta, loss));
+	return serialize(make_tuple(cnt, vector<float>(delta.begin(), delta.end()), loss));
+}
+
+std::tuple<size_t, std::vector<double>, double> Runner::deserializeDelta(const std::string& data) const
+{
+	if(!conf->float32)
+		return deserialize<tuple<size_t, vector<double>, double>>(data);
+	auto t = deserialize<tuple<size_t, vector<float>, double>>(data);
+	const vector<float>& d = get<1>(t);
+	return make_tuple(get<0>(t), vector<double>(d.begin(), d.end()), get<2>(t));
+}
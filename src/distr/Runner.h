@@ -10,6 +10,7 @@
 #include "common/ConfData.h"
 #include <string>
 #include <thread>
+#include <tuple>
 //#include <chrono>
 
 class NetworkThread;
@@ -65,6 +66,12 @@ protected:
 
 	void sendReply(const RPCInfo& info, const int type);
 
+	// payloads of MType::DParameter and MType::DDelta. the vector is sent in float32 if conf->float32 is set
+	std::string serializeWeights(const std::vector<double>& w) const;
+	std::vector<double> deserializeWeights(const std::string& data) const;
+	std::string serializeDelta(const size_t cnt, const std::vector<double>& delta, const double loss) const;
+	std::tuple<size_t, std::vector<double>, double> deserializeDelta(const std::string& data) const;
+
 	// handlers
 public:
 	// void handleReply(const std::string& d, const RPCInfo& info);
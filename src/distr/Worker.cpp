@@ -35,6 +35,8 @@ void Worker::init(const ConfData* conf, const size_t lid)
 	trainer = TrainerFactory::generate(conf->optimizer, conf->optimizerParam);
 	LOG_IF(trainer == nullptr, FATAL) << "Trainer is not set correctly";
 	model.init(conf->algorighm, conf->algParam);
+	if(conf->float32 && !model.setFloat32(true))
+		LOG(INFO) << "Algorithm " << conf->algorighm << " computes in double, only the messages use float32";
 	initSpeedAdjustment();
 
 	if(!conf->probe){
@@ -49,6 +51,21 @@ void Worker::bindDataset(const DataHolder* pdh)
 	VLOG(1) << "Bind dataset with " << pdh->size() << " data points";
 	this->pdh = pdh;
 	trainer->bindDataset(pdh);
+	DataOrder::Mode om = DataOrder::parseMode(conf->dataOrder);
+	if(om != DataOrder::Mode::Sequential && pdh->isStreaming()){
+		LOG(WARNING) << "Data order " << conf->dataOrder << " is ignored in out-of-core mode";
+	} else if(om != DataOrder::Mode::Sequential && !trainer->supportDataOrder()){
+		LOG(WARNING) << "Data order " << conf->dataOrder << " is ignored by trainer " << trainer->name();
+	} else if(om != DataOrder::Mode::Sequential){
+		size_t bytesPerPoint = max<size_t>(1, pdh->memoryBytes() / max<size_t>(1, pdh->size()));
+		size_t block = max<size_t>(1, conf->dataOrderBlock / bytesPerPoint);
+		trainer->setDataOrder(om, block, conf->seed + static_cast<unsigned>(localID));
+		VLOG(1) << "Data order: " << conf->dataOrder << (om == DataOrder::Mode::Block ? ", points per block: " + to_string(block) : "");
+	}
+	if(conf->dataPipeline)
+		trainer->enablePipeline(true);
+	if(conf->nThread > 1)
+		trainer->setThreads(conf->nThread);
 }
 
 void Worker::run()
@@ -170,8 +187,10 @@ void Worker::updatePointer(const size_t scan, const size_t report)
 {
 	DVLOG(3) << "update pointer from " << dataPointer << " by " << scan;
 	dataPointer += scan;
-	if(dataPointer >= trainer->pd->size())
+	if(dataPointer >= trainer->pd->size()){
 		dataPointer = 0;
+		trainer->nextEpoch();
+	}
 	stat.n_point += report;
 }
 
@@ -231,7 +250,7 @@ void Worker::sendDelta(std::vector<double>& delta, const size_t cnt, const doubl
 {
 	DVLOG(3) << "send delta: " << delta;
 	//DVLOG_EVERY_N(ln, 1) << "n-send: " << iter << " un-cmt msg: " << net->pending_pkgs() << " cmt msg: " << net->stat_send_pkg;
-	net->send(masterNID, MType::DDelta, make_tuple(move(cnt), move(delta), move(loss)));
+	net->send(masterNID, MType::DDelta, serializeDelta(cnt, delta, loss));
 	++stat.n_dlt_send;
 }
 
@@ -240,7 +259,7 @@ void Worker::initializeParameter()
 	if(!conf->resume){
 		if(model.getKernel()->needInitParameterByData()){
 			// model.param is set in trainer->ready()
-			net->send(masterNID, MType::DParameter, model.getParameter().weights);
+			net->send(masterNID, MType::DParameter, serializeWeights(model.getParameter().weights));
 		}
 	}
 	waitParameter();
@@ -286,7 +305,8 @@ double Worker::calcLoss(const size_t start, const size_t cnt)
 	double loss = 0.0;
 	// size_t end = min(cnt, pdh->size());
 	for(size_t i = 0; i < cnt; ++i){
-		size_t dp = (start+i) % pdh->size();
+		// the same points as the ones trained from position <start>
+		size_t dp = trainer->dataIndex((start+i) % pdh->size());
 		double l = model.loss(pdh->get(dp));
 		loss += l;
 	}
@@ -731,7 +731,7 @@ void Worker::papOnlineProbeFile()
 	clearDelta();
 	resumeTrain();
 	size_t probeSize = static_cast<size_t>(pdh->size() * conf->probeRatio);
-	size_t left = max(probeSize, 1);
+	size_t left = max<size_t>(probeSize, 1);
 	Trainer::DeltaResult dr = trainer->batchDelta(allowTrain, dataPointer, left, false, dly);
 	updatePointer(dr.n_scanned, dr.n_reported);
 	size_t n_used = dr.n_reported;
@@ -764,7 +764,7 @@ void Worker::papOnlineProbeFile()
 void Worker::handleParameter(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto weights = deserialize<vector<double>>(data);
+	auto weights = deserializeWeights(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	Parameter p;
 	p.set(move(weights));
@@ -777,7 +777,7 @@ void Worker::handleParameter(const std::string & data, const RPCInfo & info)
 void Worker::handleParameterSsp(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto weights = deserialize<vector<double>>(data);
+	auto weights = deserializeWeights(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	Parameter p;
 	p.set(move(weights));
@@ -791,7 +791,7 @@ void Worker::handleParameterSsp(const std::string & data, const RPCInfo & info)
 void Worker::handleParameterFsp(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto weights = deserialize<vector<double>>(data);
+	auto weights = deserializeWeights(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	Parameter p;
 	p.set(move(weights));
@@ -806,7 +806,7 @@ void Worker::handleParameterFsp(const std::string & data, const RPCInfo & info)
 void Worker::handleParameterAap(const std::string & data, const RPCInfo & info)
 {
 	Timer tmr;
-	auto weights = deserialize<vector<double>>(data);
+	auto weights = deserializeWeights(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	Parameter p;
 	p.set(move(weights));
@@ -822,7 +822,7 @@ void Worker::handleParameterAap(const std::string & data, const RPCInfo & info)
 void Worker::handleParameterPap(const std::string& data, const RPCInfo& info)
 {
 	Timer tmr;
-	auto weights = deserialize<vector<double>>(data);
+	auto weights = deserializeWeights(data);
 	stat.t_data_deserial += tmr.elapseSd();
 	Parameter p;
 	p.set(move(weights));
@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <functional>
 #include <vector>
+#include <cstddef>
 
 /*
  * This is a helper class for handling reply message. It invokes registered
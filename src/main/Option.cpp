@@ -7,6 +7,7 @@
 #include <boost/program_options.hpp>
 #include "util/Util.h"
 #include "data/DataLoader.h"
+#include "data/DataOrder.h"
 #include "model/KernelFactory.h"
 #include "train/TrainerFactory.h"
 
@@ -33,6 +34,8 @@ bool Option::parse(int argc, char * argv[], const size_t nWorker)
 	string tmp_interval;
 	string tmp_ids, tmp_idy;
 	string tmp_bs, tmp_rs;
+	string tmp_stream;
+	string tmp_order;
 	string tmp_sr, tmp_sh;
 	string tmp_t_point, tmp_t_delta, tmp_t_iter;
 	string tmp_a_iter, tmp_l_iter;
@@ -45,7 +48,7 @@ bool Option::parse(int argc, char * argv[], const size_t nWorker)
 	string desc_opt = "The optimizer to adopt. "
 		"Support: " + VecToString(TrainerFactory::supportList());
 	string desc_dl = "The dataset/type to use. Give dataset name (mnist) or "
-		"type (csv, tsv, customize, list (variable length x)). "
+		"type (csv, tsv, customize, list (variable length x), libsvm (sparse x)). "
 		"Support: " + VecToString(DataLoader::supportList());;
 
 	using boost::program_options::value;
@@ -92,6 +95,12 @@ bool Option::parse(int argc, char * argv[], const size_t nWorker)
 		("batch_size,s", value(&tmp_bs)->required(), "The global batch size. Support suffix: k, m, g.")
 		("report_size", value(&tmp_rs)->default_value("1"), "The local report size. Support suffix: k, m, g.")
 		("optimizer,o", value(&conf.optimizer)->required()->default_value("gd:0.01"), desc_opt.c_str())
+		("threads", value(&conf.nThread)->default_value(1),
+			"The number of threads computing the gradient of a mini-batch in each worker. "
+			"It takes effect with the gd optimizer.")
+		("float32", bool_switch(&conf.float32)->default_value(false),
+			"Compute the mini-batch gradient in float32 if the algorithm supports it (mlp), "
+			"and send parameters and deltas in float32. The parameter is kept and updated in double.")
 		// file - input
 		("dataset", value(&conf.dataset)->default_value("csv"), desc_dl.c_str())
 		("trainpart", bool_switch(&conf.trainPart)->default_value(true),
@@ -101,6 +110,28 @@ bool Option::parse(int argc, char * argv[], const size_t nWorker)
 		("normalize,n", bool_switch(&conf.normalize)->default_value(false),
 			"Whether to do normailzation on the input file.")
 		("shuffle", bool_switch(&conf.shuffle)->default_value(false), "Randomly shuffle the dataset.")
+		("data_cache", bool_switch(&conf.dataCache)->default_value(false),
+			"Cache the parsed text data file in a binary file and reuse it later.")
+		("data_cache_dir", value(&conf.dataCacheDir)->default_value(""),
+			"The directory of the data cache. Empty means next to the data file.")
+		("data_byte_range", bool_switch(&conf.dataByteRange)->default_value(false),
+			"Each worker reads only its own contiguous 1/<nw> (in bytes) of a text data file, "
+			"instead of scanning the whole file for every <nw>-th line. "
+			"The local part sizes may differ slightly.")
+		("data_stream", value(&tmp_stream)->default_value("0"),
+			"Out-of-core mode for data larger than the memory (requires --data_cache, not for libsvm data). "
+			"Only a sliding window of chunks of this size (in bytes) is kept in memory, "
+			"the next ones are read in the background. 0 means off. Support suffix: k, m, g.")
+		("data_pipeline", bool_switch(&conf.dataPipeline)->default_value(false),
+			"Gather the next mini-batch into a contiguous buffer (in double) on a helper thread "
+			"while the current one is computed.")
+		("data_order", value(&tmp_order)->default_value("sequential"),
+			"The order of visiting the data points in each epoch, the points are not moved. "
+			"Supports: sequential, point (a new random permutation in each epoch), "
+			"block:x (a new random permutation of blocks of x bytes in each epoch, default 4k). Support suffix: k, m, g.")
+		("data_type", value(&conf.dataType)->default_value("double"),
+			"Storage type of x in memory. Supports: double, float, uint8, int8. "
+			"The 8-bit types use a per-column linear quantization.")
 		// file - input - table
 		("header", bool_switch(&conf.header)->default_value(false), 
 			"Whether the input file contain a header line")
@@ -110,6 +141,9 @@ bool Option::parse(int argc, char * argv[], const size_t nWorker)
 			"A space/comma separated list of integers and a-b (a, a+1, a+2, ..., b)")
 		// file - input - list (variable-length x)
 		("unit", value(&conf.lenUnit)->default_value(0), "Length of one x unit for the variable length input (RNN).")
+		// file - input - sparse
+		("sparse_dim", value(&conf.sparseDim)->default_value(0),
+			"Number of features of the sparse input (libsvm). 0 means the largest index in the file.")
 		("ylist,y", value(&tmp_idy)->default_value({}, ""),
 			"The columns to be used as y in the data file. "
 			"A space/comma separated list of integers and a-b (a, a+1, a+2, ..., b)")
@@ -145,6 +179,14 @@ bool Option::parse(int argc, char * argv[], const size_t nWorker)
 		conf.idY = getIntListByRange(tmp_idy);
 		conf.batchSize = stoiKMG(tmp_bs);
 		conf.reportSize = stoiKMG(tmp_rs);
+		conf.dataStreamChunk = stoulKMG(tmp_stream, true);
+		{
+			vector<string> t = getStringList(tmp_order, ":");
+			conf.dataOrder = t.empty() ? "sequential" : t[0];
+			conf.dataOrderBlock = t.size() > 1 ? stoulKMG(t[1], true) : 4096;
+			DataOrder::parseMode(conf.dataOrder); // check it
+		}
+		parseDType(conf.dataType); // check it
 		if(conf.reportSize == 0)
 			conf.reportSize = conf.batchSize / conf.nw;
 		conf.tcPoint = stoiKMG(tmp_t_point);
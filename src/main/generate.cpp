@@ -254,7 +254,7 @@ int main(int argc, char* argv[]){
 	mt19937 gen(opt.seed);
 
 	try{
-		Kernel* k = KernelFactory::generate(opt.algorithm);
+		Kernel* k = KernelFactory::generate(opt.algorithm, opt.param);
 		k->init(opt.param);
 		if(!k->checkData(opt.xlength, opt.ylength)){
 			cerr << "Error: Dataset does not match model." << endl;
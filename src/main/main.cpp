@@ -61,7 +61,10 @@ int main(int argc, char* argv[]){
 			// dataset
 			<< "\nDataset: " << opt.conf.dataset << "\tLocation: " << opt.conf.fnData
 			<< "\n  Normalize: " << opt.conf.normalize << "\tRandom Shuffle: " << opt.conf.shuffle
-			<< "\tTrainPart: " << opt.conf.trainPart
+			<< "\tTrainPart: " << opt.conf.trainPart << "\tCache: " << opt.conf.dataCache << " " << opt.conf.dataCacheDir
+			<< "\tByte-range partition: " << opt.conf.dataByteRange << "\tStream chunk: " << opt.conf.dataStreamChunk
+			<< "\tData type: " << opt.conf.dataType << "\tPipeline: " << opt.conf.dataPipeline
+			<< "\tOrder: " << opt.conf.dataOrder
 			<< "\n  Separator: " << opt.conf.sepper << "\tIdx-y: " << opt.conf.idY << "\tIdx-skip: " << opt.conf.idSkip
 			// cluster
 			<< "\nCluster: " << "\tWorker-#: " << opt.conf.nw << "\tSpeed random: " << opt.conf.adjustSpeedRandom
@@ -100,22 +103,42 @@ int main(int argc, char* argv[]){
 		try{
 			DataLoader dl;
 			dl.init(opt.conf.dataset, opt.conf.nw, lid, true);
+			dl.setCache(opt.conf.dataCache, opt.conf.dataCacheDir);
+			dl.setByteRangePartition(opt.conf.dataByteRange);
+			DType dtype = parseDType(opt.conf.dataType);
+			dl.setDataType(dtype, opt.conf.normalize);
 			if(opt.conf.dataset == "csv" || opt.conf.dataset == "tsv" || opt.conf.dataset == "customize")
 				dl.bindParameterTable(opt.conf.sepper, opt.conf.idSkip, opt.conf.idY, opt.conf.header);
 			else if(opt.conf.dataset == "list")
 				dl.bindParameterVarLen(opt.conf.sepper, opt.conf.lenUnit, opt.conf.idY);
+			else if(opt.conf.dataset == "libsvm")
+				dl.bindParameterSparse(opt.conf.sparseDim);
+			// fail before reading a file that may not fit in the memory
+			if(opt.conf.dataStreamChunk != 0 && opt.conf.dataset == "libsvm")
+				throw invalid_argument("Out-of-core mode does not support sparse (libsvm) data");
 			VLOG(1) << "Loading data";
 			size_t localk = opt.conf.topk / opt.conf.nw + (lid < opt.conf.topk%opt.conf.nw ? 1 : 0);
 			dh = dl.load(opt.conf.fnData, opt.conf.trainPart, localk);
-			DVLOG(2) << "data[0]: " << dh.get(0).x << " -> " << dh.get(0).y;
-			if(opt.conf.normalize){
-				dh.normalize(false);
-				DVLOG(2) << "data[0]: " << dh.get(0).x << " -> " << dh.get(0).y;
-			}
-			if(opt.conf.shuffle){
+			DVLOG(2) << "data[0]: " << dh.get(0).x.toVector() << " -> " << dh.get(0).y.toVector();
+			if(dtype != DType::Double)
+				VLOG(1) << "Data is stored as " << opt.conf.dataType << ", " << dh.memoryBytes() << " bytes";
+			if(opt.conf.shuffle && opt.conf.dataStreamChunk != 0){
+				LOG(WARNING) << "Shuffle is skipped in out-of-core mode";
+			} else if(opt.conf.shuffle){
 				VLOG(1) << "Shuffle data";
 				dh.shuffle();
 			}
+			if(opt.conf.dataStreamChunk != 0){
+				if(dh.dataType() != DType::Double)
+					LOG(WARNING) << "Out-of-core mode does not support reduced-precision data, the data is kept in memory";
+				else if(!dh.isMapped() && opt.conf.dataCache && opt.conf.dataset == "list")
+					LOG(WARNING) << "Variable-length data is loaded fully to build the cache, it is streamed from the next run";
+				else if(!dh.isMapped())
+					LOG(WARNING) << "Out-of-core mode needs the data cache, the data is kept in memory";
+				else if(opt.conf.normalize)
+					LOG(WARNING) << "Normalized data is kept in memory in out-of-core mode";
+				dh.enableStreaming(opt.conf.dataStreamChunk);
+			}
 		} catch(exception& e){
 			LOG(FATAL) << "Error in loading data file: " << opt.conf.fnData << "\n" << e.what() << endl;
 		}
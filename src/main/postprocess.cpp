@@ -139,7 +139,7 @@ TaskResult evaluateOne(Parameter& param, Model& m,
 	double loss = 0.0;
 	size_t correct = 0;
 	for(size_t i = 0; i < dh.size(); ++i){
-		auto& d = dh.get(i);
+		auto d = dh.get(i);
 		auto p = m.predict(d);
 		loss += m.loss(p, d.y);
 		if(!doAccuracy)
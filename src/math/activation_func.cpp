@@ -1,5 +1,13 @@
 #include "activation_func.h"
+#include "simd.h"
 #include <cmath>
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ACT_X86
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 double sigmoid(double x) {
@@ -96,3 +104,332 @@ std::vector<std::vector<double>> softmax_derivative(const std::vector<double>& x
 	}
 	return res;
 }
+
+// ---- array versions ----
+
+namespace {
+
+enum class Op { Exp, Sigmoid, Tanh };
+
+ActivationMode g_mode = ActivationMode::Fast;
+
+template <Op op, typename T>
+T exact(const T x){
+	switch(op){
+	case Op::Exp: return exp(x);
+	case Op::Sigmoid: return static_cast<T>(sigmoid(x));
+	default: return tanh(x);
+	}
+}
+
+#ifdef ACT_X86
+
+// exp(x) = 2^k * exp(r), x = k*ln2 + r with |r| <= ln2/2, exp(r) by its Taylor series.
+// ln2 is split in two parts (Cody-Waite) so that k*ln2hi is exact.
+// the double series has 14 terms (error < 2e-16), the float one 8 (error < 6e-9).
+// the input is clamped where 2^k stays a normal number, NaN is kept
+constexpr double EXP_HI = 700.0, EXP_LO = -700.0;
+constexpr double LOG2E = 1.4426950408889634074;
+constexpr double LN2_HI = 6.93147180369123816490e-01, LN2_LO = 1.90821492927058770002e-10;
+constexpr double EXP_C[] = { 1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+	1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0 };
+constexpr float EXPF_HI = 88.0f, EXPF_LO = -87.0f;
+constexpr float LN2F_HI = 0.693359375f, LN2F_LO = -2.12194440e-4f;
+constexpr float EXPF_C[] = { 1.0f / 5040.0f, 1.0f / 720.0f, 1.0f / 120.0f, 1.0f / 24.0f,
+	1.0f / 6.0f, 0.5f, 1.0f, 1.0f };
+// tanh(x) is 1 in the precision beyond these
+constexpr double TANH_MAX = 20.0;
+constexpr float TANHF_MAX = 9.0f;
+
+// -------- AVX2 --------
+
+__attribute__((target("avx2,fma")))
+inline __m256d exp_avx2(__m256d x){
+	x = _mm256_min_pd(_mm256_set1_pd(EXP_HI), _mm256_max_pd(_mm256_set1_pd(EXP_LO), x));
+	const __m256d k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(LOG2E)),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_HI), x);
+	r = _mm256_fnmadd_pd(k, _mm256_set1_pd(LN2_LO), r);
+	__m256d p = _mm256_set1_pd(EXP_C[0]);
+	for(size_t i = 1; i < sizeof(EXP_C) / sizeof(double); ++i)
+		p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(EXP_C[i]));
+	const __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+	const __m256i s = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+	return _mm256_mul_pd(p, _mm256_castsi256_pd(s));
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 exp_avx2(__m256 x){
+	x = _mm256_min_ps(_mm256_set1_ps(EXPF_HI), _mm256_max_ps(_mm256_set1_ps(EXPF_LO), x));
+	const __m256 k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(static_cast<float>(LOG2E))),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2F_HI), x);
+	r = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2F_LO), r);
+	__m256 p = _mm256_set1_ps(EXPF_C[0]);
+	for(size_t i = 1; i < sizeof(EXPF_C) / sizeof(float); ++i)
+		p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXPF_C[i]));
+	const __m256i s = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(s));
+}
+
+template <Op op>
+__attribute__((target("avx2,fma")))
+inline __m256d apply_avx2(const __m256d x){
+	const __m256d one = _mm256_set1_pd(1.0);
+	if(op == Op::Exp)
+		return exp_avx2(x);
+	if(op == Op::Sigmoid) // 1 / (1 + exp(-x))
+		return _mm256_div_pd(one, _mm256_add_pd(one, exp_avx2(_mm256_sub_pd(_mm256_setzero_pd(), x))));
+	// tanh(|x|) = 1 - 2 / (exp(2|x|) + 1), with the sign of x
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d a = _mm256_min_pd(_mm256_set1_pd(TANH_MAX), _mm256_andnot_pd(sign, x));
+	const __m256d e = exp_avx2(_mm256_add_pd(a, a));
+	const __m256d t = _mm256_sub_pd(one, _mm256_div_pd(_mm256_set1_pd(2.0), _mm256_add_pd(e, one)));
+	return _mm256_or_pd(t, _mm256_and_pd(sign, x));
+}
+
+template <Op op>
+__attribute__((target("avx2,fma")))
+inline __m256 apply_avx2(const __m256 x){
+	const __m256 one = _mm256_set1_ps(1.0f);
+	if(op == Op::Exp)
+		return exp_avx2(x);
+	if(op == Op::Sigmoid)
+		return _mm256_div_ps(one, _mm256_add_ps(one, exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 a = _mm256_min_ps(_mm256_set1_ps(TANHF_MAX), _mm256_andnot_ps(sign, x));
+	const __m256 e = exp_avx2(_mm256_add_ps(a, a));
+	const __m256 t = _mm256_sub_ps(one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, one)));
+	return _mm256_or_ps(t, _mm256_and_ps(sign, x));
+}
+
+// the tail goes through a padded copy, so that every value gets the same approximation
+template <Op op>
+__attribute__((target("avx2,fma")))
+void array_avx2(const double* x, double* y, const size_t n){
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(y + i, apply_avx2<op>(_mm256_loadu_pd(x + i)));
+	if(i < n){
+		double t[4] = { 0.0, 0.0, 0.0, 0.0 };
+		copy(x + i, x + n, t);
+		_mm256_storeu_pd(t, apply_avx2<op>(_mm256_loadu_pd(t)));
+		copy(t, t + (n - i), y + i);
+	}
+}
+
+template <Op op>
+__attribute__((target("avx2,fma")))
+void array_avx2(const float* x, float* y, const size_t n){
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(y + i, apply_avx2<op>(_mm256_loadu_ps(x + i)));
+	if(i < n){
+		float t[8] = {};
+		copy(x + i, x + n, t);
+		_mm256_storeu_ps(t, apply_avx2<op>(_mm256_loadu_ps(t)));
+		copy(t, t + (n - i), y + i);
+	}
+}
+
+// -------- AVX-512 --------
+// only AVX512F: the bit operations go through the integer registers
+
+__attribute__((target("avx512f")))
+inline __m512d exp_avx512(__m512d x){
+	x = _mm512_min_pd(_mm512_set1_pd(EXP_HI), _mm512_max_pd(_mm512_set1_pd(EXP_LO), x));
+	const __m512d k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(LOG2E)),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(LN2_HI), x);
+	r = _mm512_fnmadd_pd(k, _mm512_set1_pd(LN2_LO), r);
+	__m512d p = _mm512_set1_pd(EXP_C[0]);
+	for(size_t i = 1; i < sizeof(EXP_C) / sizeof(double); ++i)
+		p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(EXP_C[i]));
+	const __m512i e = _mm512_cvtepi32_epi64(_mm512_cvtpd_epi32(k));
+	const __m512i s = _mm512_slli_epi64(_mm512_add_epi64(e, _mm512_set1_epi64(1023)), 52);
+	return _mm512_mul_pd(p, _mm512_castsi512_pd(s));
+}
+
+__attribute__((target("avx512f")))
+inline __m512 exp_avx512(__m512 x){
+	x = _mm512_min_ps(_mm512_set1_ps(EXPF_HI), _mm512_max_ps(_mm512_set1_ps(EXPF_LO), x));
+	const __m512 k = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(static_cast<float>(LOG2E))),
+		_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2F_HI), x);
+	r = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2F_LO), r);
+	__m512 p = _mm512_set1_ps(EXPF_C[0]);
+	for(size_t i = 1; i < sizeof(EXPF_C) / sizeof(float); ++i)
+		p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXPF_C[i]));
+	const __m512i s = _mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(k), _mm512_set1_epi32(127)), 23);
+	return _mm512_mul_ps(p, _mm512_castsi512_ps(s));
+}
+
+template <Op op>
+__attribute__((target("avx512f")))
+inline __m512d apply_avx512(const __m512d x){
+	const __m512d one = _mm512_set1_pd(1.0);
+	if(op == Op::Exp)
+		return exp_avx512(x);
+	if(op == Op::Sigmoid)
+		return _mm512_div_pd(one, _mm512_add_pd(one, exp_avx512(_mm512_sub_pd(_mm512_setzero_pd(), x))));
+	const __m512i sign = _mm512_set1_epi64(static_cast<long long>(1ull << 63));
+	const __m512i xi = _mm512_castpd_si512(x);
+	const __m512d a = _mm512_min_pd(_mm512_set1_pd(TANH_MAX), _mm512_castsi512_pd(_mm512_andnot_si512(sign, xi)));
+	const __m512d e = exp_avx512(_mm512_add_pd(a, a));
+	const __m512d t = _mm512_sub_pd(one, _mm512_div_pd(_mm512_set1_pd(2.0), _mm512_add_pd(e, one)));
+	return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(t), _mm512_and_si512(sign, xi)));
+}
+
+template <Op op>
+__attribute__((target("avx512f")))
+inline __m512 apply_avx512(const __m512 x){
+	const __m512 one = _mm512_set1_ps(1.0f);
+	if(op == Op::Exp)
+		return exp_avx512(x);
+	if(op == Op::Sigmoid)
+		return _mm512_div_ps(one, _mm512_add_ps(one, exp_avx512(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+	const __m512i sign = _mm512_set1_epi32(static_cast<int>(1u << 31));
+	const __m512i xi = _mm512_castps_si512(x);
+	const __m512 a = _mm512_min_ps(_mm512_set1_ps(TANHF_MAX), _mm512_castsi512_ps(_mm512_andnot_si512(sign, xi)));
+	const __m512 e = exp_avx512(_mm512_add_ps(a, a));
+	const __m512 t = _mm512_sub_ps(one, _mm512_div_ps(_mm512_set1_ps(2.0f), _mm512_add_ps(e, one)));
+	return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(t), _mm512_and_si512(sign, xi)));
+}
+
+template <Op op>
+__attribute__((target("avx512f")))
+void array_avx512(const double* x, double* y, const size_t n){
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(y + i, apply_avx512<op>(_mm512_loadu_pd(x + i)));
+	if(i < n){
+		const __mmask8 m = static_cast<__mmask8>((1u << (n - i)) - 1);
+		_mm512_mask_storeu_pd(y + i, m, apply_avx512<op>(_mm512_maskz_loadu_pd(m, x + i)));
+	}
+}
+
+template <Op op>
+__attribute__((target("avx512f")))
+void array_avx512(const float* x, float* y, const size_t n){
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(y + i, apply_avx512<op>(_mm512_loadu_ps(x + i)));
+	if(i < n){
+		const __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+		_mm512_mask_storeu_ps(y + i, m, apply_avx512<op>(_mm512_maskz_loadu_ps(m, x + i)));
+	}
+}
+
+#endif // ACT_X86
+
+template <Op op, typename T>
+void apply(const T* x, T* y, const size_t n){
+#ifdef ACT_X86
+	if(g_mode == ActivationMode::Fast){
+		const SimdLevel level = simd_level();
+		if(level == SimdLevel::AVX512){
+			array_avx512<op>(x, y, n);
+			return;
+		} else if(level == SimdLevel::AVX2){
+			array_avx2<op>(x, y, n);
+			return;
+		}
+	}
+#endif
+	for(size_t i = 0; i < n; ++i)
+		y[i] = exact<op>(x[i]);
+}
+
+template <typename T>
+void relu_impl(const T* x, T* y, const size_t n){
+	for(size_t i = 0; i < n; ++i)
+		y[i] = x[i] >= T(0) ? x[i] : T(0);
+}
+
+template <typename T>
+void sigmoid_derivative_impl(const T* x, T* y, const size_t n){
+	apply<Op::Sigmoid>(x, y, n);
+	for(size_t i = 0; i < n; ++i)
+		y[i] = y[i] * (T(1) - y[i]);
+}
+
+} // namespace
+
+void activation_set_mode(const ActivationMode mode)
+{
+	g_mode = mode;
+}
+
+ActivationMode activation_mode()
+{
+	return g_mode;
+}
+
+void exp_array(const double* x, double* y, const size_t n)
+{
+	apply<Op::Exp>(x, y, n);
+}
+
+void exp_array(const float* x, float* y, const size_t n)
+{
+	apply<Op::Exp>(x, y, n);
+}
+
+void sigmoid_array(const double* x, double* y, const size_t n)
+{
+	apply<Op::Sigmoid>(x, y, n);
+}
+
+void sigmoid_array(const float* x, float* y, const size_t n)
+{
+	apply<Op::Sigmoid>(x, y, n);
+}
+
+void tanh_array(const double* x, double* y, const size_t n)
+{
+	apply<Op::Tanh>(x, y, n);
+}
+
+void tanh_array(const float* x, float* y, const size_t n)
+{
+	apply<Op::Tanh>(x, y, n);
+}
+
+void relu_array(const double* x, double* y, const size_t n)
+{
+	relu_impl(x, y, n);
+}
+
+void relu_array(const float* x, float* y, const size_t n)
+{
+	relu_impl(x, y, n);
+}
+
+void sigmoid_derivative_array(const double* x, double* y, const size_t n)
+{
+	sigmoid_derivative_impl(x, y, n);
+}
+
+void sigmoid_derivative_array(const float* x, float* y, const size_t n)
+{
+	sigmoid_derivative_impl(x, y, n);
+}
+
+void sigmoid_backward(const double* y, const double* pre, double* dx, const size_t n)
+{
+	for(size_t i = 0; i < n; ++i)
+		dx[i] += pre[i] * y[i] * (1.0 - y[i]);
+}
+
+void tanh_backward(const double* y, const double* pre, double* dx, const size_t n)
+{
+	for(size_t i = 0; i < n; ++i)
+		dx[i] += pre[i] * (1.0 - y[i] * y[i]);
+}
+
+void relu_backward(const double* x, const double* pre, double* dx, const size_t n)
+{
+	for(size_t i = 0; i < n; ++i)
+		if(x[i] >= 0.0)
+			dx[i] += pre[i];
+}
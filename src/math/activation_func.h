@@ -24,3 +24,32 @@ double softplus_derivative(double x, double y);
 
 
 std::vector<double> softmax(const std::vector<double>& x);
+
+// ---- array versions: y[i] = f(x[i]) for i < n, y may be x ----
+// the fast mode evaluates exp with a polynomial on SIMD registers when simd_level() is AVX2 or AVX-512.
+// errors against the exact mode: sigmoid and exp below 1e-14 relative (double) and 1e-6 (float),
+// tanh below 1e-15 absolute (double) and 1e-6 (float). lower levels and the exact mode use <cmath>.
+
+enum class ActivationMode : char { Exact, Fast };
+
+// the default is Fast. it is not thread-safe, set it before any computation starts
+void activation_set_mode(const ActivationMode mode);
+ActivationMode activation_mode();
+
+void exp_array(const double* x, double* y, const size_t n);
+void exp_array(const float* x, float* y, const size_t n);
+void sigmoid_array(const double* x, double* y, const size_t n);
+void sigmoid_array(const float* x, float* y, const size_t n);
+void tanh_array(const double* x, double* y, const size_t n);
+void tanh_array(const float* x, float* y, const size_t n);
+void relu_array(const double* x, double* y, const size_t n);
+void relu_array(const float* x, float* y, const size_t n);
+// y[i] = sigmoid_derivative(x[i])
+void sigmoid_derivative_array(const double* x, double* y, const size_t n);
+void sigmoid_derivative_array(const float* x, float* y, const size_t n);
+
+// backward passes of the activations: dx[i] += pre[i] * f'(x[i]),
+// sigmoid and tanh take their output y instead of x
+void sigmoid_backward(const double* y, const double* pre, double* dx, const size_t n);
+void tanh_backward(const double* y, const double* pre, double* dx, const size_t n);
+void relu_backward(const double* x, const double* pre, double* dx, const size_t n);
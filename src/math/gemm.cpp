@@ -0,0 +1,110 @@
+#include "gemm.h"
+#include "simd.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// block sizes: a block of B (BK x BN doubles) stays in L2, a row piece of it in L1.
+// the float32 version uses the same sizes, its blocks take half the space
+constexpr size_t BM = 64;
+constexpr size_t BN = 512;
+constexpr size_t BK = 128;
+
+template <typename T>
+void gemm_nn_impl(const size_t M, const size_t N, const size_t K,
+	const T* A, const size_t lda, const T* B, const size_t ldb, T* C, const size_t ldc)
+{
+	for(size_t j0 = 0; j0 < N; j0 += BN){
+		const size_t nb = min(BN, N - j0);
+		for(size_t k0 = 0; k0 < K; k0 += BK){
+			const size_t k1 = min(K, k0 + BK);
+			for(size_t i0 = 0; i0 < M; i0 += BM){
+				const size_t i1 = min(M, i0 + BM);
+				for(size_t i = i0; i < i1; ++i){
+					const T* a = A + i * lda;
+					T* c = C + i * ldc + j0;
+					for(size_t k = k0; k < k1; ++k)
+						if(a[k] != 0)
+							simd_axpy(a[k], B + k * ldb + j0, c, nb);
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+void gemm_tn_impl(const size_t M, const size_t N, const size_t K,
+	const T* A, const size_t lda, const T* B, const size_t ldb, T* C, const size_t ldc)
+{
+	for(size_t j0 = 0; j0 < N; j0 += BN){
+		const size_t nb = min(BN, N - j0);
+		for(size_t i0 = 0; i0 < M; i0 += BM){
+			const size_t i1 = min(M, i0 + BM);
+			for(size_t k = 0; k < K; ++k){
+				const T* a = A + k * lda;
+				const T* b = B + k * ldb + j0;
+				for(size_t i = i0; i < i1; ++i)
+					if(a[i] != 0)
+						simd_axpy(a[i], b, C + i * ldc + j0, nb);
+			}
+		}
+	}
+}
+
+template <typename T>
+void gemm_nt_impl(const size_t M, const size_t N, const size_t K,
+	const T* A, const size_t lda, const T* B, const size_t ldb, T* C, const size_t ldc)
+{
+	for(size_t k0 = 0; k0 < K; k0 += BN){
+		const size_t kb = min(BN, K - k0);
+		for(size_t j0 = 0; j0 < N; j0 += BM){
+			const size_t j1 = min(N, j0 + BM);
+			for(size_t i = 0; i < M; ++i){
+				const T* a = A + i * lda + k0;
+				T* c = C + i * ldc;
+				for(size_t j = j0; j < j1; ++j)
+					c[j] += simd_dot(a, B + j * ldb + k0, kb);
+			}
+		}
+	}
+}
+
+} // namespace
+
+void gemm_nn(const size_t M, const size_t N, const size_t K,
+	const double* A, const size_t lda, const double* B, const size_t ldb, double* C, const size_t ldc)
+{
+	gemm_nn_impl(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+void gemm_nn(const size_t M, const size_t N, const size_t K,
+	const float* A, const size_t lda, const float* B, const size_t ldb, float* C, const size_t ldc)
+{
+	gemm_nn_impl(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+void gemm_tn(const size_t M, const size_t N, const size_t K,
+	const double* A, const size_t lda, const double* B, const size_t ldb, double* C, const size_t ldc)
+{
+	gemm_tn_impl(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+void gemm_tn(const size_t M, const size_t N, const size_t K,
+	const float* A, const size_t lda, const float* B, const size_t ldb, float* C, const size_t ldc)
+{
+	gemm_tn_impl(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+void gemm_nt(const size_t M, const size_t N, const size_t K,
+	const double* A, const size_t lda, const double* B, const size_t ldb, double* C, const size_t ldc)
+{
+	gemm_nt_impl(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+void gemm_nt(const size_t M, const size_t N, const size_t K,
+	const float* A, const size_t lda, const float* B, const size_t ldb, float* C, const size_t ldc)
+{
+	gemm_nt_impl(M, N, K, A, lda, B, ldb, C, ldc);
+}
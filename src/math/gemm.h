@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+// cache-blocked matrix products on row-major matrices, the inner loops use the SIMD kernels.
+// all of them add the product into C. <lda>, <ldb> and <ldc> are the row strides.
+// each one has a double and a float32 version.
+
+// C[M x N] += A[M x K] * B[K x N]
+void gemm_nn(const size_t M, const size_t N, const size_t K,
+	const double* A, const size_t lda, const double* B, const size_t ldb, double* C, const size_t ldc);
+void gemm_nn(const size_t M, const size_t N, const size_t K,
+	const float* A, const size_t lda, const float* B, const size_t ldb, float* C, const size_t ldc);
+// C[M x N] += A[K x M]^T * B[K x N]
+void gemm_tn(const size_t M, const size_t N, const size_t K,
+	const double* A, const size_t lda, const double* B, const size_t ldb, double* C, const size_t ldc);
+void gemm_tn(const size_t M, const size_t N, const size_t K,
+	const float* A, const size_t lda, const float* B, const size_t ldb, float* C, const size_t ldc);
+// C[M x N] += A[M x K] * B[N x K]^T
+void gemm_nt(const size_t M, const size_t N, const size_t K,
+	const double* A, const size_t lda, const double* B, const size_t ldb, double* C, const size_t ldc);
+void gemm_nt(const size_t M, const size_t N, const size_t K,
+	const float* A, const size_t lda, const float* B, const size_t ldb, float* C, const size_t ldc);
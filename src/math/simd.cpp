@@ -0,0 +1,305 @@
+#include "simd.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using dot_t = double(*)(const double*, const double*, const size_t);
+using axpy_t = void(*)(const double, const double*, double*, const size_t);
+using dotf_t = float(*)(const float*, const float*, const size_t);
+using axpyf_t = void(*)(const float, const float*, float*, const size_t);
+
+// -------- scalar --------
+
+template <typename T>
+T dot_scalar(const T* x, const T* y, const size_t n){
+	// 4 partial sums break the dependency chain
+	T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4){
+		s0 += x[i] * y[i];
+		s1 += x[i + 1] * y[i + 1];
+		s2 += x[i + 2] * y[i + 2];
+		s3 += x[i + 3] * y[i + 3];
+	}
+	for(; i < n; ++i)
+		s0 += x[i] * y[i];
+	return (s0 + s1) + (s2 + s3);
+}
+
+template <typename T>
+void axpy_scalar(const T a, const T* x, T* y, const size_t n){
+	for(size_t i = 0; i < n; ++i)
+		y[i] += a * x[i];
+}
+
+#ifdef SIMD_X86
+
+// -------- SSE2 --------
+
+__attribute__((target("sse2")))
+double dot_sse2(const double* x, const double* y, const size_t n){
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4){
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+	}
+	double buf[2];
+	_mm_storeu_pd(buf, _mm_add_pd(s0, s1));
+	double res = buf[0] + buf[1];
+	for(; i < n; ++i)
+		res += x[i] * y[i];
+	return res;
+}
+
+__attribute__((target("sse2")))
+void axpy_sse2(const double a, const double* x, double* y, const size_t n){
+	const __m128d va = _mm_set1_pd(a);
+	size_t i = 0;
+	for(; i + 2 <= n; i += 2)
+		_mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+	for(; i < n; ++i)
+		y[i] += a * x[i];
+}
+
+__attribute__((target("sse2")))
+float dot_sse2(const float* x, const float* y, const size_t n){
+	__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8){
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4)));
+	}
+	float buf[4];
+	_mm_storeu_ps(buf, _mm_add_ps(s0, s1));
+	float res = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+	for(; i < n; ++i)
+		res += x[i] * y[i];
+	return res;
+}
+
+__attribute__((target("sse2")))
+void axpy_sse2(const float a, const float* x, float* y, const size_t n){
+	const __m128 va = _mm_set1_ps(a);
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+	for(; i < n; ++i)
+		y[i] += a * x[i];
+}
+
+// -------- AVX2 --------
+
+__attribute__((target("avx2,fma")))
+double dot_avx2(const double* x, const double* y, const size_t n){
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8){
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), s1);
+	}
+	for(; i + 4 <= n; i += 4)
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), s0);
+	s0 = _mm256_add_pd(s0, s1);
+	__m128d h = _mm_add_pd(_mm256_castpd256_pd128(s0), _mm256_extractf128_pd(s0, 1));
+	double res = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+	for(; i < n; ++i)
+		res += x[i] * y[i];
+	return res;
+}
+
+__attribute__((target("avx2,fma")))
+void axpy_avx2(const double a, const double* x, double* y, const size_t n){
+	const __m256d va = _mm256_set1_pd(a);
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	for(; i < n; ++i)
+		y[i] += a * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+float dot_avx2(const float* x, const float* y, const size_t n){
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16){
+		s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+		s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), s1);
+	}
+	for(; i + 8 <= n; i += 8)
+		s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+	s0 = _mm256_add_ps(s0, s1);
+	__m128 h = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+	h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+	float res = _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+	for(; i < n; ++i)
+		res += x[i] * y[i];
+	return res;
+}
+
+__attribute__((target("avx2,fma")))
+void axpy_avx2(const float a, const float* x, float* y, const size_t n){
+	const __m256 va = _mm256_set1_ps(a);
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+	for(; i < n; ++i)
+		y[i] += a * x[i];
+}
+
+// -------- AVX-512 --------
+
+__attribute__((target("avx512f")))
+double dot_avx512(const double* x, const double* y, const size_t n){
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16){
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8), s1);
+	}
+	if(i + 8 <= n){
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), s0);
+		i += 8;
+	}
+	// the tail is done with a mask
+	if(i < n){
+		const __mmask8 m = static_cast<__mmask8>((1u << (n - i)) - 1);
+		s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m, x + i), _mm512_maskz_loadu_pd(m, y + i), s1);
+	}
+	return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+}
+
+__attribute__((target("avx512f")))
+void axpy_avx512(const double a, const double* x, double* y, const size_t n){
+	const __m512d va = _mm512_set1_pd(a);
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8)
+		_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+	if(i < n){
+		const __mmask8 m = static_cast<__mmask8>((1u << (n - i)) - 1);
+		__m512d r = _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(m, x + i), _mm512_maskz_loadu_pd(m, y + i));
+		_mm512_mask_storeu_pd(y + i, m, r);
+	}
+}
+
+__attribute__((target("avx512f")))
+float dot_avx512(const float* x, const float* y, const size_t n){
+	__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+	size_t i = 0;
+	for(; i + 32 <= n; i += 32){
+		s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+		s1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), s1);
+	}
+	if(i + 16 <= n){
+		s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+		i += 16;
+	}
+	if(i < n){
+		const __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+		s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i), s1);
+	}
+	return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+__attribute__((target("avx512f")))
+void axpy_avx512(const float a, const float* x, float* y, const size_t n){
+	const __m512 va = _mm512_set1_ps(a);
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+	if(i < n){
+		const __mmask16 m = static_cast<__mmask16>((1u << (n - i)) - 1);
+		__m512 r = _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i));
+		_mm512_mask_storeu_ps(y + i, m, r);
+	}
+}
+
+#endif // SIMD_X86
+
+struct Dispatch {
+	SimdLevel level;
+	dot_t dot;
+	axpy_t axpy;
+	dotf_t dotf;
+	axpyf_t axpyf;
+};
+
+Dispatch makeDispatch(const SimdLevel level){
+	switch(level){
+#ifdef SIMD_X86
+	case SimdLevel::AVX512: return { level, dot_avx512, axpy_avx512, dot_avx512, axpy_avx512 };
+	case SimdLevel::AVX2: return { level, dot_avx2, axpy_avx2, dot_avx2, axpy_avx2 };
+	case SimdLevel::SSE2: return { level, dot_sse2, axpy_sse2, dot_sse2, axpy_sse2 };
+#endif
+	default: return { SimdLevel::Scalar, dot_scalar<double>, axpy_scalar<double>,
+		dot_scalar<float>, axpy_scalar<float> };
+	}
+}
+
+Dispatch& current(){
+	static Dispatch d = makeDispatch(simd_detect());
+	return d;
+}
+
+} // namespace
+
+SimdLevel simd_detect()
+{
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f"))
+		return SimdLevel::AVX512;
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SimdLevel::AVX2;
+	if(__builtin_cpu_supports("sse2"))
+		return SimdLevel::SSE2;
+#endif
+	return SimdLevel::Scalar;
+}
+
+SimdLevel simd_level()
+{
+	return current().level;
+}
+
+bool simd_set_level(const SimdLevel level)
+{
+	if(level > simd_detect())
+		return false;
+	current() = makeDispatch(level);
+	return current().level == level;
+}
+
+const char* simd_name(const SimdLevel level)
+{
+	switch(level){
+	case SimdLevel::AVX512: return "avx512";
+	case SimdLevel::AVX2: return "avx2";
+	case SimdLevel::SSE2: return "sse2";
+	default: return "scalar";
+	}
+}
+
+double simd_dot(const double* x, const double* y, const size_t n)
+{
+	return current().dot(x, y, n);
+}
+
+void simd_axpy(const double a, const double* x, double* y, const size_t n)
+{
+	current().axpy(a, x, y, n);
+}
+
+float simd_dot(const float* x, const float* y, const size_t n)
+{
+	return current().dotf(x, y, n);
+}
+
+void simd_axpy(const float a, const float* x, float* y, const size_t n)
+{
+	current().axpyf(a, x, y, n);
+}
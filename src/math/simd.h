@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+// dense vector kernels with SIMD versions (SSE2, AVX2, AVX-512).
+// the best one supported by the CPU is picked on the first call.
+// other compilers or CPUs than GCC/Clang on x86 use the scalar version.
+
+enum class SimdLevel : char { Scalar, SSE2, AVX2, AVX512 };
+
+// the best level supported by this CPU
+SimdLevel simd_detect();
+// the level in use
+SimdLevel simd_level();
+// use <level> from now on, return false if the CPU does not support it.
+// it is not thread-safe, call it before any computation starts
+bool simd_set_level(const SimdLevel level);
+const char* simd_name(const SimdLevel level);
+
+// sum_i x[i] * y[i]
+double simd_dot(const double* x, const double* y, const size_t n);
+// y[i] += a * x[i]
+void simd_axpy(const double a, const double* x, double* y, const size_t n);
+// float32 versions, twice as many values per instruction
+float simd_dot(const float* x, const float* y, const size_t n);
+void simd_axpy(const float a, const float* x, float* y, const size_t n);
@@ -3,6 +3,7 @@ using namespace std;
 
 void Kernel::initBasic(const std::string& param){
 	this->param = param;
+	dws.reset();
 }
 
 
@@ -10,6 +11,11 @@ std::string Kernel::parameter() const{
 	return param;
 }
 
+bool Kernel::setFloat32(const bool on){
+	fp32 = false;
+	return !on;
+}
+
 bool Kernel::needInitParameterByData() const{
 	return false;
 }
@@ -18,7 +24,99 @@ int Kernel::lengthHidden() const{
 	return 0;
 }
 
-void Kernel::initVariables(const std::vector<std::vector<double>>& x,
-	std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+void Kernel::initVariables(const FeatureListView& x,
+	std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
+{
+}
+
+void Kernel::accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph)
+{
+	vector<double> g = backward(x, w, y, ph);
+	for(size_t i = 0; i < g.size(); ++i)
+		grad[i] += g[i];
+}
+
+void Kernel::accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	vector<double> g = gradient(x, w, y, ph);
+	for(size_t i = 0; i < g.size(); ++i)
+		grad[i] += g[i];
+}
+
+double Kernel::lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+	std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	vector<double> p = predict(x, w);
+	double l = loss(p, y);
+	accumulateGradient(x, w, y, grad, ph);
+	if(pred)
+		*pred = move(p);
+	return l;
+}
+
+void Kernel::batchBackward(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph)
+{
+	for(size_t i = 0; i < n; ++i){
+		vector<double> pred = forward(dps[i].x, w);
+		if(loss)
+			loss[i] = this->loss(pred, dps[i].y);
+		accumulateBackward(dps[i].x, w, dps[i].y, grad, ph ? ph + i : nullptr);
+	}
+}
+
+void Kernel::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	for(size_t i = 0; i < n; ++i){
+		if(loss)
+			loss[i] = lossAndGradient(dps[i].x, w, dps[i].y, grad, nullptr, ph ? ph + i : nullptr);
+		else
+			accumulateGradient(dps[i].x, w, dps[i].y, grad, ph ? ph + i : nullptr);
+	}
+}
+
+void Kernel::fixParameter(const std::vector<double>& w) const
+{
+}
+
+Workspace* Kernel::makeWorkspace() const
+{
+	return new Workspace();
+}
+
+std::vector<double> Kernel::predict(Workspace& ws, const FeatureListView& x, const std::vector<double>& w) const
+{
+	return predict(x, w);
+}
+
+void Kernel::accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	accumulateGradient(x, w, y, grad, ph);
+}
+
+double Kernel::lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return lossAndGradient(x, w, y, grad, pred, ph);
+}
+
+void Kernel::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	batchGradient(dps, n, w, grad, loss, ph);
+}
+
+void Kernel::fixParameter(Workspace& ws, const std::vector<double>& w) const
+{
+}
+
+Workspace& Kernel::defaultWorkspace() const
 {
+	if(!dws)
+		dws.reset(makeWorkspace());
+	return *dws;
 }
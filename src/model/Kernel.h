@@ -1,10 +1,19 @@
 #pragma once
+#include "data/DataPoint.h"
 #include <vector>
 #include <string>
+#include <memory>
+
+// scratch state of the evaluations of a kernel (buffers, recurrent states).
+// kernels derive their own ones. a workspace is used by one thread at a time
+struct Workspace {
+	virtual ~Workspace() = default;
+};
 
 class Kernel
 {
 public:
+	virtual ~Kernel() = default;
 	virtual void init(const std::string& param) = 0;
 	virtual bool checkData(const size_t nx, const size_t ny) = 0;
 	virtual std::string name() const = 0;
@@ -13,22 +22,76 @@ public:
 	virtual bool needInitParameterByData() const; // default false
 
 	// default doing nothing
-	virtual void initVariables(const std::vector<std::vector<double>>& x,
-		std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph);
+	virtual void initVariables(const FeatureListView& x,
+		std::vector<double>& w, const FeatureView& y, std::vector<double>* ph);
 	virtual int lengthHidden() const; // default 0
 
-	virtual std::vector<double> predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w) const = 0;
+	virtual std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const = 0;
 	virtual int classify(const double p) const = 0;
-	virtual double loss(const std::vector<double>& pred, const std::vector<double>& label) const = 0;
+	virtual double loss(const std::vector<double>& pred, const FeatureView& label) const = 0;
 
 	// backward propagation
-	virtual std::vector<double> forward(const std::vector<std::vector<double>>& x, const std::vector<double>& w) = 0;
-	virtual std::vector<double> backward(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr) = 0;
-	virtual std::vector<double> gradient(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr) const = 0;
+	virtual std::vector<double> forward(const FeatureListView& x, const std::vector<double>& w) = 0;
+	virtual std::vector<double> backward(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr) = 0;
+	virtual std::vector<double> gradient(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr) const = 0;
+	// add the result of backward()/gradient() into <grad>, which has the length of <w>.
+	// the default ones call backward()/gradient(). kernels can override them to skip
+	// the per-point gradient vector and the zero coordinates of sparse x
+	virtual void accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr);
+	virtual void accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	// add the gradient of one point into <grad> and return its loss, both from one forward pass.
+	// if <pred> is given, the prediction is stored there.
+	// the default calls predict() and accumulateGradient(). kernels override it when
+	// the prediction is at hand after computing the gradient
+	virtual double lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+		std::vector<double>& grad, std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	// batch versions of the above: add the gradients of the <n> points at <dps> into <grad>.
+	// batchBackward() runs forward() for each point first.
+	// <loss>: if given, loss[i] is set to the loss of point i.
+	// <ph>: if given, ph[i] is the hidden variable of point i.
+	// the default ones call accumulateBackward() or lossAndGradient()/accumulateGradient() for each point
+	virtual void batchBackward(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr);
+	virtual void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	// start a series of per-point calls with the same <w>, which is checked here once instead of on each call.
+	// the series ends with the next batch call or fixParameter(), <w> must not change before that.
+	// the default does nothing
+	virtual void fixParameter(const std::vector<double>& w) const;
+
+	// thread-safe versions of the const functions above: all their scratch state is kept in <ws>,
+	// so several threads can use one kernel at the same time, each with its own workspace.
+	// a kernel overrides the ones whose const version keeps state, and lets that version
+	// use the workspace owned by the kernel. call makeWorkspace() after init().
+	// the defaults fit the const functions without state: the workspace is empty
+	// and the functions call the ones above
+	virtual Workspace* makeWorkspace() const;
+	virtual std::vector<double> predict(Workspace& ws, const FeatureListView& x, const std::vector<double>& w) const;
+	virtual void accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	virtual double lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred = nullptr,
+		std::vector<double>* ph = nullptr) const;
+	virtual void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	virtual void fixParameter(Workspace& ws, const std::vector<double>& w) const;
+
+	// compute the batch functions in float32 where the kernel has a float32 version.
+	// parameters, gradients and losses stay in double, the gradient of a batch is added in double.
+	// return false if the kernel only computes in double (the default)
+	virtual bool setFloat32(const bool on);
+	bool useFloat32() const { return fp32; }
 
 protected:
 	std::string param;
+	bool fp32 = false;
 	void initBasic(const std::string& param);
+	// the workspace owned by the kernel, made on the first call (not thread-safe)
+	Workspace& defaultWorkspace() const;
+private:
+	mutable std::unique_ptr<Workspace> dws;
 };
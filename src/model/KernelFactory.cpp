@@ -1,15 +1,39 @@
 #include "KernelFactory.h"
 #include "app/LogisticRegression.h"
 #include "app/MLP.h"
+#include "app/MLPFixed.h"
 #include "app/CNN.h"
 #include "app/RNN.h"
 #include "app/TopicModel.h"
 #include "app/KMeans.h"
+#include "util/Util.h"
 #include <stdexcept>
 #include <algorithm>
+#include <map>
 
 using namespace std;
 
+namespace {
+
+template <class K>
+Kernel* create(){
+	return new K();
+}
+
+// kernels whose layer sizes are compile-time constants, by name and layer sizes.
+// LR is not in it: its loops are already one SIMD dot and axpy per point with the best instruction set
+// picked at run time, a fixed-length loop is only compiled for the baseline one
+const map<pair<string, vector<int>>, Kernel* (*)()>& fixedKernels(){
+	static const map<pair<string, vector<int>>, Kernel* (*)()> reg = {
+		{ { "mlp", { 784, 300, 10 } }, &create<MLPFixed<784, 300, 10>> },
+		{ { "mlp", { 784, 100, 10 } }, &create<MLPFixed<784, 100, 10>> },
+		{ { "mlp", { 784, 500, 300, 10 } }, &create<MLPFixed<784, 500, 300, 10>> },
+	};
+	return reg;
+}
+
+} // namespace
+
 std::vector<std::string> KernelFactory::supportList()
 {
 	static vector<string> supported = { "lr", "mlp", "cnn", "rnn", "km" }; //, "tm"
@@ -40,3 +64,16 @@ Kernel* KernelFactory::generate(const std::string& name){
 		throw invalid_argument("do not support the method: " + name);
 	return nullptr;
 }
+
+Kernel* KernelFactory::generate(const std::string& name, const std::string& param){
+	vector<int> shape;
+	try{
+		shape = getIntList(param, " ,-");
+	} catch(...){
+		// not a list of layer sizes, the generic kernel reports it in init()
+	}
+	auto it = fixedKernels().find(make_pair(name, shape));
+	if(it != fixedKernels().end())
+		return it->second();
+	return generate(name);
+}
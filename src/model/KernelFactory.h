@@ -9,4 +9,6 @@ struct KernelFactory
 	static bool isSupported(const std::string& name);
 
 	static Kernel* generate(const std::string& name);
+	// a kernel specialized for the shape in <param> if there is one registered, otherwise the generic one
+	static Kernel* generate(const std::string& name, const std::string& param);
 };
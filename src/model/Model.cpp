@@ -4,7 +4,7 @@
 using namespace std;
 
 /*
-void Model::initParamWithData(const DataPoint& d){
+void Model::initParamWithData(const DataPointView& d){
 	param.init(d.x.size(), 0.01);
 }
 
@@ -14,13 +14,13 @@ void Model::initParamWithSize(const size_t n){
 
 void Model::init(const std::string& name, const std::string & paramKern)
 {
-	generateKernel(name);
+	generateKernel(name, paramKern);
 	kern->init(paramKern);
 }
 
 void Model::init(const std::string& name, const std::string & paramKern, const double w0)
 {
-	generateKernel(name);
+	generateKernel(name, paramKern);
 	kern->init(paramKern);
 	size_t n = kern->lengthParameter();
 	param.init(n, w0);
@@ -28,7 +28,7 @@ void Model::init(const std::string& name, const std::string & paramKern, const d
 
 void Model::init(const std::string & name, const std::string & paramKern, const unsigned seed)
 {
-	generateKernel(name);
+	generateKernel(name, paramKern);
 	kern->init(paramKern);
 	size_t n = kern->lengthParameter();
 	param.init(n, 0.01, 0.01, seed);
@@ -41,6 +41,7 @@ bool Model::checkData(const size_t nx, const size_t ny)
 
 void Model::clear()
 {
+	wss.clear();
 	delete kern;
 	kern = nullptr;
 }
@@ -71,6 +72,10 @@ size_t Model::paramWidth() const
 	return kern->lengthParameter();
 }
 
+bool Model::setFloat32(const bool on){
+	return kern->setFloat32(on);
+}
+
 Kernel* Model::getKernel(){
 	return kern;
 }
@@ -85,7 +90,7 @@ void Model::accumulateParameter(const std::vector<double>& grad)
 	param.accumulate(grad);
 }
 
-std::vector<double> Model::predict(const DataPoint& dp) const
+std::vector<double> Model::predict(const DataPointView& dp) const
 {
 	return kern->predict(dp.x, param.weights);
 }
@@ -95,37 +100,115 @@ int Model::classify(const double p) const
 	return kern->classify(p);
 }
 
-double Model::loss(const DataPoint & dp) const
+double Model::loss(const DataPointView& dp) const
 {
 	std::vector<double> pred = kern->predict(dp.x, param.weights);
 	return loss(pred, dp.y);
 }
 
-double Model::loss(const std::vector<double>& pred, const std::vector<double>& label) const
+double Model::loss(const std::vector<double>& pred, const FeatureView& label) const
 {
 	return kern->loss(pred, label);
 }
 
-std::vector<double> Model::forward(const DataPoint& dp)
+std::vector<double> Model::forward(const DataPointView& dp)
 {
 	return kern->forward(dp.x, param.weights);
 }
 
-std::vector<double> Model::backward(const DataPoint& dp, std::vector<double>* ph)
+std::vector<double> Model::backward(const DataPointView& dp, std::vector<double>* ph)
 {
 	return kern->backward(dp.x, param.weights, dp.y, ph);
 }
 
-std::vector<double> Model::gradient(const DataPoint & dp, std::vector<double>* ph) const
+std::vector<double> Model::gradient(const DataPointView& dp, std::vector<double>* ph) const
 {
 	return kern->gradient(dp.x, param.weights, dp.y, ph);
 }
 
-void Model::generateKernel(const std::string & name)
+void Model::accumulateBackward(const DataPointView& dp, std::vector<double>& grad, std::vector<double>* ph)
+{
+	kern->accumulateBackward(dp.x, param.weights, dp.y, grad, ph);
+}
+
+void Model::accumulateGradient(const DataPointView& dp, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	kern->accumulateGradient(dp.x, param.weights, dp.y, grad, ph);
+}
+
+double Model::lossAndGradient(const DataPointView& dp, std::vector<double>& grad,
+	std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return kern->lossAndGradient(dp.x, param.weights, dp.y, grad, pred, ph);
+}
+
+void Model::batchBackward(const DataPointView* dps, const size_t n, std::vector<double>& grad,
+	double* loss, std::vector<double>* ph)
+{
+	kern->batchBackward(dps, n, param.weights, grad, loss, ph);
+}
+
+void Model::batchGradient(const DataPointView* dps, const size_t n, std::vector<double>& grad,
+	double* loss, std::vector<double>* ph) const
+{
+	kern->batchGradient(dps, n, param.weights, grad, loss, ph);
+}
+
+void Model::fixParameter() const
+{
+	kern->fixParameter(param.weights);
+}
+
+void Model::prepareWorkspace(const size_t n)
+{
+	while(wss.size() < n)
+		wss.emplace_back(kern->makeWorkspace());
+}
+
+size_t Model::numWorkspace() const
+{
+	return wss.size();
+}
+
+Workspace& Model::getWorkspace(const size_t i)
+{
+	return *wss[i];
+}
+
+std::vector<double> Model::predict(Workspace& ws, const DataPointView& dp) const
+{
+	return kern->predict(ws, dp.x, param.weights);
+}
+
+double Model::loss(Workspace& ws, const DataPointView& dp) const
+{
+	std::vector<double> pred = kern->predict(ws, dp.x, param.weights);
+	return loss(pred, dp.y);
+}
+
+double Model::lossAndGradient(Workspace& ws, const DataPointView& dp, std::vector<double>& grad,
+	std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return kern->lossAndGradient(ws, dp.x, param.weights, dp.y, grad, pred, ph);
+}
+
+void Model::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, std::vector<double>& grad,
+	double* loss, std::vector<double>* ph) const
+{
+	kern->batchGradient(ws, dps, n, param.weights, grad, loss, ph);
+}
+
+void Model::fixParameter(Workspace& ws) const
+{
+	kern->fixParameter(ws, param.weights);
+}
+
+void Model::generateKernel(const std::string & name, const std::string & param)
 {
+	wss.clear();
 	if(kern != nullptr){
 		delete kern;
 		kern = nullptr;
 	}
-	kern = KernelFactory::generate(name);
+	kern = KernelFactory::generate(name, param);
 }
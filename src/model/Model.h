@@ -4,11 +4,13 @@
 #include "data/DataHolder.h"
 #include <vector>
 #include <string>
+#include <memory>
 
 class Model {
 	Parameter param;
 	//LogisticRegression kern; // with be changed to a general interface
 	Kernel* kern = nullptr;
+	std::vector<std::shared_ptr<Workspace>> wss; // one for each thread
 
 public:
 	// initialize kernel, do not initialize parameter
@@ -20,8 +22,10 @@ public:
 	bool checkData(const size_t nx, const size_t ny);
 	void clear();
 	std::string kernelName() const;
+	// see Kernel::setFloat32()
+	bool setFloat32(const bool on);
 
-	//void initParamWithData(const DataPoint& d);
+	//void initParamWithData(const DataPointView& d);
 	//void initParamWithSize(const size_t n);
 
 	void setParameter(const Parameter& p);
@@ -35,15 +39,41 @@ public:
 	void accumulateParameter(const std::vector<double>& grad, const double factor);
 	void accumulateParameter(const std::vector<double>& grad);
 	
-	std::vector<double> predict(const DataPoint& dp) const;
+	std::vector<double> predict(const DataPointView& dp) const;
 	int classify(const double p) const;
-	double loss(const DataPoint& dp) const;
-	double loss(const std::vector<double>& pred, const std::vector<double>& label) const;
+	double loss(const DataPointView& dp) const;
+	double loss(const std::vector<double>& pred, const FeatureView& label) const;
 
-	std::vector<double> forward(const DataPoint& dp);
-	std::vector<double> backward(const DataPoint& dp, std::vector<double>* ph = nullptr);
-	std::vector<double> gradient(const DataPoint& dp, std::vector<double>* ph = nullptr) const;
+	std::vector<double> forward(const DataPointView& dp);
+	std::vector<double> backward(const DataPointView& dp, std::vector<double>* ph = nullptr);
+	std::vector<double> gradient(const DataPointView& dp, std::vector<double>* ph = nullptr) const;
+	// add the gradient into <grad>
+	void accumulateBackward(const DataPointView& dp, std::vector<double>& grad, std::vector<double>* ph = nullptr);
+	void accumulateGradient(const DataPointView& dp, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	// add the gradient into <grad> and return the loss, see Kernel::lossAndGradient()
+	double lossAndGradient(const DataPointView& dp, std::vector<double>& grad,
+		std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	// add the gradients of <n> points into <grad>, see Kernel::batchBackward()
+	void batchBackward(const DataPointView* dps, const size_t n, std::vector<double>& grad,
+		double* loss = nullptr, std::vector<double>* ph = nullptr);
+	void batchGradient(const DataPointView* dps, const size_t n, std::vector<double>& grad,
+		double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	// the parameter stays the same over the following per-point calls, see Kernel::fixParameter()
+	void fixParameter() const;
+
+	// make sure there are at least <n> workspaces, one for each thread using the model
+	void prepareWorkspace(const size_t n);
+	size_t numWorkspace() const;
+	Workspace& getWorkspace(const size_t i);
+	// thread-safe versions of the above, each thread uses its own workspace
+	std::vector<double> predict(Workspace& ws, const DataPointView& dp) const;
+	double loss(Workspace& ws, const DataPointView& dp) const;
+	double lossAndGradient(Workspace& ws, const DataPointView& dp, std::vector<double>& grad,
+		std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, std::vector<double>& grad,
+		double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	void fixParameter(Workspace& ws) const;
 
 private:
-	void generateKernel(const std::string& name);
+	void generateKernel(const std::string& name, const std::string& param);
 };
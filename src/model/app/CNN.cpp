@@ -55,9 +55,9 @@ int CNN::lengthParameter() const
 }
 
 std::vector<double> CNN::predict(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w) const
+	const FeatureListView& x, const std::vector<double>& w) const
 {
-	return net.predict(x[0], w);
+	return predict(defaultWorkspace(), x, w);
 }
 
 int CNN::classify(const double p) const
@@ -65,7 +65,7 @@ int CNN::classify(const double p) const
 	return p >= 0.5 ? 1 : 0;
 }
 
-double CNN::loss(const std::vector<double>& pred, const std::vector<double>& label) const {
+double CNN::loss(const std::vector<double>& pred, const FeatureView& label) const {
 	double res = 0.0;
 	for(size_t i = 0; i < pred.size(); ++i){
 		double t = pred[i] - label[i];
@@ -76,30 +76,105 @@ double CNN::loss(const std::vector<double>& pred, const std::vector<double>& lab
 }
 
 std::vector<double> CNN::forward(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+	const FeatureListView& x, const std::vector<double>& w)
 {
-	return net.forward(x[0], w);
+	return net.forward(buffer(defaultWorkspace()), x[0], w);
 }
 
-std::vector<double> CNN::backward(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+std::vector<double> CNN::backward(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
-	return net.backward(x[0], w, y);
+	return net.backward(buffer(defaultWorkspace()), x[0], w, y);
 }
 
-std::vector<double> CNN::gradLoss(const std::vector<double>& pred, const std::vector<double>& label)
+void CNN::gradLoss(const double* pred, const FeatureView& label, double* res)
 {
-	vector<double> res(pred.size());
-	for(size_t i = 0; i < pred.size(); ++i){
+	for(size_t i = 0; i < label.size(); ++i){
 		res[i] = pred[i] - label[i];
 	}
+}
+
+std::vector<double> CNN::gradient(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const
+{
+	vector<double> grad(w.size());
+	accumulateGradient(defaultWorkspace(), x, w, y, grad, ph);
+	return grad;
+}
+
+void CNN::accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph)
+{
+	net.accumulateBackward(buffer(defaultWorkspace()), w, y, grad.data());
+}
+
+void CNN::accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	accumulateGradient(defaultWorkspace(), x, w, y, grad, ph);
+}
+
+double CNN::lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+	std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return lossAndGradient(defaultWorkspace(), x, w, y, grad, pred, ph);
+}
+
+void CNN::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	batchGradient(defaultWorkspace(), dps, n, w, grad, loss, ph);
+}
+
+Workspace* CNN::makeWorkspace() const
+{
+	Work* p = new Work();
+	p->buf = net.makeBuffer();
+	return p;
+}
+
+std::vector<double> CNN::predict(Workspace& ws, const FeatureListView& x, const std::vector<double>& w) const
+{
+	return net.predict(buffer(ws), x[0], w);
+}
+
+void CNN::accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	net.accumulateGradient(buffer(ws), x[0], w, y, grad.data());
+}
+
+double CNN::lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	accumulateGradient(ws, x, w, y, grad, ph);
+	// the loss is taken from the arena, the output is copied only when it is asked for
+	const double* out = buffer(ws).act.data() + net.featureOffset[net.nLayer - 1];
+	const size_t n = net.numFeatureLayer[net.nLayer - 1];
+	double res = 0.0;
+	for(size_t i = 0; i < n; ++i){
+		double t = out[i] - y[i];
+		res += t * t;
+	}
+	if(pred)
+		pred->assign(out, out + n);
 	return res;
 }
 
-std::vector<double> CNN::gradient(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const
+void CNN::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	for(size_t i = 0; i < n; ++i){
+		if(loss)
+			loss[i] = lossAndGradient(ws, dps[i].x, w, dps[i].y, grad);
+		else
+			accumulateGradient(ws, dps[i].x, w, dps[i].y, grad);
+	}
+}
+
+VectorNetwork::Buffer& CNN::buffer(Workspace& ws) const
 {
-	return net.gradient(x[0], w, y);
+	return static_cast<Work&>(ws).buf;
 }
 
 std::string CNN::preprocessParam(const std::string & param)
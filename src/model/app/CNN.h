@@ -5,25 +5,50 @@
 class CNN
 	: public Kernel
 {
-	mutable VectorNetwork net;
+	VectorNetwork net;
+	struct Work : public Workspace {
+		VectorNetwork::Buffer buf;
+	};
+	VectorNetwork::Buffer& buffer(Workspace& ws) const;
 public:
 	void init(const std::string& param);
 	bool checkData(const size_t nx, const size_t ny);
 	std::string name() const;
 	int lengthParameter() const;
 
-	std::vector<double> predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w) const;
+	std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const;
 	int classify(const double p) const;
-	double loss(const std::vector<double>& pred, const std::vector<double>& label) const;
+	double loss(const std::vector<double>& pred, const FeatureView& label) const;
 
-	std::vector<double> forward(const std::vector<std::vector<double>>& x, const std::vector<double>& w);
-	std::vector<double> backward(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr);
+	std::vector<double> forward(const FeatureListView& x, const std::vector<double>& w);
+	std::vector<double> backward(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr);
 
-	static std::vector<double> gradLoss(const std::vector<double>& pred, const std::vector<double>& label);
+	// res[i] = pred[i] - label[i]
+	static void gradLoss(const double* pred, const FeatureView& label, double* res);
 
-	std::vector<double> gradient(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr) const;
+	std::vector<double> gradient(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr) const;
+	void accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr);
+	void accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	double lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+		std::vector<double>& grad, std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+
+	// the network is not changed by an evaluation, all the buffers are in the workspace
+	Workspace* makeWorkspace() const;
+	std::vector<double> predict(Workspace& ws, const FeatureListView& x, const std::vector<double>& w) const;
+	void accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	// the output of the forward pass is still in the buffer after the gradient
+	double lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred = nullptr,
+		std::vector<double>* ph = nullptr) const;
+	void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
 	
 	// make the cnn param into the general format for network
 	std::string preprocessParam(const std::string& param);
@@ -36,6 +61,4 @@ private:
 	std::string procUnitCx(const std::string& param);
 	// i.e. p2 -> max:2
 	std::string procUnitPx(const std::string& param);
-
-	std::vector<std::vector<double>> mid;
 };
@@ -1,12 +1,22 @@
 #include "KMeans.h"
 #include "math/activation_func.h"
+#include "math/gemm.h"
+#include "math/simd.h"
 #include "util/Util.h"
 #include <cmath>
 #include <stdexcept>
 #include <random>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <cstring>
 
 using namespace std;
 
+static constexpr double INF = numeric_limits<double>::infinity();
+// points per matrix product of the batched full scan, and centers per block of computeHalf()
+static constexpr size_t TILE = 64;
+
 void KMeans::init(const std::string & param)
 {
 	initBasic(param);
@@ -37,7 +47,7 @@ std::string KMeans::name() const{
 }
 
 int KMeans::lengthHidden() const{
-	return 1;
+	return 4;
 }
 
 int KMeans::lengthParameter() const
@@ -50,34 +60,38 @@ bool KMeans::needInitParameterByData() const
 	return true;
 }
 
-void KMeans::initVariables(const std::vector<std::vector<double>>& x,
-	std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+void KMeans::initVariables(const FeatureListView& x,
+	std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
 	static uniform_int_distribution<int> dist(0, static_cast<int>(ncenter) - 1);
 	static mt19937 gen;
 	int c = dist(gen);
-	(*ph)[0] = static_cast<double>(c);
-	size_t off = c * (dim + 1);
-	for(size_t i = 0; i < dim; ++i){
-		w[off + i] += x[0][i];
+	if(ph){
+		(*ph)[0] = static_cast<double>(c);
+		(*ph)[3] = 0.0; // no bounds yet
 	}
+	size_t off = c * (dim + 1);
+	x[0].axpy(1.0, w.data() + off);
 	w[off + dim] += 1;
 }
 
 std::vector<double> KMeans::predict(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w) const
+	const FeatureListView& x, const std::vector<double>& w) const
 {
 	size_t min_id = ncenter;
-	double min_v;
+	double min_v = INF;
 	size_t off = 0;
-	for(size_t i = 0; i < ncenter; ++i){
-		double d = dist(x[0].begin(), x[0].end(), w.begin() + off, w[off + dim]);
-		off += dim + 1;
+	for(size_t i = 0; i < ncenter; ++i, off += dim + 1){
+		if(round(w[off + dim]) == 0.0) // an empty center has no position
+			continue;
+		double d = dist(x[0], w.data() + off, w[off + dim]);
 		if(min_id == ncenter || d < min_v){
 			min_id = i;
 			min_v = d;
 		}
 	}
+	if(min_id == ncenter)
+		min_id = 0;
 	return { static_cast<double>(min_id), min_v };
 }
 
@@ -87,78 +101,397 @@ int KMeans::classify(const double p) const
 }
 
 double KMeans::loss(
-	const std::vector<double>& pred, const std::vector<double>& label) const
+	const std::vector<double>& pred, const FeatureView& label) const
 {
 	return pred[1];
 }
 
 std::vector<double> KMeans::forward(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+	const FeatureListView& x, const std::vector<double>& w)
 {
 	return std::vector<double>();
 }
 
-std::vector<double> KMeans::backward(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+std::vector<double> KMeans::backward(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
 	return std::vector<double>();
 }
 
-std::vector<double> KMeans::gradient(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const
+std::vector<double> KMeans::gradient(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const
 {
 	vector<double> grad(parlen, 0.0);
-	size_t oldp = static_cast<int>((*ph)[0]);
-	vector<double> pred = predict(x, w); 
-	size_t newp = pred[0]; // quickPredict(x[0], w);
-	(*ph)[0] = static_cast<double>(newp);
-	if(oldp != newp){
-		oldp *= dim + 1;
-		newp *= dim + 1;
-		for(size_t i = 0; i < dim; ++i){
-			grad[oldp + i] -= x[0][i];
-			grad[newp + i] += x[0][i];
+	Work& wk = static_cast<Work&>(defaultWorkspace());
+	updatePoint(wk, w);
+	double obj = addGradient(wk, x, w, grad, ph).second;
+	grad.push_back(obj); /// append the objective value for curent dp
+	return grad;
+}
+
+void KMeans::accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	accumulateGradient(defaultWorkspace(), x, w, y, grad, ph);
+}
+
+double KMeans::lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+	std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return lossAndGradient(defaultWorkspace(), x, w, y, grad, pred, ph);
+}
+
+void KMeans::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	batchGradient(defaultWorkspace(), dps, n, w, grad, loss, ph);
+}
+
+void KMeans::fixParameter(const std::vector<double>& w) const
+{
+	fixParameter(defaultWorkspace(), w);
+}
+
+Workspace* KMeans::makeWorkspace() const
+{
+	Work* p = new Work();
+	resetWork(*p);
+	return p;
+}
+
+void KMeans::accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	Work& wk = static_cast<Work&>(ws);
+	updatePoint(wk, w);
+	addGradient(wk, x, w, grad, ph, false);
+}
+
+double KMeans::lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	Work& wk = static_cast<Work&>(ws);
+	updatePoint(wk, w);
+	pair<size_t, double> r = addGradient(wk, x, w, grad, ph);
+	if(pred)
+		*pred = { static_cast<double>(r.first), r.second };
+	return r.second;
+}
+
+void KMeans::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	Work& wk = static_cast<Work&>(ws);
+	updateWork(wk, w);
+	wk.fixed = false;
+	// the points within their bounds are done first, the others are scanned in tiles
+	wk.pending.clear();
+	for(size_t i = 0; i < n; ++i){
+		const FeatureView x = dps[i].x[0];
+		vector<double>& h = hidden(wk, ph, i);
+		pair<size_t, double> r;
+		if(checkBounds(wk, x, w, h, loss != nullptr, r)){
+		} else if(x.isSparse()){
+			r = assign(wk, x, w, h, true);
+		} else{
+			wk.pending.push_back(i);
+			continue;
 		}
+		moveGradient(x, static_cast<size_t>(h[0]), r.first, grad);
+		h[0] = static_cast<double>(r.first);
+		if(loss)
+			loss[i] = r.second;
+	}
+	for(size_t i = 0; i < wk.pending.size(); i += TILE)
+		scanTile(wk, dps, wk.pending.data() + i, min(TILE, wk.pending.size() - i), w, grad, loss, ph);
+}
+
+void KMeans::fixParameter(Workspace& ws, const std::vector<double>& w) const
+{
+	Work& wk = static_cast<Work&>(ws);
+	updateWork(wk, w);
+	wk.fixed = true;
+}
+
+std::pair<size_t, double> KMeans::addGradient(Work& wk, const FeatureListView& x, const std::vector<double>& w,
+	std::vector<double>& grad, std::vector<double>* ph, const bool exact) const
+{
+	vector<double>& h = hidden(wk, ph, 0);
+	size_t oldp = static_cast<size_t>(h[0]);
+	pair<size_t, double> pred = assign(wk, x[0], w, h, exact);
+	h[0] = static_cast<double>(pred.first);
+	moveGradient(x[0], oldp, pred.first, grad);
+	return pred;
+}
+
+std::vector<double>& KMeans::hidden(Work& wk, std::vector<double>* ph, const size_t i) const
+{
+	if(ph)
+		return ph[i];
+	// no assignment and no bounds, the point is added to its nearest center
+	wk.scratch.assign(lengthHidden(), 0.0);
+	wk.scratch[0] = static_cast<double>(ncenter);
+	return wk.scratch;
+}
+
+void KMeans::moveGradient(const FeatureView& x, const size_t from, const size_t to, std::vector<double>& grad) const
+{
+	if(from == to)
+		return;
+	if(from < ncenter){ // not a new point
+		const size_t oldp = from * (dim + 1);
+		x.axpy(-1.0, grad.data() + oldp);
 		grad[oldp + dim] -= 1;
-		grad[newp + dim] += 1;
 	}
-	grad.push_back(pred[1]); /// append the objective value for curent dp
-	return grad;
+	const size_t newp = to * (dim + 1);
+	x.axpy(1.0, grad.data() + newp);
+	grad[newp + dim] += 1;
 }
 
-double KMeans::dist(it_t xf, it_t xl, it_t yf, const double n)
+// -------- bounded assignment --------
+
+void KMeans::resetWork(Work& wk) const
 {
-	double nn = round(n);
-	double r = *xf - *yf / nn;
-	r *= r;
-	while(++xf != xl){
-		++yf;
-		double t = *xf - *yf / nn;
+	static atomic<unsigned long long> counter(0);
+	wk.tag = static_cast<double>(++counter);
+	wk.last.clear();
+	wk.fixed = false;
+	wk.drift.assign(ncenter, 0.0);
+	wk.maxDrift = 0.0;
+	wk.half.clear();
+	wk.nFull = 0;
+	wk.centerReady = false;
+}
+
+void KMeans::updateWork(Work& wk, const std::vector<double>& w) const
+{
+	if(wk.last.size() == w.size() && memcmp(wk.last.data(), w.data(), w.size() * sizeof(double)) == 0)
+		return;
+	bool valid = wk.last.size() == w.size();
+	double m = 0.0;
+	for(size_t c = 0, off = 0; valid && c < ncenter; ++c, off += dim + 1){
+		// an empty center is skipped by the assignment, so it does not loosen any bound.
+		// one that gets points again may be anywhere
+		if(round(w[off + dim]) == 0.0)
+			continue;
+		if(round(wk.last[off + dim]) == 0.0){
+			valid = false;
+			break;
+		}
+		double d = centerDist(wk.last.data() + off, wk.last[off + dim], w.data() + off, w[off + dim]);
+		wk.drift[c] += d;
+		m = max(m, d);
+	}
+	if(valid)
+		wk.maxDrift += m;
+	else
+		resetWork(wk);
+	wk.last = w;
+	wk.half.clear();
+	wk.nFull = 0;
+	wk.centerReady = false;
+}
+
+void KMeans::updatePoint(Work& wk, const std::vector<double>& w) const
+{
+	if(!wk.fixed)
+		updateWork(wk, w);
+}
+
+void KMeans::computeHalf(Work& wk, const std::vector<double>& w) const
+{
+	prepareCenters(wk, w);
+	wk.half.assign(ncenter, INF);
+	// |a-b|^2 = |a|^2 - 2 a.b + |b|^2, for a block of TILE centers against all at a time.
+	// it may be called in the middle of scanTile(), so it does not use wk.prod
+	vector<double> prod;
+	for(size_t a0 = 0; a0 < ncenter; a0 += TILE){
+		const size_t m = min(TILE, ncenter - a0);
+		prod.assign(m * ncenter, 0.0);
+		gemm_nt(m, ncenter, dim, wk.center.data() + a0 * dim, dim, wk.center.data(), dim, prod.data(), ncenter);
+		for(size_t i = 0; i < m; ++i){
+			const size_t a = a0 + i;
+			const double* g = prod.data() + i * ncenter;
+			double best = INF;
+			for(size_t b = 0; b < ncenter; ++b)
+				if(b != a)
+					best = min(best, wk.cnorm[a] - 2 * g[b] + wk.cnorm[b]);
+			if(best != INF)
+				wk.half[a] = 0.5 * sqrt(max(0.0, best));
+		}
+	}
+}
+
+void KMeans::prepareCenters(Work& wk, const std::vector<double>& w) const
+{
+	if(wk.centerReady)
+		return;
+	wk.center.assign(ncenter * dim, 0.0);
+	wk.cnorm.assign(ncenter, INF);
+	for(size_t c = 0, off = 0; c < ncenter; ++c, off += dim + 1){
+		const double n = round(w[off + dim]);
+		if(n == 0.0)
+			continue;
+		double* p = wk.center.data() + c * dim;
+		for(size_t i = 0; i < dim; ++i)
+			p[i] = w[off + i] / n;
+		wk.cnorm[c] = simd_dot(p, p, dim);
+	}
+	wk.centerReady = true;
+}
+
+std::pair<size_t, double> KMeans::assign(Work& wk, const FeatureView& x, const std::vector<double>& w,
+	std::vector<double>& h, const bool exact) const
+{
+	pair<size_t, double> res;
+	if(checkBounds(wk, x, w, h, exact, res))
+		return res;
+	// full scan, it keeps the nearest and the second nearest distance
+	size_t best = ncenter;
+	double d1 = INF, d2 = INF;
+	size_t off = 0;
+	for(size_t i = 0; i < ncenter; ++i, off += dim + 1){
+		if(round(w[off + dim]) == 0.0) // empty center
+			continue;
+		double d = dist(x, w.data() + off, w[off + dim]);
+		if(best == ncenter || d < d1){
+			d2 = d1;
+			d1 = d;
+			best = i;
+		} else if(d < d2){
+			d2 = d;
+		}
+	}
+	return finishScan(wk, w, h, best, d1, d2);
+}
+
+bool KMeans::checkBounds(Work& wk, const FeatureView& x, const std::vector<double>& w,
+	std::vector<double>& h, const bool exact, std::pair<size_t, double>& res) const
+{
+	size_t a = static_cast<size_t>(h[0]);
+	if(h[3] != wk.tag || a >= ncenter || round(w[a * (dim + 1) + dim]) == 0.0)
+		return false;
+	// the bounds after the centers moved
+	double u = h[1] + wk.drift[a];
+	double l = h[2] - wk.maxDrift;
+	double bound = wk.half.empty() ? l : max(l, wk.half[a]);
+	if(!exact && u <= bound){
+		res = { a, u };
+		return true;
+	}
+	// tighten the upper bound
+	const size_t off = a * (dim + 1);
+	u = dist(x, w.data() + off, w[off + dim]);
+	h[1] = u - wk.drift[a];
+	res = { a, u };
+	return u <= bound;
+}
+
+std::pair<size_t, double> KMeans::finishScan(Work& wk, const std::vector<double>& w, std::vector<double>& h,
+	const size_t best, const double d1, const double d2) const
+{
+	if(best == ncenter){ // no center has a point
+		size_t a = static_cast<size_t>(h[0]);
+		h[3] = 0.0;
+		return { a < ncenter ? a : 0, INF };
+	}
+	h[1] = d1 - wk.drift[best];
+	h[2] = d2 + wk.maxDrift;
+	h[3] = wk.tag;
+	// the half distances pay off once there are as many full scans as centers
+	if(wk.half.empty() && ++wk.nFull >= ncenter)
+		computeHalf(wk, w);
+	return { best, d1 };
+}
+
+void KMeans::scanTile(Work& wk, const DataPointView* dps, const size_t* idx, const size_t m,
+	const std::vector<double>& w, std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	prepareCenters(wk, w);
+	wk.tile.resize(m * dim);
+	for(size_t j = 0; j < m; ++j)
+		dps[idx[j]].x[0].copyTo(wk.tile.data() + j * dim);
+	wk.prod.assign(m * ncenter, 0.0);
+	gemm_nt(m, ncenter, dim, wk.tile.data(), dim, wk.center.data(), dim, wk.prod.data(), ncenter);
+	for(size_t j = 0; j < m; ++j){
+		const size_t i = idx[j];
+		const double* x = wk.tile.data() + j * dim;
+		const double* g = wk.prod.data() + j * ncenter;
+		const double xx = simd_dot(x, x, dim);
+		// squared distances, the empty centers have an infinite norm
+		size_t best = ncenter;
+		double s1 = INF, s2 = INF;
+		for(size_t c = 0; c < ncenter; ++c){
+			if(wk.cnorm[c] == INF)
+				continue;
+			double s = max(0.0, xx - 2 * g[c] + wk.cnorm[c]);
+			if(best == ncenter || s < s1){
+				s2 = s1;
+				s1 = s;
+				best = c;
+			} else if(s < s2){
+				s2 = s;
+			}
+		}
+		vector<double>& h = hidden(wk, ph, i);
+		pair<size_t, double> r = finishScan(wk, w, h, best, sqrt(s1), sqrt(s2));
+		moveGradient(dps[i].x[0], static_cast<size_t>(h[0]), r.first, grad);
+		h[0] = static_cast<double>(r.first);
+		if(loss)
+			loss[i] = r.second;
+	}
+}
+
+double KMeans::centerDist(it_t a, const double na, it_t b, const double nb) const
+{
+	const double ra = round(na), rb = round(nb);
+	if(ra == 0.0 || rb == 0.0)
+		return INF;
+	double r = 0.0;
+	for(size_t i = 0; i < dim; ++i){
+		double t = a[i] / ra - b[i] / rb;
 		r += t * t;
 	}
 	return sqrt(r);
 }
 
-double KMeans::quickDist(it_t xf, it_t xl, it_t yf, const double n)
+double KMeans::dist(const FeatureView& x, it_t yf, const double n)
 {
-	double yy = 0.0;
-	double xy = 0.0;
-	while(xf != xl){
-		xy += *xf * *yf;
-		yy += *yf * *yf;
-		++xf;
-		++yf;
+	double nn = round(n);
+	double r = 0.0;
+	if(x.isSparse()){
+		// sum (y_i/n)^2 + sum_{x_i != 0} (x_i^2 - 2 x_i y_i/n)
+		for(size_t i = 0; i < x.size(); ++i)
+			r += yf[i] * yf[i];
+		r /= nn * nn;
+		x.forEach([&](const size_t i, const double v){
+			r += v * (v - 2 * yf[i] / nn);
+		});
+		return sqrt(max(0.0, r));
 	}
+	x.forEach([&](const size_t i, const double v){
+		double t = v - yf[i] / nn;
+		r += t * t;
+	});
+	return sqrt(r);
+}
+
+double KMeans::quickDist(const FeatureView& x, it_t yf, const double n)
+{
+	double yy = 0.0;
+	for(size_t i = 0; i < x.size(); ++i)
+		yy += yf[i] * yf[i];
+	double xy = x.dot(yf);
 	return yy - 2 * round(n) * xy;
 }
 
-size_t KMeans::quickPredict(const std::vector<double>& x, const std::vector<double>& w) const
+size_t KMeans::quickPredict(const FeatureView& x, const std::vector<double>& w) const
 {
 	size_t min_id = ncenter;
 	double min_v;
 	size_t off = 0;
 	for(size_t i = 0; i < ncenter; ++i){
-		double d = quickDist(x.begin(), x.end(), w.begin() + off, w[off + dim]);
+		double d = quickDist(x, w.data() + off, w[off + dim]);
 		off += dim + 1;
 		if(min_id == ncenter || d < min_v){
 			min_id = i;
@@ -12,28 +12,104 @@ public:
 	int lengthParameter() const;
 	bool needInitParameterByData() const;
 
+	// ph: the assignment, then the upper and lower bounds of the bounded assignment and their tag
 	int lengthHidden() const;
-	void initVariables(const std::vector<std::vector<double>>& x,
-		std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph);
+	void initVariables(const FeatureListView& x,
+		std::vector<double>& w, const FeatureView& y, std::vector<double>* ph);
 
-	std::vector<double> predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w) const;
+	std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const;
 	int classify(const double p) const;
-	double loss(const std::vector<double>& pred, const std::vector<double>& label) const;
+	double loss(const std::vector<double>& pred, const FeatureView& label) const;
 
-	std::vector<double> forward(const std::vector<std::vector<double>>& x, const std::vector<double>& w);
-	std::vector<double> backward(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph);
-	// ph stores the current assignment of the node
-	std::vector<double> gradient(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const;
+	std::vector<double> forward(const FeatureListView& x, const std::vector<double>& w);
+	std::vector<double> backward(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph);
+	// ph stores the current assignment of the node. without it, x is counted as a new point of its center
+	std::vector<double> gradient(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const;
+	// without the objective value appended by gradient()
+	void accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const;
+	// pred is {assignment, distance}
+	double lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+		std::vector<double>& grad, std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	// loss[i] is the objective value of point i
+	void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	void fixParameter(const std::vector<double>& w) const;
+
+	// the assignment is bounded (Hamerly): each point keeps an upper bound of the distance to its
+	// center and a lower bound of the distance to the others. the workspace tracks how far the
+	// centers move between calls, which loosens the bounds. a point whose bounds still separate
+	// its center from the others costs one distance (or none without loss), instead of one per center.
+	// the bounds are only valid with the workspace that made them, others do a full scan.
+	// batchGradient() does the full scans of dense points in tiles, in the matrix form
+	// ||x||^2 - 2 x.c + ||c||^2 with one matrix product against the centers
+	Workspace* makeWorkspace() const;
+	void accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	double lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred = nullptr,
+		std::vector<double>* ph = nullptr) const;
+	void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	// the per-point calls after it skip comparing <w> with the last one
+	void fixParameter(Workspace& ws, const std::vector<double>& w) const;
 
 private:
-	using it_t = typename std::vector<double>::const_iterator;
-	static double dist(it_t xf, it_t xl, it_t yf, const double n);
+	using it_t = const double*;
+	static double dist(const FeatureView& x, it_t yf, const double n);
 	// sum (x_i - y_i/n)^2 . x is fixed and y changes. 
 	// change to sum(y_i^2) - 2*n*sum ( x_i - y_i)^2
-	static double quickDist(it_t xf, it_t xl, it_t yf, const double n);
-	size_t quickPredict(const std::vector<double>& x, const std::vector<double>& w) const;
+	static double quickDist(const FeatureView& x, it_t yf, const double n);
+	size_t quickPredict(const FeatureView& x, const std::vector<double>& w) const;
+	// the distance between two centers given by their sums and counts, infinite if one is empty
+	double centerDist(it_t a, const double na, it_t b, const double nb) const;
+
+	struct Work : public Workspace {
+		double tag; // marks the bounds made with this workspace
+		std::vector<double> last; // the parameter of the last call
+		bool fixed; // <last> is the parameter until the next batch call or fixParameter()
+		std::vector<double> drift; // accumulated movement of each center
+		double maxDrift; // accumulated maximum movement of all centers
+		std::vector<double> half; // half distance from each center to the nearest other one
+		size_t nFull; // full scans with the current centers
+		// the matrix form: the centers (one row each) and their squared norms (infinite if empty)
+		bool centerReady;
+		std::vector<double> center, cnorm;
+		std::vector<size_t> pending; // points of a batch which need a full scan
+		std::vector<double> tile, prod; // their x and x*center^T
+		std::vector<double> scratch; // the hidden state of the calls without one
+	};
+	// start a new tag, the bounds made so far become invalid
+	void resetWork(Work& wk) const;
+	// called once per call with the parameter <w>, update the drift if the centers moved.
+	// the per-point calls skip it while the parameter is fixed
+	void updateWork(Work& wk, const std::vector<double>& w) const;
+	void updatePoint(Work& wk, const std::vector<double>& w) const;
+	void computeHalf(Work& wk, const std::vector<double>& w) const;
+	void prepareCenters(Work& wk, const std::vector<double>& w) const;
+	// find the nearest center of x and update the bounds in <h>. return {center, distance}.
+	// if <exact> is false, the distance may be an upper bound
+	std::pair<size_t, double> assign(Work& wk, const FeatureView& x, const std::vector<double>& w,
+		std::vector<double>& h, const bool exact) const;
+	// return true and set <res> if the bounds in <h> still hold
+	bool checkBounds(Work& wk, const FeatureView& x, const std::vector<double>& w,
+		std::vector<double>& h, const bool exact, std::pair<size_t, double>& res) const;
+	// set the bounds after a full scan found the nearest center <best> at <d1>, the second one at <d2>
+	std::pair<size_t, double> finishScan(Work& wk, const std::vector<double>& w, std::vector<double>& h,
+		const size_t best, const double d1, const double d2) const;
+	// full scans of the points dps[idx[0..m)] in the matrix form
+	void scanTile(Work& wk, const DataPointView* dps, const size_t* idx, const size_t m,
+		const std::vector<double>& w, std::vector<double>& grad, double* loss, std::vector<double>* ph) const;
+	// the hidden state of point i. without <ph> (i.e. the batches of GD and PSGD) it is a fresh one:
+	// the point has no assignment and no bounds, so it is added to its nearest center
+	std::vector<double>& hidden(Work& wk, std::vector<double>* ph, const size_t i) const;
+	// move the statistics of x from center <from> (ncenter: none) to center <to>
+	void moveGradient(const FeatureView& x, const size_t from, const size_t to, std::vector<double>& grad) const;
+	// move x to its nearest center in <grad>, return {center, objective value}
+	std::pair<size_t, double> addGradient(Work& wk, const FeatureListView& x, const std::vector<double>& w,
+		std::vector<double>& grad, std::vector<double>* ph, const bool exact = true) const;
 	
 private:
 	size_t dim;
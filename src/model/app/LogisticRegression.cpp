@@ -1,6 +1,7 @@
 #include "LogisticRegression.h"
 #include "math/activation_func.h"
 #include <cmath>
+#include <algorithm>
 #include <stdexcept>
 using namespace std;
 
@@ -35,12 +36,10 @@ int LogisticRegression::lengthParameter() const
 }
 
 std::vector<double> LogisticRegression::predict(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w) const
+	const FeatureListView& x, const std::vector<double>& w) const
 {
-	double t = w.back();
-	for (int i = 0; i < xlength; ++i) {
-		t += x[0][i] * w[i];
-	}
+	// dequantization of reduced-precision x is fused into the dot product
+	double t = w.back() + x[0].dot(w.data());
 	return { sigmoid(t) };
 }
 
@@ -52,17 +51,22 @@ int LogisticRegression::classify(const double p) const
 constexpr double MAX_LOSS = 100;
 
 double LogisticRegression::loss(
-	const std::vector<double>& pred, const std::vector<double>& label) const
+	const std::vector<double>& pred, const FeatureView& label) const
+{
+	return lossValue(pred[0], label[0]);
+}
+
+double LogisticRegression::lossValue(const double pred, const double label) const
 {
 	//double cost1 = label * log(pred);
 	//double cost2 = (1 - label)*log(1 - pred);
 	//return -(cost1 + cost2);
 	// the above got overflow
 	double cost;
-	if(label[0] == 0.0){
-		cost = log(1 - pred[0]);
+	if(label == 0.0){
+		cost = log(1 - pred);
 	} else{
-		cost = log(pred[0]);
+		cost = log(pred);
 	}
 //	if(std::isnan(cost) || std::isinf(cost)) // this std:: is needed for a know g++ bug
 	if(std::isinf(cost))
@@ -72,42 +76,94 @@ double LogisticRegression::loss(
 }
 
 std::vector<double> LogisticRegression::forward(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+	const FeatureListView& x, const std::vector<double>& w)
 {
-	double t = w.back();
-	for(int i = 0; i < xlength; ++i) {
-		t += x[0][i] * w[i];
-	}
+	double t = w.back() + x[0].dot(w.data());
 	mid = sigmoid(t);
 	return { mid };
 }
 
-std::vector<double> LogisticRegression::backward(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+std::vector<double> LogisticRegression::backward(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
 	// s'(x) = s(x)*(1-s(x))
 	// c'(x) = x*(s(x) - y)
 	//assert(w.size() == xlength+1);
 	double g0 = mid - y[0];
-	vector<double> grad(w.size(), g0);
-	for(size_t i = 0; i < xlength; ++i) {
-		grad[i] *= x[0][i];
-	}
+	vector<double> grad(w.size(), 0.0);
+	x[0].axpy(g0, grad.data());
+	grad.back() = g0;
 	return grad;
 }
 
-std::vector<double> LogisticRegression::gradient(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const
+std::vector<double> LogisticRegression::gradient(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const
 {
 	// s'(x) = s(x)*(1-s(x))
 	// c'(x) = x*(s(x) - y)
 	//assert(w.size() == xlength+1);
 	double pred = predict(x, w)[0];
 	double g0 = pred - y[0];
-	vector<double> grad(w.size(), g0);
-	for (size_t i = 0; i < xlength; ++i) {
-		grad[i] *= x[0][i];
-	}
+	vector<double> grad(w.size(), 0.0);
+	x[0].axpy(g0, grad.data());
+	grad.back() = g0;
 	return grad;
 }
 
+void LogisticRegression::accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph)
+{
+	double g0 = mid - y[0];
+	x[0].axpy(g0, grad.data());
+	grad.back() += g0;
+}
+
+void LogisticRegression::accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	double g0 = predict(x, w)[0] - y[0];
+	x[0].axpy(g0, grad.data());
+	grad.back() += g0;
+}
+
+double LogisticRegression::lossAndGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	const double p = sigmoid(w.back() + x[0].dot(w.data()));
+	const double g0 = p - y[0];
+	x[0].axpy(g0, grad.data());
+	grad.back() += g0;
+	if(pred)
+		*pred = { p };
+	return lossValue(p, y[0]);
+}
+
+void LogisticRegression::batchBackward(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph)
+{
+	// nothing is kept from forward(), so it is the same as batchGradient()
+	batchGradient(dps, n, w, grad, loss, ph);
+}
+
+void LogisticRegression::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	// the sigmoid is applied to a chunk of dot products at a time
+	constexpr size_t CHUNK = 64;
+	double pred[CHUNK];
+	for(size_t i0 = 0; i0 < n; i0 += CHUNK){
+		const size_t m = min(CHUNK, n - i0);
+		for(size_t i = 0; i < m; ++i)
+			pred[i] = w.back() + dps[i0 + i].x[0].dot(w.data());
+		sigmoid_array(pred, pred, m);
+		for(size_t i = 0; i < m; ++i){
+			const FeatureView x = dps[i0 + i].x[0];
+			const double y = dps[i0 + i].y[0];
+			if(loss)
+				loss[i0 + i] = lossValue(pred[i], y);
+			const double g0 = pred[i] - y;
+			x.axpy(g0, grad.data());
+			grad.back() += g0;
+		}
+	}
+}
@@ -11,17 +11,30 @@ public:
 	std::string name() const;
 	int lengthParameter() const;
 
-	std::vector<double> predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w) const;
+	std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const;
 	int classify(const double p) const;
-	double loss(const std::vector<double>& pred, const std::vector<double>& label) const;
+	double loss(const std::vector<double>& pred, const FeatureView& label) const;
 
-	std::vector<double> forward(const std::vector<std::vector<double>>& x, const std::vector<double>& w);
-	std::vector<double> backward(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr);
-	std::vector<double> gradient(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr) const;
+	std::vector<double> forward(const FeatureListView& x, const std::vector<double>& w);
+	std::vector<double> backward(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr);
+	std::vector<double> gradient(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr) const;
+	// O(nnz) for sparse x
+	void accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr);
+	void accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	double lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+		std::vector<double>& grad, std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	// one pass per point, without any temporary vector
+	void batchBackward(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr);
+	void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
 
 private:
+	double lossValue(const double pred, const double label) const;
 	int xlength;
 	double mid;
 };
@@ -1,7 +1,10 @@
 #include "MLP.h"
 #include "math/activation_func.h"
+#include "math/gemm.h"
+#include "math/simd.h"
 #include "util/Util.h"
 #include <cmath>
+#include <algorithm>
 #include <stdexcept>
 using namespace std;
 
@@ -11,7 +14,7 @@ void MLP::init(const std::string & param)
 {
 	initBasic(param);
 	nNodeLayer = getIntList(param, " ,-");
-	if(nNodeLayer.empty())
+	if(nNodeLayer.size() < 2) // at least the input and the output layers
 		throw invalid_argument("MLP parameter not valid or does not match dataset");
 	// set n
 	nLayer = static_cast<int>(nNodeLayer.size());
@@ -40,9 +43,8 @@ int MLP::lengthParameter() const
 }
 
 std::vector<double> MLP::predict(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w) const
+	const FeatureListView& x, const std::vector<double>& w) const
 {
-	proxy.bind(&w);
 	vector<double> mid = activateLayer(x[0], w, 0);
 	for(int l = 1; l < nLayer - 1; ++l){
 		mid = activateLayer(mid, w, l);
@@ -57,7 +59,7 @@ int MLP::classify(const double p) const
 
 constexpr double MAX_LOSS = 100;
 
-double MLP::loss(const std::vector<double>& pred, const std::vector<double>& label) const {
+double MLP::loss(const std::vector<double>& pred, const FeatureView& label) const {
 	double res = 0.0;
 	for(size_t i = 0; i < pred.size(); ++i){
 		double t = pred[i] - label[i];
@@ -68,156 +70,193 @@ double MLP::loss(const std::vector<double>& pred, const std::vector<double>& lab
 }
 
 std::vector<double> MLP::forward(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+	const FeatureListView& x, const std::vector<double>& w)
 {
-	proxy.bind(&w);
-	mid[0] = x[0];
+	mid[0] = x[0].toVector();
 	for(int l = 0; l < nLayer - 1; ++l){
 		mid[l + 1] = activateLayer(mid[l], w, l);
 	}
 	return mid.back();
 }
 
-std::vector<double> MLP::backward(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+std::vector<double> MLP::backward(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
 	vector<double> grad(w.size());
-	vector<double> delta; // used for all but the first iteration (l==nLayer-2)
-	for(int l = nLayer - 2; l >= 0; --l){
-		// prepare
-		const int n = nNodeLayer[l];
-		const int m = nNodeLayer[l + 1];
-		const vector<double>& pred = mid[l+1];
-		// error
-		vector<double> error(m);
-		if(l == nLayer - 2){
-			//error = pred - y;
-			for(int i = 0; i < m; ++i)
-				error[i] = pred[i] - y[i];
-		} else{
-			//error = np.dot(delta, self.w[i + 1].T)
-			MLPProxyLayer wl = proxy[l + 1];
-			int h = nNodeLayer[l + 2];
-			for(int i = 0; i < m; ++i){
-				MLPProxyNode wn = wl[i];
-				for(int j = 0; j < h; ++j)
-					error[i] += delta[j] * wn[j]; // <delta> is left by last iteration
-			}
-		}
-		// delta
-		//delta = error * self.sigmoidPrime(pred)
-		delta.resize(m);
-		for(int i = 0; i < m; ++i){
-			delta[i] = error[i] * sigmoid_derivative(pred[i]);
-		}
-		// grad
-		//grad = np.dot(self.output[i].T, delta)
-		MLPProxyLayer wl = proxy[l];
-		for(int i = 0; i < n + 1; ++i){
-			MLPProxyNode wn = wl[i];
-			double v = (i != n) ? mid[l][i] : 1.0;
-			for(int j = 0; j < m; ++j){
-				int offset = wn.position(j);
-				grad[offset] = v * delta[j];
-			}
-		}
-	}
+	accumulateBackward(x, w, y, grad, ph);
+	return grad;
+}
+
+// forward() is not needed, the gradient is computed from x again
+void MLP::accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph)
+{
+	accumulateGradient(x, w, y, grad, ph);
+}
+
+std::vector<double> MLP::gradient(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const
+{
+	vector<double> grad(w.size());
+	accumulateGradient(x, w, y, grad, ph);
 	return grad;
 }
 
-std::vector<double> MLP::gradient(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const
+void MLP::accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	lossAndGradient(defaultWorkspace(), x, w, y, grad, nullptr, ph);
+}
+
+double MLP::lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+	std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return lossAndGradient(defaultWorkspace(), x, w, y, grad, pred, ph);
+}
+
+void MLP::batchBackward(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph)
+{
+	batchGradient(dps, n, w, grad, loss, ph);
+}
+
+void MLP::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	batchGradient(defaultWorkspace(), dps, n, w, grad, loss, ph);
+}
+
+Workspace* MLP::makeWorkspace() const
+{
+	return new Work();
+}
+
+void MLP::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	if(n == 0)
+		return;
+	Work& wk = static_cast<Work&>(ws);
+	if(!fp32){
+		batchGradientImpl(wk.d, dps, n, w.data(), grad.data(), loss);
+		return;
+	}
+	// the weights are converted once per batch, the gradient of the batch is added in double
+	Buffer<float>& bf = wk.f;
+	bf.w.assign(w.begin(), w.end());
+	bf.grad.assign(w.size(), 0.0f);
+	batchGradientImpl(bf, dps, n, bf.w.data(), bf.grad.data(), loss);
+	for(size_t i = 0; i < grad.size(); ++i)
+		grad[i] += bf.grad[i];
+}
+
+void MLP::accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	lossAndGradient(ws, x, w, y, grad, nullptr, ph);
+}
+
+double MLP::lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	// a batch of one point, in double
+	Buffer<double>& bf = static_cast<Work&>(ws).d;
+	const DataPointView dp{ x, y };
+	double res;
+	batchGradientImpl(bf, &dp, 1, w.data(), grad.data(), &res);
+	if(pred)
+		pred->assign(bf.act.back().begin(), bf.act.back().end());
+	return res;
+}
+
+bool MLP::setFloat32(const bool on)
 {
-	proxy.bind(&w);
-	// forward
-	vector<vector<double>> buffer; // buffer for <pred>
-	buffer.reserve(nLayer); // important: make sure earlier iterators valid all the time
-	vector<const vector<double>*> output; // the output of each layer
-	output.push_back(&x[0]); // layer 0 same as x, the rest are <buffer>
+	fp32 = on;
+	return true;
+}
+
+template <typename T>
+void MLP::batchGradientImpl(Buffer<T>& bf, const DataPointView* dps, const size_t n,
+	const T* w, T* grad, double* loss) const
+{
+	vector<vector<T>>& bact = bf.act;
+	vector<T>& bdelta = bf.delta;
+	vector<T>& berror = bf.error;
+	// the weights of layer l are a (nNodeLayer[l]+1) x nNodeLayer[l+1] matrix, whose last row is the offset
+	bact.resize(nLayer);
+	const size_t nx = nNodeLayer[0];
+	bact[0].resize(n * nx);
+	for(size_t b = 0; b < n; ++b)
+		dps[b].x[0].copyTo(bact[0].data() + b * nx);
+	// forward: out = sigmoid(in * W + offset)
 	for(int l = 0; l < nLayer - 1; ++l){
-		vector<double> mid = activateLayer(*output[l], w, l);
-		buffer.push_back(move(mid));
-		output.push_back(&buffer[l]);
+		const size_t ni = nNodeLayer[l];
+		const size_t mi = nNodeLayer[l + 1];
+		const T* wl = w + proxy.nWeightLayerOffset[l];
+		vector<T>& out = bact[l + 1];
+		out.resize(n * mi);
+		for(size_t b = 0; b < n; ++b)
+			copy(wl + ni * mi, wl + (ni + 1) * mi, out.begin() + b * mi);
+		gemm_nn(n, mi, ni, bact[l].data(), ni, wl, mi, out.data(), mi);
+		sigmoid_array(out.data(), out.data(), out.size());
+	}
+	// loss and delta of the last layer, the loss is summed in double
+	const size_t ny = nNodeLayer.back();
+	const vector<T>& pred = bact.back();
+	bdelta.resize(n * ny);
+	sigmoid_derivative_array(pred.data(), bdelta.data(), n * ny);
+	for(size_t b = 0; b < n; ++b){
+		double res = 0.0;
+		for(size_t j = 0; j < ny; ++j){
+			double e = pred[b * ny + j] - dps[b].y[j];
+			res += e * e;
+			bdelta[b * ny + j] = static_cast<T>(e * bdelta[b * ny + j]);
+		}
+		if(loss)
+			loss[b] = res;
 	}
 	// backward
-	vector<double> grad(w.size());
-	/*
-	delta = np.array()
-	for i in range(len(self.layers)-2, -1, -1):
-		pred = self.output[i+1]
-		if i == len(self.layers) - 2:
-			error = pred - y
-		else:
-			error = np.dot(delta, self.w[i+1].T)
-		delta = error * self.sigmoidPrime(pred)
-		grad = np.dot(self.output[i].T, delta)
-		self.w[i] += -self.lrate * grad
-	*/
-	vector<double> delta; // used for all but the first iteration (l==nLayer-2)
 	for(int l = nLayer - 2; l >= 0; --l){
-		// prepare
-		const int n = nNodeLayer[l];
-		const int m = nNodeLayer[l+1];
-		const vector<double>& pred = *output[l+1];
-		// error
-		vector<double> error(m);
-		if(l == nLayer - 2){
-			//error = pred - y;
-			for(int i = 0; i < m; ++i)
-				error[i] = pred[i] - y[i];
-		} else{
-			//error = np.dot(delta, self.w[i + 1].T)
-			MLPProxyLayer wl = proxy[l + 1];
-			int h = nNodeLayer[l + 2];
-			for(int i = 0; i < m; ++i){
-				MLPProxyNode wn = wl[i];
-				for(int j = 0; j < h; ++j)
-					error[i] += delta[j] * wn[j]; // <delta> is left by last iteration
-			}
-		}
-		// delta
-		//delta = error * self.sigmoidPrime(pred)
-		delta.resize(m);
-		for(int i = 0; i < m; ++i){
-			delta[i] = error[i] * sigmoid_derivative(pred[i]);
-		}
-		// grad
-		//grad = np.dot(self.output[i].T, delta)
-		MLPProxyLayer wl = proxy[l];
-		for(int i = 0; i < n+1; ++i){
-			MLPProxyNode wn = wl[i];
-			double v = (i != n) ? (*output[l])[i] : 1.0;
-			for(int j = 0; j < m; ++j){
-				int offset = wn.position(j);
-				grad[offset] = v * delta[j];
-			}
-		}
+		const size_t ni = nNodeLayer[l];
+		const size_t mi = nNodeLayer[l + 1];
+		const T* wl = w + proxy.nWeightLayerOffset[l];
+		T* gl = grad + proxy.nWeightLayerOffset[l];
+		// grad += in^T * delta, the offset row gets the sum of delta
+		gemm_tn(ni, mi, n, bact[l].data(), ni, bdelta.data(), mi, gl, mi);
+		for(size_t b = 0; b < n; ++b)
+			simd_axpy(T(1), bdelta.data() + b * mi, gl + ni * mi, mi);
+		if(l == 0)
+			break;
+		// delta of layer l: (delta * W^T) .* sigmoid'(in)
+		berror.assign(n * ni, T(0));
+		gemm_nt(n, ni, mi, bdelta.data(), mi, wl, mi, berror.data(), ni);
+		bdelta.resize(n * ni);
+		sigmoid_derivative_array(bact[l].data(), bdelta.data(), n * ni);
+		for(size_t k = 0; k < n * ni; ++k)
+			bdelta[k] *= berror[k];
 	}
-
-	return grad;
 }
 
 double MLP::getWeight(const std::vector<double>& w, const int layer, const int from, const int to) const
 {
-	proxy.bind(&w);
-	return proxy.get(layer, from, to);
+	return proxy.getLayerProxy(layer, &w).get(from, to);
 }
 
 std::vector<double> MLP::activateLayer(
-	const std::vector<double>& x, const std::vector<double>& w, const int layer) const
+	const FeatureView& x, const std::vector<double>& w, const int layer) const
 {
 	int n = nNodeLayer[layer];
 	//assert(x.size() == n);
 	int m = nNodeLayer[layer + 1];
 	std::vector<double> res(m, 0.0); // # of real nodes in next layer
-	MLPProxyLayer wl = proxy[layer]; // assume w has already been bound
-	// real neuron part
-	for(int i = 0; i < n; ++i){
-		MLPProxyNode wn = wl[i];
+	MLPProxyLayer wl = proxy.getLayerProxy(layer, &w);
+	// real neuron part, x is read (and dequantized) once
+	x.forEach([&](const size_t i, const double v){
+		MLPProxyNode wn = wl[static_cast<int>(i)];
 		for(int j = 0; j < m; ++j){
-			res[j] += x[i] * wn[j];
+			res[j] += v * wn[j];
 		}
-	}
+	});
 	// dummy neuron (constant value 1) part
 	MLPProxyNode wn = wl[n];
 	for(int j = 0; j < m; ++j){
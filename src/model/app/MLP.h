@@ -7,28 +7,67 @@ class MLP
 {
 	int nLayer;
 	std::vector<int> nNodeLayer;
-	mutable MLPProxy proxy; // non-const bind function required
+	MLPProxy proxy; // weights are given to each layer proxy, the proxy is not bound
 public:
 	void init(const std::string& param);
 	bool checkData(const size_t nx, const size_t ny);
 	std::string name() const;
 	int lengthParameter() const;
 
-	std::vector<double> predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w) const;
+	std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const;
 	int classify(const double p) const;
-	double loss(const std::vector<double>& pred, const std::vector<double>& label) const;
+	double loss(const std::vector<double>& pred, const FeatureView& label) const;
 
-	std::vector<double> forward(const std::vector<std::vector<double>>& x, const std::vector<double>& w);
-	std::vector<double> backward(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr);
-	std::vector<double> gradient(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr) const;
+	std::vector<double> forward(const FeatureListView& x, const std::vector<double>& w);
+	std::vector<double> backward(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr);
+	std::vector<double> gradient(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr) const;
+	// a point is a batch of one (in double) with the buffers of the workspace, so they do not allocate
+	void accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr);
+	void accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	// the output of the last layer is the prediction
+	double lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+		std::vector<double>& grad, std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	// the points are stacked into a matrix, each layer is one matrix product per direction
+	void batchBackward(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr);
+	void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	// the buffers of the gradient functions are in the workspace, predict() keeps no state
+	Workspace* makeWorkspace() const;
+	void accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	double lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred = nullptr,
+		std::vector<double>* ph = nullptr) const;
+	void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	// the batch functions have a float32 version
+	bool setFloat32(const bool on);
 private:
 	double getWeight(const std::vector<double>& w, const int layer, const int from, const int to) const;
 
-	// require: proxy.bind(&w) had been called before
 	std::vector<double> activateLayer(
-		const std::vector<double>& x, const std::vector<double>& w, const int layer) const;
+		const FeatureView& x, const std::vector<double>& w, const int layer) const;
 private:
 	std::vector<std::vector<double>> mid;
+protected:
+	// buffers of the batch functions in type T: the output of each layer (one row per point), the deltas,
+	// and for float32 a copy of the weights and the gradient of the batch
+	template <typename T>
+	struct Buffer {
+		std::vector<std::vector<T>> act;
+		std::vector<T> delta, error;
+		std::vector<T> w, grad;
+	};
+	struct Work : public Workspace {
+		Buffer<double> d;
+		Buffer<float> f;
+	};
+	template <typename T>
+	void batchGradientImpl(Buffer<T>& bf, const DataPointView* dps, const size_t n,
+		const T* w, T* grad, double* loss) const;
 };
@@ -0,0 +1,231 @@
+#pragma once
+#include "MLP.h"
+#include "math/activation_func.h"
+#include "math/gemm.h"
+#include "util/Util.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+// MLP whose layer sizes are compile-time constants, i.e. MLPFixed<784, 300, 10>.
+// KernelFactory makes one for the registered shapes. The layers with a narrow output are done with
+// loops of constant trip counts, which the compiler unrolls and vectorizes across the outputs.
+// The wide layers keep the blocked gemm. The float32 batch and the per-point gradients are the ones of MLP.
+template <int... L>
+class MLPFixed
+	: public MLP
+{
+	static constexpr int NL = sizeof...(L);
+	static constexpr int shape[NL] = { L... };
+	// the output rows of at most this many values are kept in registers
+	static constexpr int NARROW = 32;
+	static_assert(NL >= 2, "MLPFixed needs at least the input and the output layers");
+public:
+	void init(const std::string& param);
+
+	std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const;
+	void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+	void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
+
+private:
+	// offset of the weights of layer l, each one is a (N+1) x M matrix whose last row is the offset
+	static constexpr size_t weightOffset(const int l){
+		size_t off = 0;
+		for(int i = 0; i < l; ++i)
+			off += (shape[i] + 1) * shape[i + 1];
+		return off;
+	}
+
+	// out[n x M] = sigmoid(in[n x N] * W + offset)
+	template <int N, int M>
+	static void layerForward(const size_t n, const double* in, const double* w, double* out);
+	// grad += in^T * delta, and the error of the layer below: error[n x N] = delta * W^T
+	template <int N, int M>
+	static void layerBackward(const size_t n, const double* in, const double* w, const double* delta,
+		double* grad, double* error);
+
+	template <size_t... I>
+	void forwardAll(std::index_sequence<I...>, Buffer<double>& bf, const size_t n, const double* w) const;
+	template <size_t... I>
+	void backwardAll(std::index_sequence<I...>, Buffer<double>& bf, const size_t n,
+		const double* w, double* grad) const;
+	// the layer under the output first
+	template <int l>
+	void backwardLayer(Buffer<double>& bf, const size_t n, const double* w, double* grad) const;
+};
+
+template <int... L>
+constexpr int MLPFixed<L...>::shape[];
+
+template <int... L>
+void MLPFixed<L...>::init(const std::string& param)
+{
+	MLP::init(param);
+	const std::vector<int> nodes = getIntList(param, " ,-");
+	if(!std::equal(nodes.begin(), nodes.end(), shape, shape + NL) || nodes.size() != NL)
+		throw std::invalid_argument("MLP parameter does not match the fixed shape");
+}
+
+template <int... L>
+template <int N, int M>
+void MLPFixed<L...>::layerForward(const size_t n, const double* in, const double* w, double* out)
+{
+	const double* offset = w + N * M;
+	if(M <= NARROW){
+		for(size_t b = 0; b < n; ++b){
+			const double* x = in + b * N;
+			double acc[M];
+			for(int j = 0; j < M; ++j)
+				acc[j] = offset[j];
+			for(int i = 0; i < N; ++i){
+				const double v = x[i];
+				const double* r = w + i * M;
+				for(int j = 0; j < M; ++j)
+					acc[j] += v * r[j];
+			}
+			std::copy(acc, acc + M, out + b * M);
+		}
+	} else{
+		for(size_t b = 0; b < n; ++b)
+			std::copy(offset, offset + M, out + b * M);
+		gemm_nn(n, M, N, in, N, w, M, out, M);
+	}
+	sigmoid_array(out, out, n * M);
+}
+
+template <int... L>
+template <int N, int M>
+void MLPFixed<L...>::layerBackward(const size_t n, const double* in, const double* w, const double* delta,
+	double* grad, double* error)
+{
+	double* goff = grad + N * M;
+	if(M <= NARROW){
+		for(size_t b = 0; b < n; ++b){
+			const double* x = in + b * N;
+			double d[M];
+			std::copy(delta + b * M, delta + (b + 1) * M, d);
+			for(int i = 0; i < N; ++i){
+				const double v = x[i];
+				if(v == 0.0)
+					continue;
+				double* g = grad + i * M;
+				for(int j = 0; j < M; ++j)
+					g[j] += v * d[j];
+			}
+			for(int j = 0; j < M; ++j)
+				goff[j] += d[j];
+			if(error != nullptr){
+				double* e = error + b * N;
+				for(int i = 0; i < N; ++i){
+					const double* r = w + i * M;
+					double s = 0.0;
+					for(int j = 0; j < M; ++j)
+						s += d[j] * r[j];
+					e[i] = s;
+				}
+			}
+		}
+	} else{
+		gemm_tn(N, M, n, in, N, delta, M, grad, M);
+		for(size_t b = 0; b < n; ++b)
+			for(int j = 0; j < M; ++j)
+				goff[j] += delta[b * M + j];
+		if(error != nullptr){
+			std::fill(error, error + n * N, 0.0);
+			gemm_nt(n, N, M, delta, M, w, M, error, N);
+		}
+	}
+}
+
+template <int... L>
+template <size_t... I>
+void MLPFixed<L...>::forwardAll(std::index_sequence<I...>, Buffer<double>& bf, const size_t n, const double* w) const
+{
+	int order[] = { (bf.act[I + 1].resize(n * shape[I + 1]),
+		layerForward<shape[I], shape[I + 1]>(n, bf.act[I].data(), w + weightOffset(I), bf.act[I + 1].data()), 0)... };
+	(void)order;
+}
+
+template <int... L>
+template <int l>
+void MLPFixed<L...>::backwardLayer(Buffer<double>& bf, const size_t n, const double* w, double* grad) const
+{
+	constexpr int N = shape[l], M = shape[l + 1];
+	double* error = nullptr;
+	if(l != 0){
+		bf.error.resize(n * N);
+		error = bf.error.data();
+	}
+	layerBackward<N, M>(n, bf.act[l].data(), w + weightOffset(l), bf.delta.data(), grad + weightOffset(l), error);
+	if(l == 0)
+		return;
+	// delta of layer l: error .* sigmoid'(in)
+	bf.delta.resize(n * N);
+	sigmoid_derivative_array(bf.act[l].data(), bf.delta.data(), n * N);
+	for(size_t k = 0; k < n * N; ++k)
+		bf.delta[k] *= bf.error[k];
+}
+
+template <int... L>
+template <size_t... I>
+void MLPFixed<L...>::backwardAll(std::index_sequence<I...>, Buffer<double>& bf, const size_t n,
+	const double* w, double* grad) const
+{
+	int order[] = { (backwardLayer<NL - 2 - static_cast<int>(I)>(bf, n, w, grad), 0)... };
+	(void)order;
+}
+
+template <int... L>
+std::vector<double> MLPFixed<L...>::predict(const FeatureListView& x, const std::vector<double>& w) const
+{
+	Buffer<double> bf;
+	bf.act.resize(NL);
+	bf.act[0].resize(shape[0]);
+	x[0].copyTo(bf.act[0].data());
+	forwardAll(std::make_index_sequence<NL - 1>(), bf, 1, w.data());
+	return std::move(bf.act.back());
+}
+
+template <int... L>
+void MLPFixed<L...>::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	batchGradient(defaultWorkspace(), dps, n, w, grad, loss, ph);
+}
+
+template <int... L>
+void MLPFixed<L...>::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n,
+	const std::vector<double>& w, std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	if(n == 0)
+		return;
+	if(useFloat32()){
+		MLP::batchGradient(ws, dps, n, w, grad, loss, ph);
+		return;
+	}
+	Buffer<double>& bf = static_cast<Work&>(ws).d;
+	bf.act.resize(NL);
+	constexpr size_t nx = shape[0];
+	bf.act[0].resize(n * nx);
+	for(size_t b = 0; b < n; ++b)
+		dps[b].x[0].copyTo(bf.act[0].data() + b * nx);
+	forwardAll(std::make_index_sequence<NL - 1>(), bf, n, w.data());
+	// loss and delta of the last layer
+	constexpr size_t ny = shape[NL - 1];
+	const std::vector<double>& pred = bf.act.back();
+	bf.delta.resize(n * ny);
+	sigmoid_derivative_array(pred.data(), bf.delta.data(), n * ny);
+	for(size_t b = 0; b < n; ++b){
+		double res = 0.0;
+		for(size_t j = 0; j < ny; ++j){
+			double e = pred[b * ny + j] - dps[b].y[j];
+			res += e * e;
+			bf.delta[b * ny + j] *= e;
+		}
+		if(loss)
+			loss[b] = res;
+	}
+	backwardAll(std::make_index_sequence<NL - 1>(), bf, n, w.data(), grad.data());
+}
@@ -1,9 +1,16 @@
 #include "RNN.h"
+#include "model/impl/NodeImpl.h"
+#include "math/activation_func.h"
+#include "math/gemm.h"
 #include "util/Util.h"
 #include <regex>
+#include <algorithm>
 #include <stdexcept>
 using namespace std;
 
+// sequences per time-major batch of the sequence mode
+static constexpr size_t SEQ_BATCH = 64;
+
 // -------- RNN --------
 
 void RNN::init(const std::string & param)
@@ -14,8 +21,19 @@ void RNN::init(const std::string & param)
 	// format: <n>,<type>[,<shape>]
 	//     shape of convolutional node: <k1>*<k2>
 	//     shape of fully-connected node: none
+	// suffix of the sequence mode: -seq[:<truncation>]
+	string pnet = param;
+	smatch m;
+	seqMode = false;
+	truncation = 0;
+	if(regex_match(param, m, regex(R"((.*)[,-]seq(?::(\d+))?)"))){
+		seqMode = true;
+		pnet = m[1];
+		if(m[2].matched)
+			truncation = stoul(m[2]);
+	}
 	try{
-		string pm = preprocessParam(param);
+		string pm = preprocessParam(pnet);
 		net.init(pm);
 		net.bindGradLossFunc(&RNN::gradLoss);
 	} catch(exception& e){
@@ -32,6 +50,28 @@ void RNN::init(const std::string & param)
 			throw invalid_argument("The last layer must be a FC layer.");
 		}
 	}
+	if(seqMode)
+		initSequenceMode();
+}
+
+void RNN::initSequenceMode()
+{
+	if(net.numFeatureLayer[0] != 1)
+		throw invalid_argument("The sequence mode needs an input layer of one feature.");
+	seqLayers.clear();
+	for(int i = 1; i < net.nLayer - 1; ++i){
+		const NodeType t = net.typeLayer[i];
+		if(t != NodeType::RecrSig && t != NodeType::RecrTanh)
+			throw invalid_argument("The sequence mode only supports recurrent layers before the FC layer.");
+		if(i < net.nLayer - 2 && net.nNodeLayer[i] != 1)
+			throw invalid_argument("In the sequence mode only the last recurrent layer can have several nodes.");
+		const RecurrentNodeBase* p = static_cast<const RecurrentNodeBase*>(net.nodes[i][0]);
+		seqLayers.push_back({ p->off, p->n, p->k, net.nNodeLayer[i], t == NodeType::RecrTanh });
+	}
+	if(seqLayers.empty())
+		throw invalid_argument("The sequence mode needs a recurrent layer.");
+	fcOff = net.nodes.back()[0]->off;
+	fcNode = net.nNodeLayer.back();
 }
 
 bool RNN::checkData(const size_t nx, const size_t ny)
@@ -55,12 +95,9 @@ int RNN::lengthParameter() const
 }
 
 std::vector<double> RNN::predict(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w) const
+	const FeatureListView& x, const std::vector<double>& w) const
 {
-	vector<double> res;
-	for(auto& line : x)
-		res = net.predict(line, w);
-	return res;
+	return predict(defaultWorkspace(), x, w);
 }
 
 int RNN::classify(const double p) const
@@ -68,7 +105,7 @@ int RNN::classify(const double p) const
 	return p >= 0.5 ? 1 : 0;
 }
 
-double RNN::loss(const std::vector<double>& pred, const std::vector<double>& label) const {
+double RNN::loss(const std::vector<double>& pred, const FeatureView& label) const {
 	double res = 0.0;
 	for(size_t i = 0; i < pred.size(); ++i){
 		double t = pred[i] - label[i];
@@ -79,47 +116,326 @@ double RNN::loss(const std::vector<double>& pred, const std::vector<double>& lab
 }
 
 std::vector<double> RNN::forward(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+	const FeatureListView& x, const std::vector<double>& w)
 {
+	if(seqMode)
+		return predict(x, w);
+	VectorNetwork::Buffer& buf = buffer(defaultWorkspace());
 	vector<double> res;
-	for(auto& line : x)
-		res = net.forward(line, w);
+	for(auto line : x)
+		res = net.forward(buf, line, w);
 	return res;
 }
 
-std::vector<double> RNN::backward(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+std::vector<double> RNN::backward(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
-	vector<double> res(net.lenFeatureLayer[0], 0.0);
-	for(auto& line : x){
-		auto temp = net.backward(line, w, y);
-		for(size_t i = 0; i < temp.size(); ++i)
-			res[i] += temp[i];
-	}
+	vector<double> res(w.size(), 0.0);
+	accumulateBackward(x, w, y, res, ph);
 	return res;
 }
 
-std::vector<double> RNN::gradLoss(const std::vector<double>& pred, const std::vector<double>& label)
+void RNN::gradLoss(const double* pred, const FeatureView& label, double* res)
 {
-	vector<double> res(pred.size());
-	for(size_t i = 0; i < pred.size(); ++i){
+	for(size_t i = 0; i < label.size(); ++i){
 		res[i] = pred[i] - label[i];
 	}
+}
+
+std::vector<double> RNN::gradient(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const
+{
+	vector<double> res(w.size(), 0.0);
+	accumulateGradient(defaultWorkspace(), x, w, y, res, ph);
 	return res;
 }
 
-std::vector<double> RNN::gradient(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const
+void RNN::accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph)
+{
+	// the network only keeps the intermediate results of the last line
+	accumulateGradient(x, w, y, grad, ph);
+}
+
+void RNN::accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
 {
-	vector<double> res(net.lenFeatureLayer[0], 0.0);
-	for(auto& line : x){
-		auto temp = net.gradient(line, w, y);
-		for(size_t i = 0; i < temp.size(); ++i)
-			res[i] += temp[i];
+	accumulateGradient(defaultWorkspace(), x, w, y, grad, ph);
+}
+
+double RNN::lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+	std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	return lossAndGradient(defaultWorkspace(), x, w, y, grad, pred, ph);
+}
+
+void RNN::batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	batchGradient(defaultWorkspace(), dps, n, w, grad, loss, ph);
+}
+
+Workspace* RNN::makeWorkspace() const
+{
+	Work* p = new Work();
+	p->buf = net.makeBuffer();
+	return p;
+}
+
+std::vector<double> RNN::predict(Workspace& ws, const FeatureListView& x, const std::vector<double>& w) const
+{
+	if(seqMode){
+		const FeatureListView* px = &x;
+		vector<double> res(fcNode);
+		sequenceBatch(static_cast<Work&>(ws), &px, nullptr, 1, w, nullptr, nullptr, res.data());
+		return res;
 	}
+	VectorNetwork::Buffer& buf = buffer(ws);
+	vector<double> res;
+	for(auto line : x)
+		res = net.predict(buf, line, w);
 	return res;
 }
 
+void RNN::accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph) const
+{
+	if(seqMode){
+		const FeatureListView* px = &x;
+		const FeatureView* py = &y;
+		sequenceBatch(static_cast<Work&>(ws), &px, &py, 1, w, grad.data(), nullptr, nullptr);
+		return;
+	}
+	VectorNetwork::Buffer& buf = buffer(ws);
+	for(auto line : x)
+		net.accumulateGradient(buf, line, w, y, grad.data());
+}
+
+double RNN::lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+	const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred, std::vector<double>* ph) const
+{
+	if(seqMode){
+		const FeatureListView* px = &x;
+		const FeatureView* py = &y;
+		Work& wk = static_cast<Work&>(ws);
+		double res;
+		sequenceBatch(wk, &px, &py, 1, w, grad.data(), &res, nullptr);
+		if(pred)
+			pred->assign(wk.out.begin(), wk.out.end());
+		return res;
+	}
+	accumulateGradient(ws, x, w, y, grad, ph);
+	// the loss is taken from the arena, the output is copied only when it is asked for
+	const double* out = buffer(ws).act.data() + net.featureOffset[net.nLayer - 1];
+	const size_t n = net.numFeatureLayer[net.nLayer - 1];
+	double res = 0.0;
+	for(size_t i = 0; i < n; ++i){
+		double t = out[i] - y[i];
+		res += t * t;
+	}
+	if(pred)
+		pred->assign(out, out + n);
+	return res;
+}
+
+void RNN::batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+	std::vector<double>& grad, double* loss, std::vector<double>* ph) const
+{
+	if(seqMode){
+		// longest first, so that the sequences active at a step are a prefix of the batch
+		Work& wk = static_cast<Work&>(ws);
+		wk.order.resize(n);
+		for(size_t i = 0; i < n; ++i)
+			wk.order[i] = i;
+		stable_sort(wk.order.begin(), wk.order.end(), [&](const size_t a, const size_t b){
+			return dps[a].x.size() > dps[b].x.size();
+		});
+		double bl[SEQ_BATCH];
+		for(size_t i0 = 0; i0 < n; i0 += SEQ_BATCH){
+			const size_t m = min(SEQ_BATCH, n - i0);
+			wk.xs.resize(m);
+			wk.ys.resize(m);
+			for(size_t i = 0; i < m; ++i){
+				wk.xs[i] = &dps[wk.order[i0 + i]].x;
+				wk.ys[i] = &dps[wk.order[i0 + i]].y;
+			}
+			sequenceBatch(wk, wk.xs.data(), wk.ys.data(), m, w, grad.data(), bl, nullptr);
+			if(loss)
+				for(size_t i = 0; i < m; ++i)
+					loss[wk.order[i0 + i]] = bl[i];
+		}
+		return;
+	}
+	for(size_t i = 0; i < n; ++i){
+		if(loss)
+			loss[i] = lossAndGradient(ws, dps[i].x, w, dps[i].y, grad);
+		else
+			accumulateGradient(ws, dps[i].x, w, dps[i].y, grad);
+	}
+}
+
+VectorNetwork::Buffer& RNN::buffer(Workspace& ws) const
+{
+	return static_cast<Work&>(ws).buf;
+}
+
+void RNN::sequenceBatch(Work& wk, const FeatureListView* const* xs, const FeatureView* const* ys, const size_t m,
+	const std::vector<double>& w, double* grad, double* loss, double* pred) const
+{
+	const size_t L = seqLayers.size();
+	const size_t T = xs[0]->size();
+	// the sequences are aligned at the last step, sequence s starts at step T - len(s)
+	auto active = [&](const size_t t){
+		size_t a = 0;
+		while(a < m && xs[a]->size() >= T - t)
+			++a;
+		return a;
+	};
+	const int nx = seqLayers[0].n;
+	auto gather = [&](const size_t t, const size_t a){
+		wk.x.resize(m * nx);
+		for(size_t s = 0; s < a; ++s)
+			(*xs[s])[t - (T - xs[s]->size())].copyTo(wk.x.data() + s * nx);
+	};
+	// the backward pass needs the outputs of the last <truncation> steps and the one before them
+	size_t nslot = 2;
+	if(grad)
+		nslot = truncation != 0 ? truncation + 1 : T;
+	nslot = max<size_t>(1, min(nslot, T));
+	wk.h.resize(L);
+	for(size_t l = 0; l < L; ++l)
+		wk.h[l].resize(nslot * m * seqLayers[l].width());
+	auto slot = [&](const size_t l, const size_t t){
+		return wk.h[l].data() + (t % nslot) * m * seqLayers[l].width();
+	};
+	if(T == 0) // only empty sequences
+		fill(wk.h[L - 1].begin(), wk.h[L - 1].end(), 0.0);
+
+	// forward: H_t = act(X_t * W^T + H_{t-1} * U^T + b) for each node, on the active rows
+	for(size_t t = 0; t < T; ++t){
+		const size_t a = active(t);
+		gather(t, a);
+		const double* in = wk.x.data();
+		int ldin = nx;
+		for(size_t l = 0; l < L; ++l){
+			const SeqLayer& ly = seqLayers[l];
+			const int n = ly.n, k = ly.k, wd = ly.width();
+			const size_t stride = n + k + 1;
+			double* h = slot(l, t);
+			const double* hp = t > 0 ? slot(l, t - 1) : nullptr;
+			fill(h, h + m * wd, 0.0);
+			for(int j = 0; j < ly.nnode; ++j){
+				const double* wj = w.data() + ly.off + j * k * stride;
+				double* hj = h + j * k;
+				for(size_t s = 0; s < a; ++s)
+					for(int i = 0; i < k; ++i)
+						hj[s * wd + i] = wj[i * stride + n + k];
+				gemm_nt(a, k, n, in, ldin, wj, stride, hj, wd);
+				if(hp)
+					gemm_nt(a, k, k, hp + j * k, wd, wj + n, stride, hj, wd);
+			}
+			if(ly.tanh)
+				tanh_array(h, h, a * wd);
+			else
+				sigmoid_array(h, h, a * wd);
+			in = h;
+			ldin = wd;
+		}
+	}
+	// FC layer on the last step
+	const int wd = seqLayers.back().width();
+	const int F = fcNode;
+	const size_t fs = wd + 1;
+	const double* hl = slot(L - 1, T > 0 ? T - 1 : 0);
+	wk.out.resize(m * F);
+	for(size_t s = 0; s < m; ++s)
+		for(int f = 0; f < F; ++f)
+			wk.out[s * F + f] = w[fcOff + f * fs + wd];
+	gemm_nt(m, F, wd, hl, wd, w.data() + fcOff, fs, wk.out.data(), F);
+	sigmoid_array(wk.out.data(), wk.out.data(), m * F);
+	if(pred)
+		copy(wk.out.begin(), wk.out.end(), pred);
+	if(ys == nullptr)
+		return;
+	// loss, and its gradient through the sigmoid of the FC layer
+	wk.dout.resize(m * F);
+	for(size_t s = 0; s < m; ++s){
+		double res = 0.0;
+		for(int f = 0; f < F; ++f){
+			const double o = wk.out[s * F + f];
+			const double e = o - (*ys[s])[f];
+			res += e * e;
+			wk.dout[s * F + f] = e * o * (1.0 - o);
+		}
+		if(loss)
+			loss[s] = res;
+	}
+	if(grad == nullptr)
+		return;
+	gemm_tn(F, wd, m, wk.dout.data(), F, hl, wd, grad + fcOff, fs);
+	for(size_t s = 0; s < m; ++s)
+		for(int f = 0; f < F; ++f)
+			grad[fcOff + f * fs + wd] += wk.dout[s * F + f];
+	wk.dcur.resize(L);
+	wk.dprev.resize(L);
+	for(size_t l = 0; l < L; ++l){
+		wk.dcur[l].assign(m * seqLayers[l].width(), 0.0);
+		wk.dprev[l].assign(m * seqLayers[l].width(), 0.0);
+	}
+	gemm_nn(m, wd, F, wk.dout.data(), F, w.data() + fcOff, fs, wk.dcur[L - 1].data(), wd);
+
+	// backward through time, down to step <tmin>. dcur holds dL/dH_t, dprev collects dL/dH_{t-1}
+	const size_t tmin = truncation != 0 && T > truncation ? T - truncation : 0;
+	for(size_t t = T; t-- > tmin; ){
+		const size_t a = active(t);
+		for(size_t l = L; l-- > 0; ){
+			const SeqLayer& ly = seqLayers[l];
+			const int n = ly.n, k = ly.k, wd = ly.width();
+			const size_t stride = n + k + 1;
+			const double* h = slot(l, t);
+			const double* hp = t > 0 ? slot(l, t - 1) : nullptr;
+			// G = dL/dH .* act'(H)
+			double* g = wk.dcur[l].data();
+			if(ly.tanh){
+				for(size_t i = 0; i < a * wd; ++i)
+					g[i] *= 1.0 - h[i] * h[i];
+			} else{
+				for(size_t i = 0; i < a * wd; ++i)
+					g[i] *= h[i] * (1.0 - h[i]);
+			}
+			const double* in;
+			int ldin;
+			if(l == 0){
+				gather(t, a);
+				in = wk.x.data();
+				ldin = nx;
+			} else{
+				in = slot(l - 1, t);
+				ldin = seqLayers[l - 1].width();
+			}
+			for(int j = 0; j < ly.nnode; ++j){
+				const double* wj = w.data() + ly.off + j * k * stride;
+				double* gw = grad + ly.off + j * k * stride;
+				const double* gj = g + j * k;
+				gemm_tn(k, n, a, gj, wd, in, ldin, gw, stride); // dW += G^T X
+				if(hp)
+					gemm_tn(k, k, a, gj, wd, hp + j * k, wd, gw + n, stride); // dU += G^T H_{t-1}
+				for(size_t s = 0; s < a; ++s)
+					for(int i = 0; i < k; ++i)
+						gw[i * stride + n + k] += gj[s * wd + i];
+				if(l > 0) // to the layer below at this step
+					gemm_nn(a, n, k, gj, wd, wj, stride, wk.dcur[l - 1].data(), n);
+				if(hp && t > tmin) // to the previous step
+					gemm_nn(a, k, k, gj, wd, wj + n, stride, wk.dprev[l].data() + j * k, wd);
+			}
+		}
+		for(size_t l = 0; l < L; ++l){
+			swap(wk.dcur[l], wk.dprev[l]);
+			fill(wk.dprev[l].begin(), wk.dprev[l].end(), 0.0);
+		}
+	}
+}
+
 std::string RNN::preprocessParam(const std::string & param)
 {
 	string srShape = R"((\d+(?:[\*x]\d+)*))"; // v1[*v2[*v3[*v4]]], "*" can also be "x"
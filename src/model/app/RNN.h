@@ -5,25 +5,82 @@
 class RNN
 	: public Kernel
 {
-	mutable VectorNetwork net;
+	VectorNetwork net;
+
+	// sequence mode, set by the parameter suffix "-seq[:<t>]" (i.e. 4-3r3-1f-seq:10).
+	// the lines of x are the time steps of one sequence: the recurrent layers carry their output
+	// from one line to the next, and the FC layer maps the output of the last line to y.
+	// a batch is packed time-major, longest sequence first, and aligned at the last step,
+	// so each step is a matrix product over the sequences active at that step.
+	// the gradient is backpropagated through the last <t> steps only (truncated BPTT, 0: all).
+	// it needs the layers: input, recurrent (one node per layer except the last one), FC
+	bool seqMode = false;
+	size_t truncation = 0;
+	struct SeqLayer {
+		size_t off; // weight offset of the first node, each one is a k x (n+k+1) block
+		int n, k, nnode;
+		bool tanh; // sigmoid otherwise
+		int width() const { return nnode * k; }
+	};
+	std::vector<SeqLayer> seqLayers;
+	size_t fcOff;
+	int fcNode;
+
+	struct Work : public Workspace {
+		VectorNetwork::Buffer buf;
+		// sequence mode: per layer the outputs of the kept steps (one B x width matrix each)
+		// and the loss gradients of the current and the previous step
+		std::vector<std::vector<double>> h, dcur, dprev;
+		std::vector<double> x, out, dout;
+		std::vector<const FeatureListView*> xs;
+		std::vector<const FeatureView*> ys;
+		std::vector<size_t> order;
+	};
+	VectorNetwork::Buffer& buffer(Workspace& ws) const;
+	void initSequenceMode();
+	// forward the sequences xs[0..m) (sorted by length, longest first) and write the outputs into
+	// <pred> (m x fcNode) if it is given. with <ys>, add the gradient into <grad> and the losses into <loss>
+	void sequenceBatch(Work& wk, const FeatureListView* const* xs, const FeatureView* const* ys, const size_t m,
+		const std::vector<double>& w, double* grad, double* loss, double* pred) const;
 public:
 	void init(const std::string& param);
 	bool checkData(const size_t nx, const size_t ny);
 	std::string name() const;
 	int lengthParameter() const;
 
-	std::vector<double> predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w) const;
+	std::vector<double> predict(const FeatureListView& x, const std::vector<double>& w) const;
 	int classify(const double p) const;
-	double loss(const std::vector<double>& pred, const std::vector<double>& label) const;
+	double loss(const std::vector<double>& pred, const FeatureView& label) const;
+
+	std::vector<double> forward(const FeatureListView& x, const std::vector<double>& w);
+	std::vector<double> backward(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr);
 
-	std::vector<double> forward(const std::vector<std::vector<double>>& x, const std::vector<double>& w);
-	std::vector<double> backward(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr);
+	// res[i] = pred[i] - label[i]
+	static void gradLoss(const double* pred, const FeatureView& label, double* res);
 
-	static std::vector<double> gradLoss(const std::vector<double>& pred, const std::vector<double>& label);
+	std::vector<double> gradient(const FeatureListView& x,
+		const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph = nullptr) const;
+	void accumulateBackward(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr);
+	void accumulateGradient(const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	double lossAndGradient(const FeatureListView& x, const std::vector<double>& w, const FeatureView& y,
+		std::vector<double>& grad, std::vector<double>* pred = nullptr, std::vector<double>* ph = nullptr) const;
+	void batchGradient(const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
 
-	std::vector<double> gradient(const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph = nullptr) const;
+	// the network is not changed by an evaluation, all the buffers are in the workspace
+	Workspace* makeWorkspace() const;
+	std::vector<double> predict(Workspace& ws, const FeatureListView& x, const std::vector<double>& w) const;
+	void accumulateGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* ph = nullptr) const;
+	// the output of the forward pass is still in the buffer after the gradient
+	double lossAndGradient(Workspace& ws, const FeatureListView& x, const std::vector<double>& w,
+		const FeatureView& y, std::vector<double>& grad, std::vector<double>* pred = nullptr,
+		std::vector<double>* ph = nullptr) const;
+	void batchGradient(Workspace& ws, const DataPointView* dps, const size_t n, const std::vector<double>& w,
+		std::vector<double>& grad, double* loss = nullptr, std::vector<double>* ph = nullptr) const;
 
 	// make param into general format for network
 	std::string preprocessParam(const std::string& param);
@@ -23,7 +23,7 @@ int TopicModel::lengthParameter() const
 }
 
 std::vector<double> TopicModel::predict(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w) const
+	const FeatureListView& x, const std::vector<double>& w) const
 {
 	return std::vector<double>();
 }
@@ -33,25 +33,25 @@ int TopicModel::classify(const double p) const
 	return p >= 0.5 ? 1 : 0;
 }
 
-double TopicModel::loss(const std::vector<double>& pred, const std::vector<double>& label) const
+double TopicModel::loss(const std::vector<double>& pred, const FeatureView& label) const
 {
 	return 0.0;
 }
 
 std::vector<double> TopicModel::forward(
-	const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+	const FeatureListView& x, const std::vector<double>& w)
 {
 	return std::vector<double>();
 }
 
-std::vector<double> TopicModel::backward(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph)
+std::vector<double> TopicModel::backward(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph)
 {
 	return std::vector<double>();
 }
 
-std::vector<double> TopicModel::gradient(const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const std::vector<double>& y, std::vector<double>* ph) const
+std::vector<double> TopicModel::gradient(const FeatureListView& x,
+	const std::vector<double>& w, const FeatureView& y, std::vector<double>* ph) const
 {
 	return std::vector<double>();
 }
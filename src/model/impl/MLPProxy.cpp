@@ -53,6 +53,12 @@ MLPProxyLayer MLPProxy::getLayerProxy(const int l) const
 		nWeightLayerOffset[l], nNodeLayer[l] + 1, nNodeLayer[l + 1], w);
 }
 
+MLPProxyLayer MLPProxy::getLayerProxy(const int l, const std::vector<double>* w) const
+{
+	return MLPProxyLayer(
+		nWeightLayerOffset[l], nNodeLayer[l] + 1, nNodeLayer[l + 1], w);
+}
+
 MLPProxyLayer MLPProxy::operator[](const int l) const
 {
 	return getLayerProxy(l);
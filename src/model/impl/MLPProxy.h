@@ -13,6 +13,8 @@ struct MLPProxy {
 	double get(const int layer, const int from, const int to) const;
 
 	MLPProxyLayer getLayerProxy(const int l) const;
+	// bound to <w> instead of the one of bind(), for the const users of a shared proxy
+	MLPProxyLayer getLayerProxy(const int l, const std::vector<double>* w) const;
 	MLPProxyLayer operator[](const int l) const;
 
 	int nLayer;
@@ -1,6 +1,7 @@
 #include "NodeBase.h"
 #include "NodeImpl.h"
 #include "math/activation_func.h"
+#include "math/simd.h"
 
 using namespace std;
 
@@ -28,9 +29,14 @@ std::vector<int> NodeBase::outShape(const std::vector<int>& inShape) const
 	return inShape;
 }
 
-void NodeBase::reset()
+void NodeBase::setInputShape(const std::vector<int>& inShape)
 {
-	// empty by default
+	nin = 1;
+	for(auto& v : inShape)
+		nin *= v;
+	nout = 1;
+	for(auto& v : outShape(inShape))
+		nout *= v;
 }
 
 // ---- Fully-Connected Node ----
@@ -46,40 +52,26 @@ std::vector<int> FCNode::outShape(const std::vector<int>& inShape) const
 	return { 1 };
 }
 
-double FCNode::predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w)
+void FCNode::setInputShape(const std::vector<int>& inShape)
 {
-	const size_t n1 = x.size();
-	const size_t n2 = x.front().size();
-	double res = 0.0;
-	size_t p = off;
-	for(size_t i = 0; i < n1; ++i) {
-		for(size_t j = 0; j < n2; ++j)
-			res += x[i][j] * w[p++];
-	}
-	return sigmoid(res + w[p]);
+	// all the k features, not one of them
+	nin = shape[0] * shape[1];
+	nout = 1;
 }
 
-std::vector<std::vector<double>> FCNode::gradient(
-	std::vector<double>& grad, const std::vector<std::vector<double>>& x,
-	const std::vector<double>& w, const double& y, const double& pre)
+void FCNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	const size_t n1 = x.size();
-	const size_t n2 = x.front().size();
-	//assert(y.size() == 1 && pre.size() == 1);
-	//const double f = pre[0] * y[0];
-	const double d = sigmoid_derivative(0.0, y);
-	const double f = pre * d;
-	std::vector<std::vector<double>> pg(n1, vector<double>(n2));
-	size_t p = off;
-	for(size_t i = 0; i < n1; ++i) {
-		for(size_t j = 0; j < n2; ++j) {
-			grad[p] = x[i][j] * f; // pre * dy/dw
-			pg[i][j] = w[p] * f; // pre * dy/dx
-			++p;
-		}
-	}
-	grad[p] += f; // the constant offset
-	return pg;
+	y[0] = sigmoid(simd_dot(x, w + off, nin) + w[off + nin]);
+}
+
+void FCNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
+{
+	const double d = sigmoid_derivative(0.0, y[0]);
+	const double f = pre[0] * d;
+	simd_axpy(f, x, grad + off, nin); // pre * dy/dw
+	simd_axpy(f, w + off, dx, nin); // pre * dy/dx
+	grad[off + nin] += f; // the constant offset
 }
 
 NodeBase* generateNode(NodeType type, const size_t offset, const std::vector<int>& shape){
@@ -25,48 +25,52 @@ struct NodeBase {
 	const size_t off;
 	const std::vector<int> shape;
 	size_t nw;
+	size_t nin = 0, nout = 0; // # of input and output values, set by setInputShape()
+	size_t nst = 0; // # of state values kept between calls (i.e. recurrent nodes)
+	// the state only lives from predict() to gradient() of the same input (i.e. the winners of
+	// a pooling node), so each application of the node gets its own
+	bool callState = false;
 	// offset: the offset of weights in the flatten <w>.
 	// shape: the structure parameter of the node (sometimes: shape of input for 1 output entry)
 	NodeBase(const size_t offset, const std::vector<int>& shape);
+	// nodes are deleted through a NodeBase*
+	virtual ~NodeBase() = default;
 	size_t nweight() const;
 
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual void reset(); // reset internal state
+	// fix the input shape, which sets <nin> and <nout>. call it before predict() and gradient()
+	virtual void setInputShape(const std::vector<int>& inShape);
 
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w) = 0;
-	// input: x, w, y, product of previous partial gradients.
-	// pre-condition: predict(x,w) == y && y.size() == pre.size()
+	// x: <nin> values, y: <nout> values. <w> is the flatten weight vector.
+	// st: <nst> state values, all zeros at the beginning of a sequence.
+	// all buffers are owned by the caller, so a node can be used by several threads
+	// and does not allocate on these two calls
+	virtual void predict(const double* x, const double* w, double* y, double* st) const = 0;
+	// input: x, w, y, product of previous partial gradients (pre, <nout> values).
+	// pre-condition: predict(x,w) == y
 	// action 1: update corresponding entries of global <grad> vector (add: pre * dy/dw)
-	// action 2: output product of all partial gradient (set to: pre * dy/dx)
-	//           o[i] = pre * dy/dx[i] = sum_j (pre[j] * dy[j]/dx[i])
-	// post-condition: result.size() == x.size() && nw == # of entries touched in <grad>
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre) = 0;
+	// action 2: add product of all partial gradient into <dx> (<nin> values)
+	//           dx[i] += pre * dy/dx[i] = sum_j (pre[j] * dy[j]/dx[i])
+	// post-condition: nw == # of entries touched in <grad>
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const = 0;
 };
 
 // merge all <k> features (n-dimension) into one value, activate with sigmoid
 // not a typical node.
 // k*n => 1
-// vector: y_{1*1} = sum ( W_{k*n} * x_{k*n} )
-// individual: y = max_{i:0~k,j:0~n} ( W[i,j]*x[i,j] )
+// vector: y_{1*1} = sigmoid( sum ( W_{k*n} * x_{k*n} ) + b )
+// individual: y = sigmoid( sum_{i:0~k,j:0~n} ( W[i,j]*x[i,j] ) + b )
 struct FCNode
 	: public NodeBase
 {
 	FCNode(const size_t offset, const std::vector<int>& shape); // shape = {k,n}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	// dummy
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w) {
-		return {};
-	}
-	// dummmy
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre) {
-		return {};
-	}
-	// intput are k 1D-vectors. output is a scalar.
-	double predict(const std::vector<std::vector<double>>& x, const std::vector<double>& w);
-	std::vector<std::vector<double>> gradient(std::vector<double>& grad, const std::vector<std::vector<double>>& x,
-		const std::vector<double>& w, const double& y, const double& pre);
+	// input are k features stored one after another
+	virtual void setInputShape(const std::vector<int>& inShape);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 
@@ -1,8 +1,10 @@
 #include "NodeImpl.h"
 #include "math/activation_func.h"
+#include "math/simd.h"
 #include <cassert>
 #include <algorithm>
 #include <limits>
+#include <functional>
 //#include <numeric>
 
 using namespace std;
@@ -15,15 +17,16 @@ InputNode::InputNode(const size_t offset, const std::vector<int>& shape)
 	nw = 0;
 }
 
-std::vector<double> InputNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void InputNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	return x;
+	copy(x, x + nin, y);
 }
 
-std::vector<double> InputNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void InputNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	return std::vector<double>();
+	for(size_t i = 0; i < nin; ++i)
+		dx[i] += pre[i];
 }
 
 
@@ -43,40 +46,30 @@ std::vector<int> WeightedSumNode::outShape(const std::vector<int>& inShape) cons
 	return { k };
 }
 
-std::vector<double> WeightedSumNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void WeightedSumNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	assert(x.size() == n);
-	vector<double> res(k);
+	assert(nin == n);
 	size_t idx = off;
 	for(int i = 0; i < k;  ++i){
-		// idx = off + i * n;
-		double v = 0.0;
-		for(int j = 0; j < n; ++j)
-			v += w[idx++] * x[j];
-		v += w[idx++];
-		res[i] = v;
+		// idx = off + i * (n + 1)
+		y[i] = simd_dot(x, w + idx, n) + w[idx + n];
+		idx += n + 1;
 	}
-	return res;
 }
 
-std::vector<double> WeightedSumNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void WeightedSumNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	assert(x.size() == n);
-	assert(y.size() == k);
-	vector<double> res(n);
+	assert(nin == n);
 	size_t idx = off;
 	for(int i = 0; i < k; i++){
-		// idx = off + i * n;
+		// idx = off + i * (n + 1)
 		const double factor = pre[i];
-		for(int j = 0; j < n; ++j){
-			grad[idx] += factor * x[j]; // dy/dw
-			res[j] += factor * w[idx]; // dy/dx
-			++idx;
-		}
-		grad[idx++] += factor * 1; // dy/dw
+		simd_axpy(factor, x, grad + idx, n); // dy/dw
+		simd_axpy(factor, w + idx, dx, n); // dy/dx
+		grad[idx + n] += factor * 1; // dy/dw
+		idx += n + 1;
 	}
-	return res;
 }
 
 // ---- Convolutional Node: 1D ----
@@ -94,49 +87,67 @@ std::vector<int> ConvNode1D::outShape(const std::vector<int>& inShape) const
 	return { inShape[0] - k + 1 };
 }
 
-std::vector<double> ConvNode1D::predict(const std::vector<double>& x, const std::vector<double>& w)
+void ConvNode1D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	const size_t ny = x.size() - k + 1;
-	std::vector<double> res(ny);
-	for (size_t i = 0; i < ny; ++i) {
-		double t = w[off + k];
-		for (size_t j = 0; j < k; ++j)
-			t += x[i + j] * w[off + j];
-		res[i] = t;
-	}
-	return res;
+	const size_t ny = nout;
+	fill(y, y + ny, w[off + k]);
+	// one axpy over the whole output for each tap
+	for(int j = 0; j < k; ++j)
+		simd_axpy(w[off + j], x + j, y, ny);
 }
 
-std::vector<double> ConvNode1D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void ConvNode1D::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	assert(x.size() == y.size() + k - 1);
-	assert(y.size() == pre.size());
-	const size_t nx = x.size();
-	const size_t ny = y.size();
+	assert(nin == nout + k - 1);
+	const size_t ny = nout;
 	// dy/dw
-	for (size_t i = 0; i < k; ++i) {
-		double t = 0.0;
-		for (size_t j = 0; j < ny; ++j) {
-			t += pre[j] * x[i + j];
-		}
-		grad[off + i] += t;
-	}
-	for(size_t j = 0; j < ny; ++j) {
-		grad[off + k] += pre[j];
-	}
+	for(int j = 0; j < k; ++j)
+		grad[off + j] += simd_dot(pre, x + j, ny);
+	for(size_t i = 0; i < ny; ++i)
+		grad[off + k] += pre[i];
 	// dy/dx
-	std::vector<double> res(nx);
-	for (size_t i = 0; i < nx; ++i) {
+	for(int j = 0; j < k; ++j)
+		simd_axpy(w[off + j], pre, dx + j, ny);
+}
+
+// ---- Convolution kernels ----
+// valid 2D convolution on row-major planes, <ldx> values per row of x.
+// the loops run over whole rows, which are contiguous in x, y and the gradients,
+// so that each step is one SIMD axpy or dot of length <om>.
+
+// y[i][j] += sum_{p1,p2} w[p1][p2] * x[i+p1][j+p2]
+static void convPlaneForward(const double* x, const int ldx, const double* w, const int k1, const int k2,
+	double* y, const int on, const int om)
+{
+	for(int p1 = 0; p1 < k1; ++p1) for(int p2 = 0; p2 < k2; ++p2){
+		const double f = w[p1 * k2 + p2];
+		for(int i = 0; i < on; ++i)
+			simd_axpy(f, x + (i + p1) * ldx + p2, y + i * om, om);
+	}
+}
+
+// gw[p1][p2] += sum_{i,j} pre[i][j] * x[i+p1][j+p2]
+static void convPlaneWeightGrad(const double* x, const int ldx, const double* pre, const int on, const int om,
+	const int k1, const int k2, double* gw)
+{
+	for(int p1 = 0; p1 < k1; ++p1) for(int p2 = 0; p2 < k2; ++p2){
 		double t = 0.0;
-		// cut the first (i >= j)
-		// cut the last (i < ny ? 0 : i - ny + 1)
-		for (size_t j = (i < ny ? 0 : i - ny + 1); j < k && i >= j; ++j) {
-			t += pre[i - j] * w[off + j];
-		}
-		res[i] = t;
+		for(int i = 0; i < on; ++i)
+			t += simd_dot(pre + i * om, x + (i + p1) * ldx + p2, om);
+		gw[p1 * k2 + p2] += t;
+	}
+}
+
+// dx[i+p1][j+p2] += pre[i][j] * w[p1][p2]
+static void convPlaneInputGrad(const double* pre, const int on, const int om, const double* w,
+	const int k1, const int k2, double* dx, const int ldx)
+{
+	for(int p1 = 0; p1 < k1; ++p1) for(int p2 = 0; p2 < k2; ++p2){
+		const double f = w[p1 * k2 + p2];
+		for(int i = 0; i < on; ++i)
+			simd_axpy(f, pre + i * om, dx + (i + p1) * ldx + p2, om);
 	}
-	return res;
 }
 
 // ---- Convolutional Node: 2D ----
@@ -155,64 +166,24 @@ std::vector<int> ConvNode2D::outShape(const std::vector<int>& inShape) const
 	return { on, om };
 }
 
-std::vector<double> ConvNode2D::predict(const std::vector<double>& x, const std::vector<double>& w)
+void ConvNode2D::predict(const double* x, const double* w, double* y, double* st) const
 {
 	const int sizeW = k1 * k2;
-	std::vector<double> res(on * om);
-	int py = 0;
-	for(int i = 0; i < on; ++i) for(int j = 0; j < om; ++j){
-		double t = w[off + sizeW];
-		int pw = off;
-		for(int p1 = 0; p1 < k1; ++p1){
-			int px = (i + p1) * m + j;
-			for(int p2 = 0; p2 < k2; ++p2){
-				t += w[pw++] * x[px++];
-			}
-		}
-		res[py] = t;
-		++py;
-	}
-	return res;
+	fill(y, y + on * om, w[off + sizeW]);
+	convPlaneForward(x, m, w + off, k1, k2, y, on, om);
 }
 
-std::vector<double> ConvNode2D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void ConvNode2D::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
 	const int sizeY = on * om;
-	assert(y.size() == sizeY);
+	const int sizeW = k1 * k2;
 	// dy/dw
-	int py = 0;
-	for(int i = 0; i < on; ++i) for(int j = 0; j < om; ++j){
-		double f = pre[py++];
-		int pw = off;
-		for(int p1 = 0; p1 < k1; ++p1){
-			int px = (i + p1)*m + j;
-			for(int p2 = 0; p2 < k2; ++p2){
-				grad[pw++] += f * x[px++];
-			}
-		}
-		grad[pw] += f;
-	}
+	convPlaneWeightGrad(x, m, pre, on, om, k1, k2, grad + off);
+	for(int py = 0; py < sizeY; ++py)
+		grad[off + sizeW] += pre[py];
 	// dy/dx
-	std::vector<double> res(n * m);
-	int px = 0;
-	for(int i = 0; i < n; ++i) for(int j = 0; j < m; ++j){
-		// lowI/J and upI/J are the coordinates in y
-		int lowi = max(0, i - k1 + 1), upi = min(on - 1, i);
-		int lowj = max(0, j - k2 + 1), upj = min(om - 1, j);
-		for(int pi = lowi; pi <= upi; ++pi){
-			for(int pj = lowj; pj <= upj; ++pj){
-				int py = pi * om + pj;
-				const double f = pre[py];
-				int wi = i - pi;
-				int wj = j - pj;
-				int pw = wi * k2 + wj;
-				res[px] += f * w[pw];
-			}
-		}
-		++px;
-	}
-	return res;
+	convPlaneInputGrad(pre, on, om, w + off, k1, k2, dx, m);
 }
 
 // ---- Convolutional Node: 3D ----
@@ -232,75 +203,34 @@ std::vector<int> ConvNode3D::outShape(const std::vector<int>& inShape) const
 	return { on, om, op };
 }
 
-std::vector<double> ConvNode3D::predict(const std::vector<double>& x, const std::vector<double>& w)
+// a 3D convolution is a sum of 2D ones: output plane i gets input plane i+p1 with kernel slice p1
+void ConvNode3D::predict(const double* x, const double* w, double* y, double* st) const
 {
 	const int sizeW = k1 * k2 * k3;
-	std::vector<double> res(on * om);
-	int py = 0;
-	for(int i = 0; i < on; ++i) for(int j = 0; j < om; ++j) for(int k = 0; k < op; ++k)
-	{
-		double t = w[off + sizeW];
-		int pw = off;
-		for(int p1 = 0; p1 < k1; ++p1){
-			for(int p2 = 0; p2 < k2; ++p2){
-				int px = ((i + p1) * m + j)*p + k;
-				for(int p3 = 0; p3 < k3; ++p3){
-					t += w[pw++] * x[px++];
-				}
-			}
-		}
-		res[py] = t;
-		++py;
+	fill(y, y + on * om * op, w[off + sizeW]);
+	for(int i = 0; i < on; ++i) for(int p1 = 0; p1 < k1; ++p1){
+		convPlaneForward(x + (i + p1) * m * p, p, w + off + p1 * k2 * k3, k2, k3,
+			y + i * om * op, om, op);
 	}
-	return res;
 }
 
-std::vector<double> ConvNode3D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void ConvNode3D::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	const int sizeY = on * om;
-	assert(y.size() == sizeY);
+	const int sizeY = on * om * op;
+	const int sizeW = k1 * k2 * k3;
 	// dy/dw
-	int py = 0;
-	for(int i = 0; i < on; ++i) for(int j = 0; j < om; ++j) for(int k = 0; j < op; ++k)
-	{
-		double f = pre[py++];
-		int pw = off;
-		for(int p1 = 0; p1 < k1; ++p1){
-			for(int p2 = 0; p2 < k2; ++p2){
-				int px = ((i + p1)*m + j)*p + k;
-				for(int p3 = 0; p3 < k3; ++p3){
-					grad[pw++] += f * x[px++];
-				}
-			}
-		}
-		grad[pw] += f;
+	for(int i = 0; i < on; ++i) for(int p1 = 0; p1 < k1; ++p1){
+		convPlaneWeightGrad(x + (i + p1) * m * p, p, pre + i * om * op, om, op,
+			k2, k3, grad + off + p1 * k2 * k3);
 	}
+	for(int py = 0; py < sizeY; ++py)
+		grad[off + sizeW] += pre[py];
 	// dy/dx
-	std::vector<double> res(n * m);
-	int px = 0;
-	for(int i = 0; i < n; ++i) for(int j = 0; j < m; ++j) for(int k = 0; j < op; ++k)
-	{
-		// lowI/J and upI/J are the coordinates in y
-		int lowi = max(0, i - k1 + 1), upi = min(on - 1, i);
-		int lowj = max(0, j - k2 + 1), upj = min(om - 1, j);
-		int lowk = max(0, k - k3 + 1), upk = min(op - 1, k);
-		for(int pi = lowi; pi <= upi; ++pi){
-			for(int pj = lowj; pj <= upj; ++pj){
-				for(int pk = lowk; pk <= upk; ++pk){
-					int py = (pi * om + pj) * op + pk;
-					const double f = pre[py];
-					int wi = i - pi;
-					int wj = j - pj;
-					int wk = k - pk;
-					int pw = (wi * k2 + wj) * k3 + wk;
-					res[px] += f * w[pw];
-				}
-			}
-		}
-		++px;
+	for(int i = 0; i < on; ++i) for(int p1 = 0; p1 < k1; ++p1){
+		convPlaneInputGrad(pre + i * om * op, om, op, w + off + p1 * k2 * k3, k2, k3,
+			dx + (i + p1) * m * p, p);
 	}
-	return res;
 }
 
 // ---- Recurrent Node Base ----
@@ -308,9 +238,8 @@ std::vector<double> ConvNode3D::gradient(std::vector<double>& grad, const std::v
 RecurrentNodeBase::RecurrentNodeBase(const size_t offset, const std::vector<int>& shape)
 	: NodeBase(offset, shape), n(shape[0]), k(shape[1])
 {
-	last_pred.assign(n, 0.0);
-	last_grad.assign(n, 0.0);
 	nw = (n + k + 1)*k;
+	nst = 3 * k; // last_pred, last_grad, buffer
 }
 
 std::vector<int> RecurrentNodeBase::outShape(const std::vector<int>& inShape) const
@@ -318,60 +247,41 @@ std::vector<int> RecurrentNodeBase::outShape(const std::vector<int>& inShape) co
 	return { k };
 }
 
-void RecurrentNodeBase::reset()
+void RecurrentNodeBase::predictCalcOnly(const double* x, const double* w, double* y, const double* st) const
 {
-	last_pred.assign(n, 0.0);
-	last_grad.assign(n, 0.0);
-}
-
-std::vector<double> RecurrentNodeBase::predictCalcOnly(const std::vector<double>& x, const std::vector<double>& w)
-{
-	std::vector<double> res(k);
+	const double* last_pred = st;
 	// element by element (n + k + 1)
 	size_t p = off;
 	for(int i = 0; i < k; ++i){
-		double a = 0.0;
-		for(int j = 0; j < n; ++j){ // W*x
-			a += x[j] * w[p++];
-		}
-		double b = 0.0;
-		for(int j = 0; j < k; ++j){ // U*y
-			b += last_pred[j] * w[p++];
-		}
-		res[i] = a + b + w[p++];
+		double a = simd_dot(x, w + p, n); // W*x
+		double b = simd_dot(last_pred, w + p + n, k); // U*y
+		y[i] = a + b + w[p + n + k];
+		p += n + k + 1;
 	}
-	return res;
 }
 
-std::vector<double> RecurrentNodeBase::predict(const std::vector<double>& x, const std::vector<double>& w)
+void RecurrentNodeBase::predict(const double* x, const double* w, double* y, double* st) const
 {
-	auto res = predict(x, w);
-	last_pred = res;
-	return res;
+	predictCalcOnly(x, w, y, st);
+	copy(y, y + k, st); // last_pred
 }
 
-std::vector<double> RecurrentNodeBase::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void RecurrentNodeBase::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	assert(x.size() == n);
-	assert(y.size() == k);
-	std::vector<double> res(n); // dy/dx
+	assert(nin == n);
+	double* last_grad = st + k;
 	size_t p = off;
 	for(int i = 0; i < k; ++i){
-		double f = pre[i];
-		for(int j = 0; j < n; ++j){ // W*x
-			grad[p] += f * x[j]; // dy/dw
-			res[j] += f * w[p]; // dy/dx
-			++p;
-		}
-		for(int j = 0; j < k; ++j){ // U*y
-			grad[p++] += f * last_grad[j]; // dy/dw
-		}
-		grad[p++] += f; // b, dy/dw
+		const double f = pre[i];
+		simd_axpy(f, x, grad + p, n); // W*x, dy/dw
+		simd_axpy(f, w + p, dx, n); // W*x, dy/dx
+		simd_axpy(f, last_grad, grad + p + n, k); // U*y, dy/dw
+		grad[p + n + k] += f; // b, dy/dw
+		p += n + k + 1;
 	}
 	// store current output for next call
-	last_grad = y;
-	return res;
+	copy(y, y + k, last_grad);
 }
 
 // ---- Recurrent Node Sigmoid ----
@@ -380,22 +290,20 @@ RecurrentSigmoidNode::RecurrentSigmoidNode(const size_t offset, const std::vecto
 	: RecurrentNodeBase(offset, shape)
 {}
 
-std::vector<double> RecurrentSigmoidNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void RecurrentSigmoidNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	auto res = predictCalcOnly(x, w);
-	for(auto& v : res)
-		v = sigmoid(v);
-	last_pred = res;
-	return res;
+	predictCalcOnly(x, w, y, st);
+	sigmoid_array(y, y, k);
+	copy(y, y + k, st); // last_pred
 }
 
-std::vector<double> RecurrentSigmoidNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void RecurrentSigmoidNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	auto actPre = pre;
-	for(size_t i=0;i<pre.size();++i)
-		actPre[i] *= sigmoid_derivative(0.0, y[i]);
-	return RecurrentNodeBase::gradient(grad, x, w, y, actPre);
+	double* actPre = st + 2 * k; // pre * act'(y)
+	for(int i = 0; i < k; ++i)
+		actPre[i] = pre[i] * sigmoid_derivative(0.0, y[i]);
+	RecurrentNodeBase::gradient(grad, x, w, y, actPre, dx, st);
 }
 
 // ---- Recurrent Node Tanh ----
@@ -404,22 +312,20 @@ RecurrentTanhNode::RecurrentTanhNode(const size_t offset, const std::vector<int>
 	: RecurrentNodeBase(offset, shape)
 {}
 
-std::vector<double> RecurrentTanhNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void RecurrentTanhNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	auto res = predictCalcOnly(x, w);
-	for(auto& v : res)
-		v = tanh(v);
-	last_pred = res;
-	return res;
+	predictCalcOnly(x, w, y, st);
+	tanh_array(y, y, k);
+	copy(y, y + k, st); // last_pred
 }
 
-std::vector<double> RecurrentTanhNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void RecurrentTanhNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	auto actPre = pre;
-	for(size_t i = 0; i < pre.size(); ++i)
-		actPre[i] *= tanh_derivative(0.0, y[i]);
-	return RecurrentNodeBase::gradient(grad, x, w, y, actPre);
+	double* actPre = st + 2 * k; // pre * act'(y)
+	for(int i = 0; i < k; ++i)
+		actPre[i] = pre[i] * tanh_derivative(0.0, y[i]);
+	RecurrentNodeBase::gradient(grad, x, w, y, actPre, dx, st);
 }
 
 // ---- Activation Node: ReLU ----
@@ -430,29 +336,15 @@ ReluNode::ReluNode(const size_t offset, const std::vector<int>& shape)
 	nw = 0;
 }
 
-std::vector<double> ReluNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void ReluNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	const size_t n = x.size();
-	std::vector<double> res(n);
-	for (size_t i = 0; i < n; ++i) {
-		res[i] = relu(x[i]);
-	}
-	return res;
+	relu_array(x, y, nin);
 }
 
-std::vector<double> ReluNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void ReluNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	assert(x.size() == y.size());
-	const size_t n = y.size();
-	std::vector<double> res(n); // dy/dx
-	double s = 0.0;
-	for (size_t i = 0; i < n; ++i) {
-		double d = relu_derivative(x[i]);
-		double f = pre[i] * d;
-		res[i] = f; // dy/dx
-	}
-	return res;
+	relu_backward(x, pre, dx, nin); // dy/dx
 }
 
 // ---- Activation Node: Sigmoid ----
@@ -463,30 +355,15 @@ SigmoidNode::SigmoidNode(const size_t offset, const std::vector<int>& shape)
 	nw = 0;
 }
 
-std::vector<double> SigmoidNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void SigmoidNode::predict(const double* x, const double* w, double* y, double* st) const
 {
-	const size_t n = x.size();
-	std::vector<double> res(n);
-	for (size_t i = 0; i < n; ++i) {
-		res[i] = sigmoid(x[i]);
-	}
-	return res;
+	sigmoid_array(x, y, nin);
 }
 
-std::vector<double> SigmoidNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void SigmoidNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	assert(x.size() == y.size());
-	const size_t n = y.size();
-	std::vector<double> res(n);
-	double s = 0.0;
-	for (size_t i = 0; i < n; ++i) {
-		//double d = sigmoid_derivative(x[i], y[i]);
-		double d = sigmoid_derivative(0.0, y[i]);
-		double f = pre[i] * d;
-		res[i] = f; // dy/dx
-	}
-	return res;
+	sigmoid_backward(y, pre, dx, nin); // dy/dx
 }
 
 // ---- Activation Node: Tanh ----
@@ -497,86 +374,151 @@ TanhNode::TanhNode(const size_t offset, const std::vector<int>& shape)
 	nw = 0;
 }
 
-std::vector<double> TanhNode::predict(const std::vector<double>& x, const std::vector<double>& w)
+void TanhNode::predict(const double* x, const double* w, double* y, double* st) const
+{
+	tanh_array(x, y, nin);
+}
+
+void TanhNode::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
 {
-	const size_t n = x.size();
-	std::vector<double> res(n);
-	for(size_t i = 0; i < n; ++i) {
-		res[i] = tanh(x[i]);
+	tanh_backward(y, pre, dx, nin); // dy/dx
+}
+
+// ---- Pooling kernels ----
+// <better>(a, b) is true if a wins over b, so the first winner in row-major order is kept.
+// y[i] gets the winner of window i and st[i] its index in x
+
+template <typename Better>
+static void pool1D(const double* x, const size_t nin, const size_t k,
+	double* y, double* st, const size_t ny, Better better)
+{
+	for(size_t i = 0; i < ny; ++i){
+		size_t b = i * k;
+		const size_t limit = min(b + k, nin);
+		for(size_t j = b + 1; j < limit; ++j)
+			if(better(x[j], x[b]))
+				b = j;
+		y[i] = x[b];
+		st[i] = static_cast<double>(b);
+	}
+}
+
+template <typename Better>
+static void pool2D(const double* x, const int n, const int m, const int k1, const int k2,
+	double* y, double* st, const int on, const int om, Better better)
+{
+	if(k1 == 2 && k2 == 2 && n % 2 == 0 && m % 2 == 0){
+		// no partial window: each output row reads two whole input rows
+		for(int i = 0; i < on; ++i){
+			const int r0 = 2 * i * m, r1 = r0 + m;
+			for(int j = 0; j < om; ++j){
+				int b = r0 + 2 * j;
+				if(better(x[b + 1], x[b]))
+					b = b + 1;
+				if(better(x[r1 + 2 * j], x[b]))
+					b = r1 + 2 * j;
+				if(better(x[r1 + 2 * j + 1], x[b]))
+					b = r1 + 2 * j + 1;
+				y[i * om + j] = x[b];
+				st[i * om + j] = b;
+			}
+		}
+		return;
+	}
+	for(int i = 0; i < on; ++i){
+		const int i0 = i * k1, i1 = min(n, i0 + k1);
+		for(int j = 0; j < om; ++j){
+			const int j0 = j * k2, j1 = min(m, j0 + k2);
+			int b = i0 * m + j0;
+			for(int p1 = i0; p1 < i1; ++p1)
+				for(int p2 = j0; p2 < j1; ++p2)
+					if(better(x[p1 * m + p2], x[b]))
+						b = p1 * m + p2;
+			y[i * om + j] = x[b];
+			st[i * om + j] = b;
+		}
 	}
-	return res;
 }
 
-std::vector<double> TanhNode::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+template <typename Better>
+static void pool3D(const double* x, const int n, const int m, const int p,
+	const int k1, const int k2, const int k3, double* y, double* st,
+	const int on, const int om, const int op, Better better)
 {
-	assert(x.size() == y.size());
-	const size_t n = y.size();
-	std::vector<double> res(n);
-	double s = 0.0;
-	for(size_t i = 0; i < n; ++i) {
-		//double d = tanh_derivative(x[i], y[i]);
-		double d = tanh_derivative(0.0, y[i]);
-		double f = pre[i] * d;
-		res[i] = f; // dy/dx
+	int py = 0;
+	for(int i = 0; i < on; ++i){
+		const int i0 = i * k1, i1 = min(n, i0 + k1);
+		for(int j = 0; j < om; ++j){
+			const int j0 = j * k2, j1 = min(m, j0 + k2);
+			for(int k = 0; k < op; ++k){
+				const int l0 = k * k3, l1 = min(p, l0 + k3);
+				int b = (i0 * m + j0) * p + l0;
+				for(int p1 = i0; p1 < i1; ++p1)
+					for(int p2 = j0; p2 < j1; ++p2)
+						for(int p3 = l0; p3 < l1; ++p3){
+							const int px = (p1 * m + p2) * p + p3;
+							if(better(x[px], x[b]))
+								b = px;
+						}
+				y[py] = x[b];
+				st[py] = b;
+				++py;
+			}
+		}
 	}
-	return res;
+}
+
+// ---- Pooling Node: base ----
+
+PoolNodeBase::PoolNodeBase(const size_t offset, const std::vector<int>& shape)
+	: NodeBase(offset, shape)
+{
+	nw = 0;
+	callState = true;
+}
+
+void PoolNodeBase::setInputShape(const std::vector<int>& inShape)
+{
+	NodeBase::setInputShape(inShape);
+	nst = nout; // the winners
+}
+
+void PoolNodeBase::gradient(double* grad, const double* x, const double* w,
+	const double* y, const double* pre, double* dx, double* st) const
+{
+	// no weight -> no change on <grad>
+	// dy[i]/dx = 1.0 for the winner of window i and 0 for others
+	for(size_t i = 0; i < nout; ++i)
+		dx[static_cast<size_t>(st[i])] += pre[i];
 }
 
 // ---- Pooling Node: 1D max ----
 
 PoolMaxNode1D::PoolMaxNode1D(const size_t offset, const std::vector<int>& shape)
-	: NodeBase(offset, shape), k(shape[0])
+	: PoolNodeBase(offset, shape), k(shape[0])
 {
-	nw = 0;
 	assert(shape.size() == 1);
 }
 
 std::vector<int> PoolMaxNode1D::outShape(const std::vector<int>& inShape) const
 {
-	int n = (inShape[0] + k - 1) / k;
+	int n = (inShape[0] + static_cast<int>(k) - 1) / static_cast<int>(k);
 	return { n };
 }
 
-std::vector<double> PoolMaxNode1D::predict(const std::vector<double>& x, const std::vector<double>& w)
+void PoolMaxNode1D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	const size_t n = (x.size() + k - 1) / k;
-	vector<double> res(n);
-	for (size_t i = 0; i < n; ++i) {
-		double v = x[i*k];
-		size_t limit = min((i + 1)*k, x.size());
-		for (size_t j = i * k + 1; j < limit; ++j)
-			v = max(v, x[j]);
-		res[i] = v;
-	}
-	return res;
-}
-
-std::vector<double> PoolMaxNode1D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
-{
-	// no weight -> no change on <grad>
-	// if argmax(x[1],...,x[n]) = i , then dy/dx = 1.0 and 0 for others
-	const size_t ny = y.size();
-	vector<double> res(x.size(), 0.0);
-	for (size_t i = 0; i < ny; ++i) {
-		size_t limit = min((i + 1)*k, x.size());
-		for (size_t j = i * k; j < limit; ++j) {
-			if (x[j] == y[i])
-				res[j] = pre[i];
-		}
-	}
-	return res;
+	pool1D(x, nin, k, y, st, nout, greater<double>());
 }
 
 // ---- Pooling Node: 2D max ----
 
 PoolMaxNode2D::PoolMaxNode2D(const size_t offset, const std::vector<int>& shape)
-	: NodeBase(offset, shape), n(shape[0]), m(shape[1]), k1(shape[2]), k2(shape[3]),
+	: PoolNodeBase(offset, shape), n(shape[0]), m(shape[1]), k1(shape[2]), k2(shape[3]),
 	on((n + k1 - 1) / k1), om((m + k2 - 1) / k2)
 {
 	assert(shape.size() == 4);
-	nw = 0;
 }
 
 std::vector<int> PoolMaxNode2D::outShape(const std::vector<int>& inShape) const
@@ -584,54 +526,19 @@ std::vector<int> PoolMaxNode2D::outShape(const std::vector<int>& inShape) const
 	return { on, om };
 }
 
-std::vector<double> PoolMaxNode2D::predict(const std::vector<double>& x, const std::vector<double>& w)
+void PoolMaxNode2D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	vector<double> res(on * om, numeric_limits<double>::lowest());
-	int p = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			res[off + p2] = max(res[off + p2], x[p]);
-			++p;
-		}
-	}
-	return res;
-}
-
-std::vector<double> PoolMaxNode2D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
-{
-	// no weight -> no change on <grad>
-	// if argmax(x[1],...,x[n]) = i , then dy/dx = 1.0 and 0 for others
-	assert(y.size() == on * om);
-	vector<double> res(x.size(), 0.0);
-	int px = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			int py = off + p2;
-			if(y[py] == x[px]){
-				res[px] = pre[py];
-			}
-			++px;
-		}
-	}
-	return res;
+	pool2D(x, n, m, k1, k2, y, st, on, om, greater<double>());
 }
 
 // ---- Pooling Node: 3D max ----
 
 PoolMaxNode3D::PoolMaxNode3D(const size_t offset, const std::vector<int>& shape)
-	: NodeBase(offset, shape), n(shape[0]), m(shape[1]), p(shape[2]),
+	: PoolNodeBase(offset, shape), n(shape[0]), m(shape[1]), p(shape[2]),
 	k1(shape[3]), k2(shape[4]), k3(shape[5]),
 	on((n + k1 - 1) / k1), om((m + k2 - 1) / k2), op((p + k3 - 1) / k3)
 {
 	assert(shape.size() == 6);
-	nw = 0;
 }
 
 std::vector<int> PoolMaxNode3D::outShape(const std::vector<int>& inShape) const
@@ -639,106 +546,37 @@ std::vector<int> PoolMaxNode3D::outShape(const std::vector<int>& inShape) const
 	return { on, om, op };
 }
 
-std::vector<double> PoolMaxNode3D::predict(const std::vector<double>& x, const std::vector<double>& w)
-{
-	vector<double> res(on * om * op, numeric_limits<double>::lowest());
-	int px = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om * op;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			off += p2 * op;
-			for(int k = 0; k < p; ++k){
-				int p3 = k / k3; // in range [0, op)
-				res[off + p3] = max(res[off + p3], x[px]);
-				++px;
-			}
-		}
-	}
-	return res;
-}
-
-std::vector<double> PoolMaxNode3D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void PoolMaxNode3D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	// no weight -> no change on <grad>
-	// if argmax(x[1],...,x[n]) = i , then dy/dx = 1.0 and 0 for others
-	assert(y.size() == on * om);
-	vector<double> res(x.size(), 0.0);
-	int px = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om * op;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			off += p2 * op;
-			for(int k = 0; k < p; ++k){
-				int p3 = k / k3; // in range [0, op)
-				int py = off + p2;
-				if(y[py] == x[px]){
-					res[px] = pre[py];
-				}
-				++px;
-			}
-		}
-	}
-	return res;
+	pool3D(x, n, m, p, k1, k2, k3, y, st, on, om, op, greater<double>());
 }
 
 // ---- Pooling Node: 1D min ----
 
 PoolMinNode1D::PoolMinNode1D(const size_t offset, const std::vector<int>& shape)
-	: NodeBase(offset, shape), k(shape[0])
+	: PoolNodeBase(offset, shape), k(shape[0])
 {
-	nw = 0;
 	assert(shape.size() == 1);
 }
 
 std::vector<int> PoolMinNode1D::outShape(const std::vector<int>& inShape) const
 {
-	return std::vector<int>();
-}
-
-std::vector<double> PoolMinNode1D::predict(const std::vector<double>& x, const std::vector<double>& w)
-{
-	const size_t n = (x.size() + k - 1) / k;
-	vector<double> res(n);
-	for(size_t i = 0; i < n; ++i) {
-		double v = x[i*k];
-		size_t limit = min((i + 1)*k, x.size());
-		for(size_t j = i * k + 1; j < limit; ++j)
-			v = min(v, x[j]);
-		res[i] = v;
-	}
-	return res;
+	int n = (inShape[0] + static_cast<int>(k) - 1) / static_cast<int>(k);
+	return { n };
 }
 
-std::vector<double> PoolMinNode1D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void PoolMinNode1D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	// no weight -> no change on <grad>
-	// if argmin(x[1],...,x[n]) = i , then dy/dx = 1.0 and 0 for others
-	const size_t ny = y.size();
-	vector<double> res(x.size(), 0.0);
-	for(size_t i = 0; i < ny; ++i) {
-		size_t limit = min((i + 1)*k, x.size());
-		for(size_t j = i * k; j < limit; ++j) {
-			if(x[j] == y[i])
-				res[j] = pre[i];
-		}
-	}
-	return res;
+	pool1D(x, nin, k, y, st, nout, less<double>());
 }
 
 // ---- Pooling Node: 2D min ----
 
 PoolMinNode2D::PoolMinNode2D(const size_t offset, const std::vector<int>& shape)
-	: NodeBase(offset, shape), n(shape[0]), m(shape[1]), k1(shape[2]), k2(shape[3]),
+	: PoolNodeBase(offset, shape), n(shape[0]), m(shape[1]), k1(shape[2]), k2(shape[3]),
 	on((n + k1 - 1) / k1), om((m + k2 - 1) / k2)
 {
 	assert(shape.size() == 4);
-	nw = 0;
 }
 
 std::vector<int> PoolMinNode2D::outShape(const std::vector<int>& inShape) const
@@ -746,54 +584,19 @@ std::vector<int> PoolMinNode2D::outShape(const std::vector<int>& inShape) const
 	return { on, om };
 }
 
-std::vector<double> PoolMinNode2D::predict(const std::vector<double>& x, const std::vector<double>& w)
-{
-	vector<double> res(on * om, numeric_limits<double>::max());
-	int p = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			res[off + p2] = min(res[off + p2], x[p]);
-			++p;
-		}
-	}
-	return res;
-}
-
-std::vector<double> PoolMinNode2D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void PoolMinNode2D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	// no weight -> no change on <grad>
-	// if argmin(x[1],...,x[n]) = i , then dy/dx = 1.0 and 0 for others
-	assert(y.size() == on * om);
-	vector<double> res(x.size(), 0.0);
-	int px = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			int py = off + p2;
-			if(y[py] == x[px]){
-				res[px] = pre[py];
-			}
-			++px;
-		}
-	}
-	return res;
+	pool2D(x, n, m, k1, k2, y, st, on, om, less<double>());
 }
 
 // ---- Pooling Node: 3D min ----
 
 PoolMinNode3D::PoolMinNode3D(const size_t offset, const std::vector<int>& shape)
-	: NodeBase(offset, shape), n(shape[0]), m(shape[1]), p(shape[2]),
+	: PoolNodeBase(offset, shape), n(shape[0]), m(shape[1]), p(shape[2]),
 	k1(shape[3]), k2(shape[4]), k3(shape[5]),
 	on((n + k1 - 1) / k1), om((m + k2 - 1) / k2), op((p + k3 - 1) / k3)
 {
 	assert(shape.size() == 6);
-	nw = 0;
 }
 
 std::vector<int> PoolMinNode3D::outShape(const std::vector<int>& inShape) const
@@ -801,49 +604,7 @@ std::vector<int> PoolMinNode3D::outShape(const std::vector<int>& inShape) const
 	return { on, om, op };
 }
 
-std::vector<double> PoolMinNode3D::predict(const std::vector<double>& x, const std::vector<double>& w)
-{
-	vector<double> res(on * om * op, numeric_limits<double>::lowest());
-	int px = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om * op;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			off += p2 * op;
-			for(int k = 0; k < p; ++k){
-				int p3 = k / k3; // in range [0, op)
-				res[off + p3] = min(res[off + p3], x[px]);
-				++px;
-			}
-		}
-	}
-	return res;
-}
-
-std::vector<double> PoolMinNode3D::gradient(std::vector<double>& grad, const std::vector<double>& x,
-	const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre)
+void PoolMinNode3D::predict(const double* x, const double* w, double* y, double* st) const
 {
-	// no weight -> no change on <grad>
-	// if argmin(x[1],...,x[n]) = i , then dy/dx = 1.0 and 0 for others
-	assert(y.size() == on * om);
-	vector<double> res(x.size(), 0.0);
-	int px = 0;
-	for(int i = 0; i < n; ++i){
-		int p1 = i / k1; // in range [0, on)
-		int off = p1 * om * op;
-		for(int j = 0; j < m; ++j){
-			int p2 = j / k2; // in range [0, om)
-			off += p2 * op;
-			for(int k = 0; k < p; ++k){
-				int p3 = k / k3; // in range [0, op)
-				int py = off + p2;
-				if(y[py] == x[px]){
-					res[px] = pre[py];
-				}
-				++px;
-			}
-		}
-	}
-	return res;
+	pool3D(x, n, m, p, k1, k2, k3, y, st, on, om, op, less<double>());
 }
@@ -9,9 +9,9 @@ struct InputNode
 	: public NodeBase
 {
 	InputNode(const size_t offset, const std::vector<int>& shape); // shape = {n}
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // do weighted summation
@@ -24,9 +24,9 @@ struct WeightedSumNode
 	const int n, k;
 	WeightedSumNode(const size_t offset, const std::vector<int>& shape); // shape = {n,k}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // convolution only, no activation
@@ -40,9 +40,9 @@ struct ConvNode1D
 	const int k;
 	ConvNode1D(const size_t offset, const std::vector<int>& shape); // shape = {k}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // convolution only, no activation
@@ -57,9 +57,9 @@ struct ConvNode2D
 	const int on, om;
 	ConvNode2D(const size_t offset, const std::vector<int>& shape); // shape = {n, m, k1, k2}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // convolution only, no activation
@@ -74,9 +74,9 @@ struct ConvNode3D
 	const int on, om, op;
 	ConvNode3D(const size_t offset, const std::vector<int>& shape); // shape = {n, m, p, k1, k2, k3}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // recurrent node base (no activation). use history state remembering last output
@@ -87,15 +87,15 @@ struct RecurrentNodeBase
 	: public NodeBase
 {
 	const int n, k;
-	std::vector<double> last_pred, last_grad; // store the last output (k-dim) for both predict and gradient
+	// state: the last output of predict (k), the last output of gradient (k) and a k-dim buffer
 	RecurrentNodeBase(const size_t offset, const std::vector<int>& shape); // shape = {n,k}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual void reset();
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 
-	std::vector<double> predictCalcOnly(const std::vector<double>& x, const std::vector<double>& w);
+	// y = W * x + U * last_pred + b
+	void predictCalcOnly(const double* x, const double* w, double* y, const double* st) const;
 };
 
 // recurrent node using sigmoid activation
@@ -105,9 +105,9 @@ struct RecurrentSigmoidNode
 	: public RecurrentNodeBase
 {
 	RecurrentSigmoidNode(const size_t offset, const std::vector<int>& shape); // shape = {n,k}
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // recurrent node using tanh activation
@@ -117,9 +117,9 @@ struct RecurrentTanhNode
 	: public RecurrentNodeBase
 {
 	RecurrentTanhNode(const size_t offset, const std::vector<int>& shape); // shape = {n,k}
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // n => n
@@ -129,9 +129,9 @@ struct ReluNode
 	: public NodeBase
 {
 	ReluNode(const size_t offset, const std::vector<int>& shape); // shape = {1}
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // n => n
@@ -141,9 +141,9 @@ struct SigmoidNode
 	: public NodeBase
 {
 	SigmoidNode(const size_t offset, const std::vector<int>& shape); // shape = {1}
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // n => n
@@ -153,9 +153,21 @@ struct TanhNode
 	: public NodeBase
 {
 	TanhNode(const size_t offset, const std::vector<int>& shape); // shape = {1}
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
+};
+
+// base of the pooling nodes: predict() records the input index of the winner of each window in <st>
+// (the first one in row-major order), gradient() passes pre[i] to that input only
+struct PoolNodeBase
+	: public NodeBase
+{
+	PoolNodeBase(const size_t offset, const std::vector<int>& shape);
+	// also sets nst = nout
+	virtual void setInputShape(const std::vector<int>& inShape);
+	virtual void gradient(double* grad, const double* x, const double* w,
+		const double* y, const double* pre, double* dx, double* st) const;
 };
 
 // get the max value
@@ -163,31 +175,28 @@ struct TanhNode
 // vector: y_{n/k} = max(x_{n})
 // individual: y[i] = max_{j:0~k} ( x[i*k+j] )
 struct PoolMaxNode1D
-	: public NodeBase
+	: public PoolNodeBase
 {
 	const size_t k;
 	PoolMaxNode1D(const size_t offset, const std::vector<int>& shape); // shape = {k}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
 };
 
 // get the max value
 // n,m => n/k1,m/k2 ; more precisely ceil(n/k1),ceil(m/k2)
 // vector: y_{n/k1,m/k2} = max(x_{n,m})
 // individual: y[i][j] = max_{p1:0~k1,p2:0~k2} ( x[i*k1+p1][j*k2+p2] )
+// 2x2 windows on an even n and m have a specialized loop
 struct PoolMaxNode2D
-	: public NodeBase
+	: public PoolNodeBase
 {
 	const int n, m;
 	const int k1, k2;
 	const int on, om;
 	PoolMaxNode2D(const size_t offset, const std::vector<int>& shape); // shape = {n, m, k1, k2}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
 };
 
 // get the max value
@@ -195,16 +204,14 @@ struct PoolMaxNode2D
 // vector: y_{n/k1,m/k2,p/k3} = max(x_{n,m,p})
 // individual: y[i][j][k] = max_{p1:0~k1,p2:0~k2,p3:0~k3} ( x[i*k1+p1][j*k2+p2][k*k3+p3] )
 struct PoolMaxNode3D
-	: public NodeBase
+	: public PoolNodeBase
 {
 	const int n, m, p;
 	const int k1, k2, k3;
 	const int on, om, op;
 	PoolMaxNode3D(const size_t offset, const std::vector<int>& shape); // shape = {n, m, p, k1, k2, k3}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
 };
 
 // get the min value
@@ -212,31 +219,28 @@ struct PoolMaxNode3D
 // vector: y_{n/k} = min(x_{n})
 // individual: y[i] = min_{j:0~k} ( x[i*k+j] )
 struct PoolMinNode1D
-	: public NodeBase
+	: public PoolNodeBase
 {
 	const size_t k;
 	PoolMinNode1D(const size_t offset, const std::vector<int>& shape); // shape = {k}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
 };
 
 // get the min value
 // n,m => n/k1,m/k2 ; more precisely ceil(n/k1),ceil(m/k2)
 // vector: y_{n/k1,m/k2} = min(x_{n,m})
 // individual: y[i][j] = min_{p1:0~k1,p2:0~k2} ( x[i*k1+p1][j*k2+p2] )
+// 2x2 windows on an even n and m have a specialized loop
 struct PoolMinNode2D
-	: public NodeBase
+	: public PoolNodeBase
 {
 	const int n, m;
 	const int k1, k2;
 	const int on, om;
 	PoolMinNode2D(const size_t offset, const std::vector<int>& shape); // shape = {n, m, k1, k2}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
 };
 
 // get the min value
@@ -244,14 +248,12 @@ struct PoolMinNode2D
 // vector: y_{n/k1,m/k2,p/k3} = min(x_{n,m,p})
 // individual: y[i][j][k] = min_{p1:0~k1,p2:0~k2,p3:0~k3} ( x[i*k1+p1][j*k2+p2][k*k3+p3] )
 struct PoolMinNode3D
-	: public NodeBase
+	: public PoolNodeBase
 {
 	const int n, m, p;
 	const int k1, k2, k3;
 	const int on, om, op;
 	PoolMinNode3D(const size_t offset, const std::vector<int>& shape); // shape = {n, m, p, k1, k2, k3}
 	virtual std::vector<int> outShape(const std::vector<int>& inShape) const;
-	virtual std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	virtual std::vector<double> gradient(std::vector<double>& grad, const std::vector<double>& x,
-		const std::vector<double>& w, const std::vector<double>& y, const std::vector<double>& pre);
+	virtual void predict(const double* x, const double* w, double* y, double* st) const;
 };
@@ -1,10 +1,40 @@
 #include "VectorNetwork.h"
+#include "math/activation_func.h"
 #include "util/Util.h"
 #include <regex>
 #include <cassert>
+#include <algorithm>
 
 using namespace std;
 
+// forward and backward of a fused activation, from the <n> outputs x of an op to its activated outputs y.
+// the derivatives follow the activation nodes, for relu it is taken as 1 at x = 0
+static void activate(const NodeType act, const double* x, double* y, const size_t n)
+{
+	if(act == NodeType::ActSigmoid)
+		sigmoid_array(x, y, n);
+	else if(act == NodeType::ActTanh)
+		tanh_array(x, y, n);
+	else if(act == NodeType::ActRelu)
+		relu_array(x, y, n);
+}
+
+// pgd[i] = pre[i] * act'(x[i])
+static void foldActivation(const NodeType act, const double* x, const double* y,
+	const double* pre, double* pgd, const size_t n)
+{
+	if(act == NodeType::ActSigmoid){
+		for(size_t i = 0; i < n; ++i)
+			pgd[i] = pre[i] * y[i] * (1.0 - y[i]);
+	} else if(act == NodeType::ActTanh){
+		for(size_t i = 0; i < n; ++i)
+			pgd[i] = pre[i] * (1.0 - y[i] * y[i]);
+	} else if(act == NodeType::ActRelu){
+		fill(pgd, pgd + n, 0.0);
+		relu_backward(x, pre, pgd, n);
+	}
+}
+
 std::string VectorNetwork::getRegShape() const
 {
 	static string srShape = R"((\d+(?:[\*x]\d+)*))"; // v1[*v2[*v3[*v4]]], "*" can also be "x"
@@ -125,9 +155,10 @@ void VectorNetwork::build(const std::vector<std::tuple<int, NodeTypeGeneral, std
 			break;
 		}
 	}
+	buildPlan();
 }
 
-void VectorNetwork::bindGradLossFunc(std::function<feature_t(const feature_t&p, const feature_t&y)> glFun)
+void VectorNetwork::bindGradLossFunc(std::function<void(const double* p, const FeatureView& y, double* g)> glFun)
 {
 	fgl = glFun;
 }
@@ -145,220 +176,90 @@ VectorNetwork::~VectorNetwork()
 	}
 }
 
+VectorNetwork::Buffer VectorNetwork::makeBuffer() const
+{
+	Buffer buf;
+	buf.act.assign(featureOffset[nLayer], 0.0);
+	buf.pgd.assign(featureOffset[nLayer], 0.0);
+	buf.state.assign(lengthState, 0.0);
+	return buf;
+}
+
 std::vector<double> VectorNetwork::predict(
-	const std::vector<double>& x, const std::vector<double>& w)
+	Buffer& buf, const FeatureView& x, const std::vector<double>& w) const
 {
-	// reset
-	for(int i = 0; i < nLayer; ++i){
-		if(typeLayer[i] == NodeType::RecrSig || typeLayer[i] == NodeType::RecrTanh){
-			for(auto& p : nodes[i])
-				p->reset();
-		}
-	}
-	// forward
-	vector<vector<double>> input; // k features of n-dimension
-	vector<vector<double>> output;
-	input.push_back(x);
-	// apart from the last FC layer, all nodes work on a single feature
-	for(int i = 1; i < nLayer - 1; ++i){
-		output.clear();
-		// apply one node on each previous features repeatedly
-		//assert(nFeatureLayer[i - 1] * nNodeLayer[i] == nFeatureLayer[i]);
-		for(int j = 0; j < nNodeLayer[i]; ++j){
-			for(int k = 0; k < numFeatureLayer[i - 1]; ++k){
-				output.push_back(nodes[i][j]->predict(input[k], w));
-			}
-		}
-		input = move(output);
-	}
-	// the last FC layer
-	vector<double> res;
-	int i = nLayer - 1;
-	for(int j = 0; j < nNodeLayer[i]; ++j){
-		FCNode* p = dynamic_cast<FCNode*>(nodes[i][j]);
-		res.push_back(p->predict(input, w));
-	}
-	return res;
+	return forward(buf, x, w);
 }
 
-std::vector<double> VectorNetwork::forward(
-	const std::vector<double>& x, const std::vector<double>& w)
+std::vector<double> VectorNetwork::output(const Buffer& buf) const
 {
-	// reset
-	for(int i = 0; i < nLayer; ++i){
-		if(typeLayer[i] == NodeType::RecrSig || typeLayer[i] == NodeType::RecrTanh){
-			for(auto& p : nodes[i])
-				p->reset();
-		}
-	}
-	mid.clear();
-	mid.reserve(nLayer); // intermediate result of all layers
-	mid.push_back({ x });
-	for(int i = 1; i < nLayer - 1; ++i){ // apart from the input and output (FC) layers
-		const vector<vector<double>>& input = mid[i - 1];
-		vector<vector<double>> output;
-		// apply one node on each previous features repeatedly
-		//assert(nFeatureLayer[i - 1] * nNodeLayer[i] == nFeatureLayer[i]);
-		for(int j = 0; j < nNodeLayer[i]; ++j){
-			for(int k = 0; k < numFeatureLayer[i - 1]; ++k){
-				output.push_back(nodes[i][j]->predict(input[k], w));
-			}
-		}
-		mid.push_back(move(output));
-	}
-	vector<FCNode*> finalNodes;
-	{
-		const vector<vector<double>>& input = mid[nLayer - 2];
-		vector<double> output;
-		for(int j = 0; j < nNodeLayer.back(); ++j){
-			FCNode* p = dynamic_cast<FCNode*>(nodes.back()[j]);
-			finalNodes.push_back(p);
-			output.push_back(p->predict(input, w));
-		}
-		mid.push_back({ move(output) });
-	}
-	return mid.back()[0];
+	const double* p = buf.act.data() + featureOffset[nLayer - 1];
+	return std::vector<double>(p, p + numFeatureLayer[nLayer - 1]);
 }
 
-std::vector<double> VectorNetwork::backward(
-	const std::vector<double>& x, const std::vector<double>& w, const std::vector<double>& y)
+std::vector<double> VectorNetwork::forward(
+	Buffer& buf, const FeatureView& x, const std::vector<double>& w) const
 {
-	vector<FCNode*> finalNodes;
-	for(int j = 0; j < nNodeLayer.back(); ++j){
-		FCNode* p = dynamic_cast<FCNode*>(nodes.back()[j]);
-		finalNodes.push_back(p);
-	}
+	runForward(buf, x, w);
+	return output(buf);
+}
 
+std::vector<double> VectorNetwork::backward(Buffer& buf,
+	const FeatureView& x, const std::vector<double>& w, const FeatureView& y) const
+{
 	vector<double> grad(w.size());
-	vector<vector<double>> partial; // partial gradient
-	size_t n = mid.back().size();
-	//assert(mid.back().size() ==1 && y.size() == mid.back()[0].size());
-	// BP (last layer)
-	{
-		const vector<double>& output = mid.back().front();
-		vector<double> pg = fgl(output, y);
-		for(size_t i = 0; i < y.size(); ++i){ // last FC layer
-			FCNode* p = finalNodes[i];
-			vector<vector<double>> temp = p->gradient(grad, mid[nLayer - 2], w, output[i], pg[i]);
-			if(i == 0){
-				partial = move(temp);
-			} else{
-				// partial += temp;
-				for(size_t a = 0; a < temp.size(); ++a)
-					for(size_t b = 0; b < temp[a].size(); ++b)
-						partial[a][b] += temp[a][b];
-			}
-		}
-	}
-	// BP (0 to n-1 layer)
-	for(int i = nLayer - 2; i > 0; --i){ // layer
-		int oidx = 0;
-		vector<vector<double>> newPartialGradient(numFeatureLayer[i]);
-		for(int j = 0; j < nNodeLayer[i]; ++j){ // node
-			for(int k = 0; k < numFeatureLayer[i - 1]; ++k){ // feature (input)
-				const vector<double>& input = mid[i - 1][k];
-				//oidx == j * numFeatureLayer[i - 1] + k;
-				const vector<double>& output = mid[i][oidx];
-				const vector<double>& pg = partial[oidx];
-				++oidx;
-				NodeBase* p = nodes[i][j];
-				vector<double> npg = p->gradient(grad, input, w, output, pg);
-				if(j == 0){
-					newPartialGradient[k] = move(npg);
-				} else{
-					for(size_t a = 0; a < npg.size(); ++a)
-						newPartialGradient[k][a] += npg[a];
-				}
-			}
-		}
-		partial = move(newPartialGradient);
-	}
+	accumulateBackward(buf, w, y, grad.data());
 	return grad;
 }
 
-std::vector<double> VectorNetwork::gradient(
-	const std::vector<double>& x, const std::vector<double>& w, const std::vector<double>& y)
+std::vector<double> VectorNetwork::gradient(Buffer& buf,
+	const FeatureView& x, const std::vector<double>& w, const FeatureView& y) const
 {
-	// reset
-	for(int i = 0; i < nLayer; ++i){
-		if(typeLayer[i] == NodeType::RecrSig || typeLayer[i] == NodeType::RecrTanh){
-			for(auto& p : nodes[i])
-				p->reset();
-		}
-	}
-	// forward
-	vector<vector<vector<double>>> mid; // layer -> feature -> value
-	mid.reserve(nLayer); // intermediate result of all layers
-	mid.push_back({ x });
-	for(int i = 1; i < nLayer - 1; ++i){ // apart from the input and output (FC) layers
-		const vector<vector<double>>& input = mid[i - 1];
-		vector<vector<double>> output;
-		// apply one node on each previous features repeatedly
-		//assert(nFeatureLayer[i - 1] * nNodeLayer[i] == nFeatureLayer[i]);
-		for(int j = 0; j < nNodeLayer[i]; ++j){
-			for(int k = 0; k < numFeatureLayer[i - 1]; ++k){
-				output.push_back(nodes[i][j]->predict(input[k], w));
-			}
-		}
-		mid.push_back(move(output));
-	}
-	vector<FCNode*> finalNodes;
-	{
-		const vector<vector<double>>& input = mid[nLayer - 2];
-		vector<double> output;
-		for(int j = 0; j < nNodeLayer.back(); ++j){
-			FCNode* p = dynamic_cast<FCNode*>(nodes.back()[j]);
-			finalNodes.push_back(p);
-			output.push_back(p->predict(input, w));
-		}
-		mid.push_back({ move(output) });
-	}
-	// Back Propagate
 	vector<double> grad(w.size());
-	vector<vector<double>> partial; // partial gradient
-	size_t n = mid.back().size();
-	//assert(mid.back().size() ==1 && y.size() == mid.back()[0].size());
-	// BP (last layer)
-	{
-		const vector<double>& output = mid.back().front();
-		vector<double> pg = fgl(output, y);
-		for(size_t i = 0; i < y.size(); ++i){ // last FC layer
-			FCNode* p = finalNodes[i];
-			vector<vector<double>> temp = p->gradient(grad, mid[nLayer - 2], w, output[i], pg[i]);
-			if(i == 0){
-				partial = move(temp);
-			} else{
-				// partial += temp;
-				for(size_t a = 0; a < temp.size(); ++a)
-					for(size_t b = 0; b < temp[a].size(); ++b)
-						partial[a][b] += temp[a][b];
-			}
+	accumulateGradient(buf, x, w, y, grad.data());
+	return grad;
+}
+
+void VectorNetwork::accumulateBackward(Buffer& buf, const std::vector<double>& w, const FeatureView& y, double* grad) const
+{
+	double* act = buf.act.data();
+	double* pgd = buf.pgd.data();
+	double* st = buf.state.data();
+	fill(buf.pgd.begin(), buf.pgd.end(), 0.0);
+	const size_t lastOut = featureOffset[nLayer - 1];
+	fgl(act + lastOut, y, pgd + lastOut);
+	// layers in reverse order. inside a layer the ops keep the forward order,
+	// so that the recurrent nodes see their inputs in the same order as in predict()
+	for(int i = nLayer - 1; i > 0; --i){
+		for(size_t o = planLayer[i]; o < planLayer[i + 1]; ++o){
+			const PlanOp& op = plan[o];
+			if(op.act != NodeType::None)
+				foldActivation(op.act, act + op.out, act + op.actOut, pgd + op.actOut, pgd + op.out, op.node->nout);
+			op.node->gradient(grad, act + op.in, w.data(),
+				act + op.out, pgd + op.out, pgd + op.in, st + op.st);
 		}
 	}
-	// BP (0 to n-1 layer)
-	for(int i = nLayer - 2; i > 0; --i){ // layer
-		int oidx = 0;
-		vector<vector<double>> newPartialGradient(numFeatureLayer[i]);
-		for(int j = 0; j < nNodeLayer[i]; ++j){ // node
-			for(int k = 0; k < numFeatureLayer[i - 1]; ++k){ // feature (input)
-				const vector<double>& input = mid[i - 1][k];
-				//oidx == j * numFeatureLayer[i - 1] + k;
-				const vector<double>& output = mid[i][oidx];
-				const vector<double>& pg = partial[oidx];
-				++oidx;
-				NodeBase* p = nodes[i][j];
-				vector<double> npg = p->gradient(grad, input, w, output, pg);
-				if(j == 0){
-					newPartialGradient[k] = move(npg);
-				} else{
-					for(size_t a = 0; a < npg.size(); ++a)
-						newPartialGradient[k][a] += npg[a];
-				}
-			}
-		}
-		partial = move(newPartialGradient);
+}
+
+void VectorNetwork::accumulateGradient(Buffer& buf,
+	const FeatureView& x, const std::vector<double>& w, const FeatureView& y, double* grad) const
+{
+	runForward(buf, x, w);
+	accumulateBackward(buf, w, y, grad);
+}
+
+void VectorNetwork::runForward(Buffer& buf, const FeatureView& x, const std::vector<double>& w) const
+{
+	double* act = buf.act.data();
+	double* st = buf.state.data();
+	// each evaluation starts a new sequence
+	fill(buf.state.begin(), buf.state.end(), 0.0);
+	x.copyTo(act);
+	for(const PlanOp& op : plan){
+		op.node->predict(act + op.in, w.data(), act + op.out, st + op.st);
+		if(op.act != NodeType::None)
+			activate(op.act, act + op.out, act + op.actOut, op.node->nout);
 	}
-	return grad;
 }
 
 // ---- helper functions ----
@@ -464,6 +365,9 @@ void VectorNetwork::coreCreateLayer(const size_t i,
 	typeLayer[i] = type;
 	shapeNode[i] = shape;
 	createNodesForLayer(i); // set nWeightNode, weightOffsetLayer and nodes
+	const vector<int>& inShape = i == 0 ? shape : shpFeatureLayer[i - 1];
+	for(NodeBase* p : nodes[i])
+		p->setInputShape(inShape);
 	if(i == 0){
 		numFeatureLayer[i] = n;
 		shpFeatureLayer[i] = shape;
@@ -487,3 +391,64 @@ void VectorNetwork::createNodesForLayer(const size_t i)
 	}
 	weightOffsetLayer[i + 1] = offset;
 }
+
+void VectorNetwork::buildPlan()
+{
+	featureOffset.resize(nLayer + 1);
+	size_t offset = 0;
+	for(int i = 0; i < nLayer; ++i){
+		featureOffset[i] = offset;
+		offset += numFeatureLayer[i] * lenFeatureLayer[i];
+	}
+	featureOffset[nLayer] = offset;
+
+	plan.clear();
+	planLayer.assign(nLayer + 1, 0);
+	lengthState = 0;
+	// the input layer has no op, x is copied to the arena directly
+	for(int i = 1; i < nLayer; ++i){
+		planLayer[i] = plan.size();
+		if(fusible(i - 1))
+			continue; // done by the ops of layer i-1
+		// a fused op activates into the same feature of the next layer, which has the same layout
+		const bool fuse = fusible(i);
+		const NodeType act = fuse ? typeLayer[i + 1] : NodeType::None;
+		const size_t actOffset = fuse ? featureOffset[i + 1] : featureOffset[i];
+		for(int j = 0; j < nNodeLayer[i]; ++j){
+			NodeBase* p = nodes[i][j];
+			// a state kept between calls is shared by all the ops of the node
+			size_t st = lengthState;
+			if(!p->callState)
+				lengthState += p->nst;
+			if(i == nLayer - 1 && typeLayer[i] == NodeType::FC){
+				// each FC node takes all the features of the previous layer
+				plan.push_back({ p, featureOffset[i - 1], featureOffset[i] + j, featureOffset[i] + j, st, NodeType::None });
+				continue;
+			}
+			// apply one node on each previous features repeatedly
+			for(int k = 0; k < numFeatureLayer[i - 1]; ++k){
+				size_t in = featureOffset[i - 1] + k * lenFeatureLayer[i - 1];
+				size_t f = (j * numFeatureLayer[i - 1] + k) * lenFeatureLayer[i];
+				if(p->callState){
+					st = lengthState;
+					lengthState += p->nst;
+				}
+				plan.push_back({ p, in, featureOffset[i] + f, actOffset + f, st, act });
+			}
+		}
+	}
+	planLayer[nLayer] = plan.size();
+}
+
+bool VectorNetwork::fusible(const int i) const
+{
+	if(i < 1 || i + 1 >= nLayer)
+		return false;
+	// these nodes do not read their output in gradient()
+	const NodeType t = typeLayer[i];
+	const bool linear = t == NodeType::WeightedSum || t == NodeType::Conv1D
+		|| t == NodeType::Conv2D || t == NodeType::Conv3D;
+	const NodeType a = typeLayer[i + 1];
+	const bool activation = a == NodeType::ActRelu || a == NodeType::ActSigmoid || a == NodeType::ActTanh;
+	return linear && activation;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "NodeBase.h"
+#include "data/DataPoint.h"
 #include <string>
 #include <vector>
 #include <tuple>
@@ -28,11 +29,34 @@ struct VectorNetwork {
 
 	std::vector<std::vector<NodeBase*>> nodes;
 
-	std::vector<std::vector<std::vector<double>>> mid; // intermediate result for each layer-feature-dimension
+	// execution plan, made by build().
+	// all features of all layers live in one arena: feature f of layer i starts at
+	// featureOffset[i] + f * lenFeatureLayer[i]. the partial gradients use the same layout.
+	// a sum or convolution layer followed by an activation layer is fused: its ops also activate their
+	// outputs into the features of the activation layer, the activation layer has no op.
+	struct PlanOp {
+		NodeBase* node;
+		size_t in, out; // offsets of the input and the output feature in the arena
+		size_t actOut; // offset of the activated output feature, the same as <out> without fusion
+		size_t st; // offset of the state of the node
+		NodeType act; // the fused activation (ActRelu, ActSigmoid, ActTanh) or None
+	};
+	std::vector<PlanOp> plan; // in the order of forward propagation
+	std::vector<size_t> planLayer; // the ops of layer i are plan[planLayer[i], planLayer[i+1])
+	std::vector<size_t> featureOffset; // offset of the first feature of layer i in the arena
+	size_t lengthState = 0; // the states of all nodes
+
+	// all the memory one evaluation writes. the network itself is not changed by an evaluation,
+	// so several threads can use it at the same time, each with its own buffer
+	struct Buffer {
+		std::vector<double> act; // arena of the outputs of all nodes
+		std::vector<double> pgd; // arena of the partial gradients
+		std::vector<double> state; // states of the nodes
+	};
 private:
-	// function of the gradient of loss function. calculate gradient for each p entry
-	// First Arg: predicted value. Second Arg: expected value
-	std::function<feature_t(const feature_t& p, const feature_t& y)> fgl;
+	// function of the gradient of loss function. set the gradient for each p entry into g
+	// First Arg: predicted value. Second Arg: expected value. Third Arg: output
+	std::function<void(const double* p, const FeatureView& y, double* g)> fgl;
 public:
 	// R"((\d+(?:[\*x]\d+)*))"
 	std::string getRegShape() const;
@@ -48,15 +72,23 @@ public:
 	// use the input structure info to build up the network
 	void build(const std::vector<std::tuple<int, NodeTypeGeneral, std::string>>& structure);
 
-	void bindGradLossFunc(std::function<feature_t(const feature_t& p, const feature_t& y)> glFun);
+	void bindGradLossFunc(std::function<void(const double* p, const FeatureView& y, double* g)> glFun);
 	int lengthParameter() const;
 
-	std::vector<double> predict(const std::vector<double>& x, const std::vector<double>& w);
-	std::vector<double> forward(const std::vector<double>& x, const std::vector<double>& w);
-	std::vector<double> backward(
-		const std::vector<double>& x, const std::vector<double>& w, const std::vector<double>& y);
-	std::vector<double> gradient(
-		const std::vector<double>& x, const std::vector<double>& w, const std::vector<double>& y);
+	Buffer makeBuffer() const;
+	// the output of the last evaluation on <buf>
+	std::vector<double> output(const Buffer& buf) const;
+	std::vector<double> predict(Buffer& buf, const FeatureView& x, const std::vector<double>& w) const;
+	// forward() keeps the outputs of all nodes in <buf> for the following backward()
+	std::vector<double> forward(Buffer& buf, const FeatureView& x, const std::vector<double>& w) const;
+	std::vector<double> backward(Buffer& buf,
+		const FeatureView& x, const std::vector<double>& w, const FeatureView& y) const;
+	std::vector<double> gradient(Buffer& buf,
+		const FeatureView& x, const std::vector<double>& w, const FeatureView& y) const;
+	// add the gradient into <grad> (length of <w>), without any allocation
+	void accumulateBackward(Buffer& buf, const std::vector<double>& w, const FeatureView& y, double* grad) const;
+	void accumulateGradient(Buffer& buf,
+		const FeatureView& x, const std::vector<double>& w, const FeatureView& y, double* grad) const;
 
 	~VectorNetwork();
 
@@ -79,4 +111,10 @@ private:
 	// precondition: typeLayer[i], nNodeLayer[i], shapeNode[i], weightOffsetLayer[i]
 	// postcondition: nWeightNode[i], nodes[i], weightOffsetLayer[i+1]
 	void createNodesForLayer(const size_t i);
+	// set plan, planLayer, featureOffset and lengthState
+	void buildPlan();
+	// whether layer i is linear and followed by an activation layer
+	bool fusible(const int i) const;
+
+	void runForward(Buffer& buf, const FeatureView& x, const std::vector<double>& w) const;
 };
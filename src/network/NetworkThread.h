@@ -52,6 +52,11 @@ public:
 		broadcast(new Task(Task::ANY_DST, tag, move(s)));
 		stat_send_time += tmr.elapseSd();
 	}
+	void broadcast(int tag, std::string&& msg) {
+		Timer tmr;
+		broadcast(new Task(Task::ANY_DST, tag, move(msg)));
+		stat_send_time += tmr.elapseSd();
+	}
 
 	template <class T>
 	void multicast(std::vector<int> dsts, int tag, const T& msg) {
@@ -62,6 +67,12 @@ public:
 			send(new Task(dst, tag, s));
 		stat_send_time += tmr.elapseSd();
 	}
+	void multicast(std::vector<int> dsts, int tag, std::string&& msg) {
+		Timer tmr;
+		for(int dst : dsts)
+			send(new Task(dst, tag, msg));
+		stat_send_time += tmr.elapseSd();
+	}
 
 	void flush();
 	void cancel(const std::vector<int>& types);
@@ -3,6 +3,8 @@
 #include "util/Sleeper.h"
 #include <thread>
 #include <stdexcept>
+#include <algorithm>
+#include <numeric>
 
 using namespace std;
 
@@ -59,11 +61,14 @@ Trainer::DeltaResult EM::batchDelta(
 		end = pd->size();
 	size_t nx = pm->paramWidth();
 	vector<double> grad(nx, 0.0);
-	size_t i;
-	for(i = start; i < end && cond.load(); ++i){
-		auto g = pm->gradient(pd->get(i), &h[i]);
-		for(size_t j = 0; j < nx; ++j)
-			grad[j] += g[j];
+	double loss = 0.0;
+	size_t i = start;
+	while(i < end && cond.load()){
+		size_t m = viewChunkHidden(i, end, h);
+		pm->batchGradient(bview.data(), m, grad, bloss.data(), bhidden.data());
+		returnHidden(i, m, h);
+		loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0);
+		i += m;
 	}
 	if(i != start){
 		// this is gradient DESCENT, so rate is set to negative
@@ -73,7 +78,7 @@ Trainer::DeltaResult EM::batchDelta(
 		for(auto& v : grad)
 			v *= factor;
 	}
-	return { i - start, i - start, move(grad) };
+	return { i - start, i - start, move(grad), loss };
 }
 
 Trainer::DeltaResult EM::batchDelta(std::atomic<bool>& cond,
@@ -86,15 +91,14 @@ Trainer::DeltaResult EM::batchDelta(std::atomic<bool>& cond,
 	double loss = 0.0;
 	vector<double> grad(nx, 0.0);
 	Sleeper slp;
-	size_t i;
-	for(i = start; i < end && cond.load(); ++i){
+	size_t i = start;
+	while(i < end && cond.load()){
 		Timer tt;
-		//auto p = pm->forward(pd->get(i));
-		//loss += pm->loss(p, pd->get(i).y);
-		//auto g = pm->backward(pd->get(i), &h[i]);
-		auto g = pm->gradient(pd->get(i), &h[i]);
-		for(size_t j = 0; j < nx; ++j)
-			grad[j] += g[j];
+		size_t m = viewChunkHidden(i, end, h);
+		pm->batchGradient(bview.data(), m, grad, bloss.data(), bhidden.data());
+		returnHidden(i, m, h);
+		loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0);
+		i += m;
 		double time = tt.elapseSd();
 		slp.sleep(time * adjust);
 	}
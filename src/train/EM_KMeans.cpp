@@ -3,6 +3,8 @@
 #include "util/Sleeper.h"
 #include <thread>
 #include <exception>
+#include <algorithm>
+#include <numeric>
 using namespace std;
 
 void EM_KMeans::init(const std::vector<std::string>& param)
@@ -45,13 +47,16 @@ Trainer::DeltaResult EM_KMeans::batchDelta(
 		end = pd->size();
 	size_t nx = pm->paramWidth();
 	vector<double> grad(nx, 0.0);
-	size_t i;
-	for(i = start; i < end && cond.load(); ++i){
-		auto g = pm->gradient(pd->get(i), &h[i]);
-		for(size_t j = 0; j < nx; ++j)
-			grad[j] += g[j];
+	double loss = 0.0;
+	size_t i = start;
+	while(i < end && cond.load()){
+		size_t m = viewChunkHidden(i, end, h);
+		pm->batchGradient(bview.data(), m, grad, bloss.data(), bhidden.data());
+		returnHidden(i, m, h);
+		loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0); // objective values
+		i += m;
 	}
-	return { i - start, i - start, move(grad) };
+	return { i - start, i - start, move(grad), loss };
 }
 
 Trainer::DeltaResult EM_KMeans::batchDelta(std::atomic<bool>& cond,
@@ -65,13 +70,15 @@ Trainer::DeltaResult EM_KMeans::batchDelta(std::atomic<bool>& cond,
 	vector<double> grad(nx, 0.0);
 	Sleeper slp;
 	size_t i = 0;
-	for(; i < cnt && cond.load(); ++i){
+	while(i < cnt && cond.load()){
 		size_t dp = (start + i) % pd->size();
 		Timer tt;
-		auto g = pm->gradient(pd->get(dp), &h[dp]);
-		for(size_t j = 0; j < nx; ++j)
-			grad[j] += g[j];
-		loss += g[nx]; //g.back(); accumulate loss
+		// a chunk does not cross the end of the data set
+		size_t m = viewChunkHidden(dp, dp + min(cnt - i, pd->size() - dp), h);
+		pm->batchGradient(bview.data(), m, grad, bloss.data(), bhidden.data());
+		returnHidden(dp, m, h);
+		loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0); // objective values
+		i += m;
 		double time = tt.elapseSd();
 		slp.sleep(time * adjust);
 	}
@@ -3,6 +3,7 @@
 #include "util/Sleeper.h"
 #include "logging/logging.h"
 #include <exception>
+#include <numeric>
 
 using namespace std;
 
@@ -63,13 +64,17 @@ Trainer::DeltaResult GD::batchDelta(std::atomic<bool>& cond,
 	size_t nx = pm->paramWidth();
 	vector<double> grad(nx, 0.0);
 	double loss = 0.0;
-	size_t i;
-	for(i = start; i < end && cond.load(); ++i){
-		auto p = pm->forward(pd->get(i));
-		loss += pm->loss(p, pd->get(i).y);
-		auto g = pm->backward(pd->get(i));
-		for(size_t j = 0; j < nx; ++j)
-			grad[j] += g[j];
+	stageBatch(start, end - start);
+	size_t i = start;
+	if(nThread > 1){
+		i += parallelGradient(cond, start, end, grad, loss);
+	} else{
+		while(i < end && cond.load()){
+			size_t m = viewChunk(i, end);
+			pm->batchBackward(bview.data(), m, grad, bloss.data());
+			loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0);
+			i += m;
+		}
 	}
 	stat_t_grad_calc += tmr.elapseSd();
 	tmr.restart();
@@ -82,7 +87,7 @@ Trainer::DeltaResult GD::batchDelta(std::atomic<bool>& cond,
 			v *= factor;
 	}
 	stat_t_grad_post += tmr.elapseSd();
-	return { i - start, i - start, move(grad) };
+	return { i - start, i - start, move(grad), loss };
 }
 
 Trainer::DeltaResult GD::batchDelta(std::atomic<bool>& cond,
@@ -96,15 +101,15 @@ Trainer::DeltaResult GD::batchDelta(std::atomic<bool>& cond,
 	vector<double> grad(nx, 0.0);
 	double loss = 0.0;
 	Sleeper slp;
-	size_t i;
+	stageBatch(start, end - start);
+	size_t i = start;
 	//double xxxx = 0.0, yyyy = 0.0;
-	for(i = start; i < end && cond.load(); ++i){
+	while(i < end && cond.load()){
 		Timer tt;
-		auto p = pm->forward(pd->get(i));
-		loss += pm->loss(p, pd->get(i).y);
-		auto g = pm->backward(pd->get(i));
-		for(size_t j = 0; j < nx; ++j)
-			grad[j] += g[j];
+		size_t m = viewChunk(i, end);
+		pm->batchBackward(bview.data(), m, grad, bloss.data());
+		loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0);
+		i += m;
 		double time = tt.elapseSd();
 		//xxxx += time;
 		//tt.restart();
@@ -34,6 +34,11 @@ std::string PSGD::name() const
 	return "psgd";
 }
 
+bool PSGD::supportDataOrder() const
+{
+	return false;
+}
+
 void PSGD::prepare()
 {
 	paramWidth = pm->paramWidth();
@@ -52,6 +57,7 @@ void PSGD::prepare()
 	priority.resize(pd->size());
 	prhd->init(pd->size());
 	avgGrad.resize(paramWidth, 0.0);
+	pointGrad.resize(paramWidth);
 	renewSize = static_cast<size_t>(pd->size() * renewRatio);
 	topSize = static_cast<size_t>(pd->size() * topRatio);
 	renewPointer = 0;
@@ -62,6 +68,7 @@ void PSGD::ready()
 	// prepare initialize priority
 	prhd->init(pd->size());
 	priorityIdx.resize(pd->size());
+	pm->fixParameter();
 	for(size_t i = 0; i < pd->size(); ++i){
 		auto g = pm->gradient(pd->get(i));
 		if(prioInitType == PriorityType::Length){
@@ -79,6 +86,7 @@ void PSGD::ready()
 			avgGrad[j] /= pd->size();
 	}
 	if(prioInitType == PriorityType::Projection){
+		pm->fixParameter();
 		for(size_t i = 0; i < pd->size(); ++i){
 			auto g = pm->gradient(pd->get(i));
 			float p = calcPriorityProjection(g);
@@ -115,7 +123,8 @@ Trainer::DeltaResult PSGD::batchDelta(std::atomic<bool>& cond,
 	stat_t_renew += tmr.elapseSd();
 	// phase 2: calculate gradient for parameter
 	tmr.restart();
-	vector<double> grad2 = phaseCalculateGradient(topSize);
+	double loss = 0.0;
+	vector<double> grad2 = phaseCalculateGradient(topSize, loss);
 	// variation
 	if(varAggAverage){
 		updateAvgGrad(grad2, static_cast<double>(topSize) / cnt);
@@ -143,7 +152,7 @@ Trainer::DeltaResult PSGD::batchDelta(std::atomic<bool>& cond,
 		}
 	}
 	stat_t_post += tmr.elapseSd();
-	return { cnt, topSize, move(grad2) };
+	return { cnt, topSize, move(grad2), loss };
 }
 
 std::vector<double> PSGD::phaseUpdatePriority(const size_t r)
@@ -151,41 +160,56 @@ std::vector<double> PSGD::phaseUpdatePriority(const size_t r)
 	vector<double> grad(paramWidth, 0.0);
 	// force renew the gradient of some data points
 	size_t rcnt = r + 1;
+	pm->fixParameter();
 	while(--rcnt > 0){
-		auto&& g = pm->gradient(pd->get(renewPointer));
-		float p = calcPriority(g);
+		fill(pointGrad.begin(), pointGrad.end(), 0.0);
+		pm->accumulateGradient(pd->get(renewPointer), pointGrad);
+		float p = calcPriority(pointGrad);
 		prhd->update(renewPointer, wver, p);
 		for(size_t j = 0; j < paramWidth; ++j)
-			grad[j] += g[j];
+			grad[j] += pointGrad[j];
 		renewPointer = (renewPointer + 1) % pd->size();
 	}
 	return grad;
 }
 
-std::vector<double> PSGD::phaseCalculateGradient(const size_t k)
+std::vector<double> PSGD::phaseCalculateGradient(const size_t k, double& loss)
 {
 	Timer tmr;
 	vector<double> grad(paramWidth, 0.0);
 	getTopK(k);
 	stat_t_u_topk += tmr.elapseSd();
+	if(!varAggLearn){
+		// no priority update, the gradients are added into <grad> directly
+		tmr.restart();
+		for(size_t i = 0; i < k; i += KERNEL_CHUNK){
+			size_t m = min(KERNEL_CHUNK, k - i);
+			for(size_t t = 0; t < m; ++t)
+				bview[t] = pd->get(priorityIdx[i + t]);
+			pm->batchGradient(bview.data(), m, grad, bloss.data());
+			loss += accumulate(bloss.begin(), bloss.begin() + m, 0.0);
+		}
+		stat_t_u_grad += tmr.elapseSd();
+		return grad;
+	}
 	// update gradient and priority of data-points
+	pm->fixParameter();
 	for(size_t i = 0; i < k; ++i){
 		size_t id = priorityIdx[i];
 		// calculate gradient
 		tmr.restart();
-		auto&& g = pm->gradient(pd->get(id));
+		fill(pointGrad.begin(), pointGrad.end(), 0.0);
+		loss += pm->lossAndGradient(pd->get(id), pointGrad);
 		stat_t_u_grad += tmr.elapseSd();
 		// calcualte priority
-		if(varAggLearn){
-			tmr.restart();
-			float p = calcPriority(g);
-			prhd->update(i, wver, p);
-			stat_t_u_prio += tmr.elapseSd();
-		}
+		tmr.restart();
+		float p = calcPriority(pointGrad);
+		prhd->update(i, wver, p);
+		stat_t_u_prio += tmr.elapseSd();
 		// accumulate gradient result
 		tmr.restart();
 		for(size_t j = 0; j < paramWidth; ++j)
-			grad[j] += g[j];
+			grad[j] += pointGrad[j];
 		stat_t_u_merge += tmr.elapseSd();
 	}
 	return grad;
@@ -28,6 +28,7 @@ protected:
 
 	// gradient
 	std::vector<double> avgGrad;
+	std::vector<double> pointGrad; // buffer for the gradient of one data point
 	// variations
 	bool varAggReport= false; // also report gradient from the priority-update phase
 	bool varAggLearn = false; // also calculate and learn the data points from the parameter-update phase
@@ -47,6 +48,8 @@ public:
 public:
 	virtual void init(const std::vector<std::string>& param);
 	virtual std::string name() const;
+	// the points are picked by their priority
+	virtual bool supportDataOrder() const;
 	virtual void prepare(); // after bind data
 	virtual void ready(); // after set initializing parameter
 	virtual ~PSGD();
@@ -58,7 +61,8 @@ public:
 // main logic:
 protected:
 	std::vector<double> phaseUpdatePriority(const size_t r);
-	std::vector<double> phaseCalculateGradient(const size_t k);
+	// <loss> is set to the sum of the loss of the <k> points
+	std::vector<double> phaseCalculateGradient(const size_t k, double& loss);
 
 // parse parameters
 	bool parsePriority(const std::string& typeInit, const std::string& type);
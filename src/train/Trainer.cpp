@@ -1,12 +1,133 @@
 #include "Trainer.h"
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <stdexcept>
 using namespace std;
 
+constexpr size_t Trainer::KERNEL_CHUNK;
+
 void Trainer::bindModel(Model* pm){
 	this->pm = pm;
 }
 
 void Trainer::bindDataset(const DataHolder* pd){
 	this->pd = pd;
+	pipe.reset();
+	order.init(pd->size(), DataOrder::Mode::Sequential);
+	bview.resize(KERNEL_CHUNK);
+	bloss.resize(KERNEL_CHUNK);
+	bhidden.resize(KERNEL_CHUNK);
+}
+
+void Trainer::enablePipeline(const bool toDouble)
+{
+	pipe.reset(new BatchPipeline(pd, toDouble, &order));
+}
+
+void Trainer::setDataOrder(const DataOrder::Mode mode, const size_t blockPoints, const unsigned seed)
+{
+	if(mode != DataOrder::Mode::Sequential && !supportDataOrder())
+		throw invalid_argument("trainer " + name() + " only supports the sequential data order");
+	if(pipe)
+		pipe->invalidate();
+	order.init(pd->size(), mode, blockPoints, seed);
+}
+
+bool Trainer::supportDataOrder() const
+{
+	return true;
+}
+
+void Trainer::nextEpoch()
+{
+	if(order.isSequential())
+		return;
+	if(pipe)
+		pipe->invalidate();
+	order.shuffle();
+}
+
+void Trainer::stageBatch(const size_t start, const size_t cnt)
+{
+	if(pipe){
+		pbatch = &pipe->fetch(start, cnt);
+		bstart = start;
+	} else if(order.isSequential()){
+		pd->hint(start, cnt);
+	}
+}
+
+void Trainer::setThreads(const size_t n)
+{
+	nThread = max<size_t>(1, n);
+	pool.resize(nThread);
+}
+
+size_t Trainer::parallelGradient(std::atomic<bool>& cond, const size_t start, const size_t end,
+	std::vector<double>& grad, double& loss)
+{
+	pm->prepareWorkspace(nThread);
+	tbuf.resize(nThread);
+	const size_t total = end - start;
+	function<void(const size_t)> fun = [&](const size_t t){
+		ThreadBuffer& tb = tbuf[t];
+		tb.view.resize(KERNEL_CHUNK);
+		tb.loss.resize(KERNEL_CHUNK);
+		tb.grad.assign(grad.size(), 0.0);
+		tb.lsum = 0.0;
+		Workspace& ws = pm->getWorkspace(t);
+		const size_t first = start + total * t / nThread;
+		const size_t last = start + total * (t + 1) / nThread;
+		tb.count = last - first;
+		size_t i = first;
+		while(i < last && cond.load()){
+			size_t m = min(KERNEL_CHUNK, last - i);
+			for(size_t k = 0; k < m; ++k)
+				tb.view[k] = batchPoint(i + k);
+			pm->batchGradient(ws, tb.view.data(), m, tb.grad, tb.loss.data());
+			tb.lsum += accumulate(tb.loss.begin(), tb.loss.begin() + m, 0.0);
+			i += m;
+		}
+		tb.used = i - first;
+	};
+	pool.run(fun);
+	// the parts after the first one which stopped early are dropped
+	size_t used = 0;
+	for(ThreadBuffer& tb : tbuf){
+		for(size_t k = 0; k < grad.size(); ++k)
+			grad[k] += tb.grad[k];
+		loss += tb.lsum;
+		used += tb.used;
+		if(tb.used != tb.count)
+			break;
+	}
+	return used;
+}
+
+size_t Trainer::viewChunk(const size_t pos, const size_t end)
+{
+	size_t m = min(KERNEL_CHUNK, end - pos);
+	for(size_t k = 0; k < m; ++k)
+		bview[k] = batchPoint(pos + k);
+	return m;
+}
+
+size_t Trainer::viewChunkHidden(const size_t pos, const size_t end, std::vector<std::vector<double>>& h)
+{
+	size_t m = min(KERNEL_CHUNK, end - pos);
+	for(size_t k = 0; k < m; ++k){
+		const size_t p = order[pos + k];
+		bview[k] = pd->get(p);
+		bhidden[k].swap(h[p]);
+	}
+	return m;
+}
+
+void Trainer::returnHidden(const size_t pos, const size_t m, std::vector<std::vector<double>>& h)
+{
+	for(size_t k = 0; k < m; ++k)
+		bhidden[k].swap(h[order[pos + k]]);
 }
 
 void Trainer::prepare()
@@ -44,6 +165,7 @@ double Trainer::loss(const size_t topn) const {
 Trainer::DeltaResult Trainer::batchDelta(std::atomic<bool>& cond,
 	const size_t start, const size_t cnt, const bool avg, const double slow)
 {
+	pd->hint(start, cnt);
 	return batchDelta(cond, start, cnt, avg);
 }
 
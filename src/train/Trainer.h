@@ -1,9 +1,13 @@
 #pragma once
 #include "model/Model.h"
 #include "data/DataHolder.h"
+#include "data/BatchPipeline.h"
+#include "data/DataOrder.h"
+#include "util/ThreadPool.h"
 #include <utility>
 #include <vector>
 #include <atomic>
+#include <memory>
 
 class Trainer
 {
@@ -25,6 +29,23 @@ public:
 
 	void bindModel(Model* pm);
 	void bindDataset(const DataHolder* pd);
+	// gather the next mini-batch on a helper thread while the current one is used.
+	// it takes effect in trainers that go through stageBatch() (GD). call it after bindDataset()
+	void enablePipeline(const bool toDouble);
+	// visit the data in the order of <mode>, <start> of batchDelta() is a position of the order.
+	// throw invalid_argument for a non-sequential order if supportDataOrder() is false.
+	// call it after bindDataset()
+	void setDataOrder(const DataOrder::Mode mode, const size_t blockPoints, const unsigned seed);
+	// whether batchDelta() reads the points through the data order (default true)
+	virtual bool supportDataOrder() const;
+	// the data point at position <pos> of the order
+	size_t dataIndex(const size_t pos) const { return order[pos]; }
+	// called when all positions are visited, draws a new order
+	void nextEpoch();
+	// compute the gradient of a mini-batch on <n> threads, each with its own workspace of the model.
+	// the threads are kept for all the batches.
+	// it takes effect in trainers that go through parallelGradient() (GD)
+	void setThreads(const size_t n);
 	// called after bind model and dataset (without parameter)
 	virtual void prepare();
 	// last step before running
@@ -50,5 +71,45 @@ public:
 
 protected:
 	std::vector<std::string> param;
+	std::unique_ptr<BatchPipeline> pipe;
+	DataOrder order;
 	void initBasic(const std::vector<std::string>& param);
+	// prepare the points at positions [start, start+cnt) for batchPoint()
+	void stageBatch(const size_t start, const size_t cnt);
+	// the point at position <pos> of the staged batch
+	DataPointView batchPoint(const size_t pos) const {
+		return pipe ? pbatch->get(pos - bstart) : pd->get(order[pos]);
+	}
+	// points are given to the kernel in chunks of this size, <cond> of batchDelta() is checked between them
+	static constexpr size_t KERNEL_CHUNK = 64;
+	std::vector<DataPointView> bview; // a chunk of points for the batch kernel calls
+	std::vector<double> bloss; // loss of each point of the chunk
+	// put the staged points at positions [pos, min(end, pos+KERNEL_CHUNK)) in <bview>, return their number
+	size_t viewChunk(const size_t pos, const size_t end);
+	// the hidden states of the chunk of viewChunkHidden(), the batch kernel calls take them contiguous
+	std::vector<std::vector<double>> bhidden;
+	// like viewChunk() without staging, it also swaps the hidden states <h> (one per data point)
+	// of the points into <bhidden>. returnHidden() swaps them back
+	size_t viewChunkHidden(const size_t pos, const size_t end, std::vector<std::vector<double>>& h);
+	void returnHidden(const size_t pos, const size_t m, std::vector<std::vector<double>>& h);
+	size_t nThread = 1;
+	// add the gradient (Model::batchGradient) of the staged points at positions [start, end) into <grad>
+	// with <nThread> threads, each works on a contiguous part in chunks. add their loss into <loss>.
+	// if <cond> is reset, each thread stops after its current chunk. only the points of the contiguous
+	// prefix [start, start+r) which was fully processed are used, r is returned
+	size_t parallelGradient(std::atomic<bool>& cond, const size_t start, const size_t end,
+		std::vector<double>& grad, double& loss);
+private:
+	struct ThreadBuffer {
+		std::vector<DataPointView> view;
+		std::vector<double> loss;
+		std::vector<double> grad;
+		size_t count; // points of its part
+		size_t used;
+		double lsum;
+	};
+	std::vector<ThreadBuffer> tbuf;
+	ThreadPool pool;
+	const DataHolder* pbatch = nullptr; // the staged copy of the pipeline
+	size_t bstart = 0;
 };
@@ -71,7 +71,8 @@ Trainer::DeltaResult PSGD_log::batchDelta(
 	stat_t_renew += tmr.elapseSd();
 	// phase 2: calculate gradient for parameter
 	tmr.restart();
-	vector<double> grad2 = phaseCalculateGradient(topSize);
+	double loss = 0.0;
+	vector<double> grad2 = phaseCalculateGradient(topSize, loss);
 	// variation
 	if(varAggAverage){
 		updateAvgGrad(grad2, static_cast<double>(topSize) / cnt);
@@ -96,5 +97,5 @@ Trainer::DeltaResult PSGD_log::batchDelta(
 		}
 	}
 	stat_t_post += tmr.elapseSd();
-	return { cnt, topSize, move(grad2) };
+	return { cnt, topSize, move(grad2), loss };
 }
@@ -0,0 +1,68 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::~ThreadPool()
+{
+	shutdown();
+}
+
+void ThreadPool::resize(const size_t n)
+{
+	if(n == size())
+		return;
+	shutdown();
+	for(size_t t = 1; t < n; ++t)
+		ths.emplace_back(&ThreadPool::loop, this, t, generation);
+}
+
+void ThreadPool::run(const std::function<void(const size_t)>& f)
+{
+	if(ths.empty()){
+		f(0);
+		return;
+	}
+	{
+		lock_guard<mutex> lk(mtx);
+		job = &f;
+		pending = ths.size();
+		++generation;
+	}
+	cvStart.notify_all();
+	f(0);
+	unique_lock<mutex> lk(mtx);
+	cvDone.wait(lk, [&](){ return pending == 0; });
+	job = nullptr;
+}
+
+void ThreadPool::shutdown()
+{
+	{
+		lock_guard<mutex> lk(mtx);
+		stop = true;
+	}
+	cvStart.notify_all();
+	for(auto& th : ths)
+		th.join();
+	ths.clear();
+	stop = false;
+}
+
+void ThreadPool::loop(const size_t t, size_t seen)
+{
+	while(true){
+		const function<void(const size_t)>* f;
+		{
+			unique_lock<mutex> lk(mtx);
+			cvStart.wait(lk, [&](){ return stop || generation != seen; });
+			if(stop)
+				return;
+			seen = generation;
+			f = job;
+		}
+		(*f)(t);
+		lock_guard<mutex> lk(mtx);
+		if(--pending == 0)
+			cvDone.notify_one();
+	}
+}
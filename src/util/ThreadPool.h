@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A fixed set of threads which run one job at a time. The threads are started by resize() and
+// wait for the next job, so a job does not pay for creating and joining threads.
+// run(f) calls f(t) for each thread index t in [0, size()), f(0) on the calling thread.
+class ThreadPool {
+	std::vector<std::thread> ths;
+	std::mutex mtx;
+	std::condition_variable cvStart, cvDone;
+	const std::function<void(const size_t)>* job = nullptr;
+	size_t generation = 0; // number of jobs given so far
+	size_t pending = 0; // helper threads still working on the current job
+	bool stop = false;
+
+public:
+	ThreadPool() = default;
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	// <n> threads in total including the caller of run(), so n-1 helpers
+	void resize(const size_t n);
+	size_t size() const { return ths.size() + 1; }
+	// return when all the threads are done
+	void run(const std::function<void(const size_t)>& f);
+
+private:
+	void shutdown();
+	void loop(const size_t t, size_t seen);
+};
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "data/DataLoader.h"
+#include "data/DataCache.h"
+
+using namespace std;
+
+bool sameData(const DataHolder& a, const DataHolder& b){
+	if(a.size() != b.size() || a.xlength() != b.xlength() || a.ylength() != b.ylength())
+		return false;
+	for(size_t i = 0; i < a.size(); ++i){
+		auto da = a.get(i), db = b.get(i);
+		if(da.x.toVector() != db.x.toVector() || da.y.toVector() != db.y.toVector())
+			return false;
+	}
+	return true;
+}
+
+DataHolder loadData(const string& fn, const bool cache, const size_t npart, const size_t pid,
+	const string& dir = "")
+{
+	DataLoader dl;
+	dl.init("csv", npart, pid, true);
+	dl.setCache(cache, dir);
+	dl.bindParameterTable(",", { 0 }, { 9 }, true);
+	return dl.load(fn, true);
+}
+
+int main(int argc, char* argv[]){
+	string prefix = argc > 1 ? argv[1] : "E:/Code/FSB/dataset/";
+	string name = argc > 2 ? argv[2] : "affairs.csv";
+	string fn = prefix + name;
+	bool ok = true;
+	try{
+		DataHolder ref = loadData(fn, false, 2, 1);
+		cout << "parsed: " << ref.size() << " points, nx=" << ref.xlength() << " ny=" << ref.ylength() << endl;
+
+		DataCacheKey key;
+		key.format = "csv";
+		key.npart = 2;
+		key.pid = 1;
+		key.localOnly = true;
+		remove(DataCache::cachePath(fn, key).c_str());
+
+		DataHolder first = loadData(fn, true, 2, 1); // parse and write the cache
+		DataHolder second = loadData(fn, true, 2, 1); // map the cache
+		cout << "first run mapped: " << first.isMapped() << "\tsecond run mapped: " << second.isMapped() << endl;
+		bool b = second.isMapped() && sameData(ref, first) && sameData(ref, second);
+		ok &= b;
+		cout << "same as parsed: " << sameData(ref, first) << "\t" << sameData(ref, second) << (b ? " ok" : " FAILED") << endl;
+
+		// other partition has its own cache
+		DataHolder other = loadData(fn, true, 2, 0);
+		b = other.isMapped() && sameData(loadData(fn, false, 2, 0), other);
+		ok &= b;
+		cout << "other partition mapped: " << other.isMapped() << (b ? " ok" : " FAILED") << endl;
+
+		// in-memory modifications do not touch the cache file
+		second.normalize(false);
+		DataHolder third = loadData(fn, true, 2, 1);
+		b = third.isMapped() && sameData(ref, third);
+		ok &= b;
+		cout << "cache intact after normalize" << (b ? " ok" : " FAILED") << endl;
+
+		// a copy of mapped data owns its data
+		DataHolder copy = third;
+		third.normalize(false);
+		b = !copy.isMapped() && sameData(ref, copy) && !sameData(ref, third);
+		ok &= b;
+		cout << "copy unchanged after normalize" << (b ? " ok" : " FAILED") << endl;
+
+		// a cache directory, nothing is written next to the data file
+		const string dir = "data-cache-dir";
+		mkdir(dir.c_str(), 0755);
+		key.pid = 0;
+		remove(DataCache::cachePath(fn, key).c_str());
+		key.dir = dir;
+		remove(DataCache::cachePath(fn, key).c_str());
+		DataHolder d1 = loadData(fn, true, 2, 0, dir);
+		DataHolder d2 = loadData(fn, true, 2, 0, dir);
+		key.dir.clear();
+		b = d2.isMapped() && sameData(d1, d2) && !ifstream(DataCache::cachePath(fn, key));
+		key.dir = dir;
+		remove(DataCache::cachePath(fn, key).c_str());
+		rmdir(dir.c_str());
+		ok &= b;
+		cout << "cache directory" << (b ? " ok" : " FAILED") << endl;
+
+		// leave nothing next to the data file
+		key.dir.clear();
+		key.pid = 1;
+		remove(DataCache::cachePath(fn, key).c_str());
+	}catch(exception& e){
+		cerr << "load error:\n" << e.what() << endl;
+		return 1;
+	}
+	return ok ? 0 : 1;
+}
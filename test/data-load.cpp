@@ -5,8 +5,8 @@
 
 using namespace std;
 
-void showLine(const DataPoint& d){
-	for(const auto& line : d.x)
+void showLine(const DataPointView& d){
+	for(const auto line : d.x)
 		for(const auto& v : line)
 			cout << v << ", ";
 	for(const auto& v : d.y)
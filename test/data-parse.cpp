@@ -0,0 +1,122 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+#include "data/DataLoader.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// compare the parallel parser of DataLoader with the line-by-line parser of DataHolder::load
+
+bool sameData(const DataHolder& a, const DataHolder& b){
+	if(a.size() != b.size() || a.xlength() != b.xlength() || a.ylength() != b.ylength()){
+		cout << "  size: " << a.size() << " vs " << b.size() << endl;
+		return false;
+	}
+	for(size_t i = 0; i < a.size(); ++i){
+		auto da = a.get(i), db = b.get(i);
+		if(da.x.toVector() != db.x.toVector() || da.y.toVector() != db.y.toVector()){
+			cout << "  differ at " << i << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool check(const string& fn, const vector<int>& skips, const vector<int>& yIds, const bool header,
+	const size_t npart, const size_t pid, const size_t topk, const size_t nthread)
+{
+	Timer tmr;
+	DataHolder ref(npart, pid);
+	ref.load(fn, ",", skips, yIds, header, npart != 1, topk);
+	double t0 = tmr.elapseSd();
+
+	tmr.restart();
+	DataLoader dl;
+	dl.init("csv", npart, pid, npart != 1);
+	dl.setCache(false);
+	dl.setThreads(nthread);
+	dl.bindParameterTable(",", skips, yIds, header);
+	DataHolder dh = dl.load(fn, true, topk);
+	double t1 = tmr.elapseSd();
+
+	bool res = sameData(ref, dh);
+	cout << "part " << pid << "/" << npart << " topk=" << topk << " threads=" << nthread
+		<< " points=" << dh.size() << " time: " << t0 << " vs " << t1 << (res ? " ok" : " FAILED") << endl;
+	return res;
+}
+
+// the byte-range parts, put together in order, are the whole file
+bool checkByteRange(const string& fn, const size_t npart, const size_t nthread){
+	DataLoader dl;
+	dl.init("csv", 1, 0, false);
+	dl.setCache(false);
+	dl.bindParameterTable(",", { 0 }, { 9 }, true);
+	DataHolder ref = dl.load(fn, true);
+
+	DataHolder all(1, 0);
+	for(size_t pid = 0; pid < npart; ++pid){
+		DataLoader dlp;
+		dlp.init("csv", npart, pid, true);
+		dlp.setCache(false);
+		dlp.setThreads(nthread);
+		dlp.setByteRangePartition(true);
+		dlp.bindParameterTable(",", { 0 }, { 9 }, true);
+		DataHolder dh = dlp.load(fn, true);
+		cout << "  byte-range part " << pid << "/" << npart << ": " << dh.size() << " points" << endl;
+		for(size_t i = 0; i < dh.size(); ++i)
+			all.add(dh.get(i).toDataPoint());
+	}
+	bool res = sameData(ref, all);
+	cout << "byte-range " << npart << " parts threads=" << nthread << (res ? " ok" : " FAILED") << endl;
+	return res;
+}
+
+// a malformed line is an error, and no cache file is left behind
+bool checkMalformed(const size_t nthread, const bool cache){
+	const string fn = "data-parse-bad.csv";
+	{
+		ofstream fout(fn);
+		for(int i = 0; i < 1000; ++i)
+			fout << i << "," << i * 0.5 << (i == 700 ? ",x" : ",1") << "\n";
+	}
+	DataLoader dl;
+	dl.init("csv", 1, 0, false);
+	dl.setCache(cache);
+	dl.setThreads(nthread);
+	dl.bindParameterTable(",", {}, { 2 }, false);
+	bool thrown = false;
+	try{
+		dl.load(fn, true);
+	}catch(invalid_argument& e){
+		thrown = string(e.what()).find("700,350,x") != string::npos;
+	}
+	bool res = thrown && !ifstream(fn + ".cache") && !ifstream(fn + ".cache.tmp" + to_string(getpid()));
+	remove(fn.c_str());
+	cout << "malformed line threads=" << nthread << " cache=" << cache << (res ? " ok" : " FAILED") << endl;
+	return res;
+}
+
+int main(int argc, char* argv[]){
+	string prefix = argc > 1 ? argv[1] : "E:/Code/FSB/dataset/";
+	string name = argc > 2 ? argv[2] : "affairs.csv";
+	string fn = prefix + name;
+	bool ok = true;
+	try{
+		ok &= check(fn, { 0 }, { 9 }, true, 1, 0, 0, 1);
+		ok &= check(fn, { 0 }, { 9 }, true, 1, 0, 0, 0);
+		ok &= check(fn, { 0, 3 }, { 1, 9 }, true, 1, 0, 0, 4);
+		ok &= check(fn, { 0 }, { 9 }, true, 3, 1, 0, 4);
+		ok &= check(fn, { 0 }, { 9 }, true, 3, 2, 100, 4);
+		ok &= checkByteRange(fn, 1, 0);
+		ok &= checkByteRange(fn, 5, 3);
+		ok &= checkMalformed(1, false);
+		ok &= checkMalformed(4, true);
+	}catch(exception& e){
+		cerr << "load error:\n" << e.what() << endl;
+		return 1;
+	}
+	return ok ? 0 : 1;
+}
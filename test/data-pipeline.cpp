@@ -0,0 +1,83 @@
+#include <iostream>
+#include <string>
+#include <cmath>
+#include "data/DataLoader.h"
+#include "data/BatchPipeline.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// walk through the data in mini-batches like a worker does, with and without the pipeline.
+// a new order is drawn in each epoch
+
+double work(const DataPointView& dp){
+	double s = 0.0;
+	for(auto unit : dp.x)
+		s += unit.dot(unit.toVector().data());
+	return s + dp.y[0];
+}
+
+bool run(const DataHolder& dh, const size_t batch, const size_t nbatch, DataOrder& order){
+	vector<double> ref, res;
+	Timer tmr;
+	size_t p = 0;
+	for(size_t b = 0; b < nbatch; ++b){
+		size_t end = min(p + batch, dh.size());
+		for(size_t i = p; i < end; ++i)
+			ref.push_back(work(dh.get(order[i])));
+		p = end == dh.size() ? 0 : end;
+		if(p == 0)
+			order.shuffle();
+	}
+	double t0 = tmr.elapseSd();
+
+	tmr.restart();
+	order.init(dh.size(), order.getMode(), 64, 1); // the same orders again
+	BatchPipeline pipe(&dh, true, &order);
+	p = 0;
+	for(size_t b = 0; b < nbatch; ++b){
+		size_t end = min(p + batch, dh.size());
+		const DataHolder& bt = pipe.fetch(p, end - p);
+		for(size_t i = 0; i < end - p; ++i)
+			res.push_back(work(bt.get(i)));
+		p = end == dh.size() ? 0 : end;
+		if(p == 0){
+			pipe.invalidate();
+			order.shuffle();
+		}
+	}
+	double t1 = tmr.elapseSd();
+	// a dequantized batch goes through the SIMD dot product, which sums in another order
+	bool ok = ref.size() == res.size();
+	for(size_t i = 0; ok && i < ref.size(); ++i)
+		ok = abs(ref[i] - res[i]) <= 1e-12 * (1 + abs(ref[i]));
+	cout << "type=" << dtypeName(dh.dataType()) << " order=" << static_cast<int>(order.getMode())
+		<< " batch=" << batch << " time: " << t0 << " vs " << t1 << " hit=" << pipe.hitCount() << " miss=" << pipe.missCount() << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	string prefix = argc > 1 ? argv[1] : "E:/Code/FSB/dataset/";
+	string name = argc > 2 ? argv[2] : "affairs.csv";
+	size_t batch = argc > 3 ? stoul(argv[3]) : 1000;
+	try{
+		DataLoader dl;
+		dl.init("csv", 1, 0, false);
+		dl.bindParameterTable(",", { 0 }, { 9 }, true);
+		DataHolder dh = dl.load(prefix + name, true);
+		size_t nbatch = 3 * dh.size() / batch;
+		bool ok = true;
+		DataOrder order;
+		for(auto m : { DataOrder::Mode::Sequential, DataOrder::Mode::Point, DataOrder::Mode::Block }){
+			order.init(dh.size(), m, 64, 1);
+			ok &= run(dh, batch, nbatch, order);
+		}
+		dh.convert(DType::UInt8);
+		order.init(dh.size(), DataOrder::Mode::Block, 64, 1);
+		ok &= run(dh, batch, nbatch, order);
+		return ok ? 0 : 1;
+	}catch(exception& e){
+		cerr << "error:\n" << e.what() << endl;
+		return 1;
+	}
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <string>
+#include <cmath>
+#include "data/DataLoader.h"
+
+using namespace std;
+
+// compare the reduced-precision storage types with the double one, and the conversion while parsing
+// with the one after loading
+
+// the largest error of a value in [-1, 1]: half a step of the 8-bit types, the rounding of float
+double errorBound(const DType t){
+	return t == DType::UInt8 ? 1.0 / 255 : t == DType::Int8 ? 0.5 / 127 : 1.0 / (1 << 24);
+}
+
+bool sameData(const DataHolder& a, const DataHolder& b){
+	if(a.size() != b.size() || a.dataType() != b.dataType() || a.memoryBytes() != b.memoryBytes())
+		return false;
+	for(size_t i = 0; i < a.size(); ++i)
+		if(a.get(i).x.toVector() != b.get(i).x.toVector() || a.get(i).y.toVector() != b.get(i).y.toVector())
+			return false;
+	return true;
+}
+
+bool check(const DataHolder& ref, const string& name){
+	DataHolder dh = ref;
+	dh.convert(parseDType(name));
+	double maxErr = 0.0, dotErr = 0.0;
+	vector<double> w(ref.xlength(), 0.5);
+	for(size_t i = 0; i < ref.size(); ++i){
+		auto a = ref.get(i).x[0], b = dh.get(i).x[0];
+		for(size_t j = 0; j < a.size(); ++j)
+			maxErr = max(maxErr, fabs(a[j] - b[j]));
+		// the fused dot product is the same as reading values one by one
+		double t = 0.0;
+		for(size_t j = 0; j < b.size(); ++j)
+			t += b[j] * w[j];
+		dotErr = max(dotErr, fabs(t - b.dot(w.data())));
+		if(a.size() != b.size() || dh.get(i).y.toVector() != ref.get(i).y.toVector()){
+			cout << name << ": differ at " << i << endl;
+			return false;
+		}
+	}
+	// the data is normalized, so each column spans [-1, 1]
+	bool ok = dotErr < 1e-9 && maxErr <= errorBound(parseDType(name)) * (1 + 1e-9);
+	cout << name << ": points=" << dh.size() << " bytes=" << dh.memoryBytes() << " (double: " << ref.memoryBytes()
+		<< ") max error=" << maxErr << " (bound " << errorBound(parseDType(name)) << ") dot error=" << dotErr
+		<< (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+bool checkLoad(const string& fn, const DataHolder& ref, const string& name, const size_t nthread){
+	DataLoader dl;
+	dl.init("csv", 1, 0, false);
+	dl.setCache(false);
+	dl.setThreads(nthread);
+	dl.setDataType(parseDType(name), true);
+	dl.bindParameterTable(",", { 0 }, { 9 }, true);
+	DataHolder dh = dl.load(fn, true);
+	DataHolder conv = ref;
+	conv.convert(parseDType(name));
+	bool ok = sameData(conv, dh);
+	cout << name << ": converted while parsing, threads=" << nthread << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	string prefix = argc > 1 ? argv[1] : "E:/Code/FSB/dataset/";
+	string name = argc > 2 ? argv[2] : "affairs.csv";
+	try{
+		DataLoader dl;
+		dl.init("csv", 1, 0, false);
+		dl.setCache(false);
+		dl.bindParameterTable(",", { 0 }, { 9 }, true);
+		DataHolder ref = dl.load(prefix + name, true);
+		ref.normalize(false);
+		bool ok = true;
+		for(string t : { "float", "uint8", "int8" }){
+			ok &= check(ref, t);
+			ok &= checkLoad(prefix + name, ref, t, 1);
+			ok &= checkLoad(prefix + name, ref, t, 0);
+		}
+		return ok ? 0 : 1;
+	}catch(exception& e){
+		cerr << "error:\n" << e.what() << endl;
+		return 1;
+	}
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <random>
+#include <cmath>
+#include "data/DataLoader.h"
+#include "model/app/LogisticRegression.h"
+
+using namespace std;
+
+// generate a libsvm file, load it as sparse data and compare with the dense version
+
+vector<DataPoint> generate(const string& fn, const size_t n, const size_t dim, const double density){
+	mt19937 gen(1);
+	uniform_real_distribution<double> val(-1.0, 1.0);
+	bernoulli_distribution nz(density);
+	vector<DataPoint> res;
+	ofstream fout(fn);
+	fout.precision(17);
+	for(size_t i = 0; i < n; ++i){
+		DataPoint dp{ { vector<double>(dim, 0.0) }, { static_cast<double>(i % 2) } };
+		fout << dp.y[0];
+		for(size_t j = 0; j < dim; ++j){
+			if(nz(gen)){
+				dp.x[0][j] = val(gen);
+				fout << " " << j + 1 << ":" << dp.x[0][j];
+			}
+		}
+		fout << "\n";
+		res.push_back(move(dp));
+	}
+	return res;
+}
+
+bool check(const DataHolder& dh, const DataHolder& ref){
+	if(dh.size() != ref.size() || dh.xlength() != ref.xlength()){
+		cout << "  size: " << dh.size() << " vs " << ref.size() << endl;
+		return false;
+	}
+	for(size_t i = 0; i < dh.size(); ++i){
+		if(dh.get(i).x.toVector() != ref.get(i).x.toVector() || dh.get(i).y.toVector() != ref.get(i).y.toVector()){
+			cout << "  differ at " << i << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]){
+	string prefix = argc > 1 ? argv[1] : "./";
+	size_t n = argc > 2 ? stoul(argv[2]) : 1000;
+	size_t dim = argc > 3 ? stoul(argv[3]) : 10000;
+	string fn = prefix + "sparse.libsvm";
+	vector<DataPoint> data = generate(fn, n, dim, 0.01);
+	bool ok = true;
+	try{
+		DataLoader dl;
+		dl.init("libsvm", 1, 0, false);
+		DataHolder dh = dl.load(fn, true);
+		DataHolder ref;
+		for(auto& dp : data)
+			ref.add(dp);
+		cout << "points: " << dh.size() << " dim: " << dh.xlength()
+			<< " bytes: " << dh.memoryBytes() << " (dense: " << ref.memoryBytes() << ")" << endl;
+		ok &= check(dh, ref);
+
+		// byte-range parts put together
+		DataHolder all(1, 0, false, true);
+		all.setLength(dh.xlength(), 1);
+		for(size_t pid = 0; pid < 3; ++pid){
+			DataLoader dlp;
+			dlp.init("libsvm", 3, pid, true);
+			dlp.setByteRangePartition(true);
+			DataHolder part = dlp.load(fn, true);
+			ok &= part.xlength() == dh.xlength();
+			for(size_t i = 0; i < part.size(); ++i)
+				all.add(part.get(i).toDataPoint());
+		}
+		bool res = check(all, dh);
+		cout << "byte-range parts: " << (res ? "ok" : "FAILED") << endl;
+		ok &= res;
+
+		// sparse and dense gradients of LR
+		LogisticRegression lr;
+		lr.init(to_string(dh.xlength()));
+		vector<double> w(lr.lengthParameter());
+		for(size_t i = 0; i < w.size(); ++i)
+			w[i] = sin(static_cast<double>(i));
+		vector<double> gs(w.size()), gd(w.size());
+		for(size_t i = 0; i < dh.size(); ++i){
+			lr.accumulateGradient(dh.get(i).x, w, dh.get(i).y, gs);
+			vector<double> g = lr.gradient(ref.get(i).x, w, ref.get(i).y);
+			for(size_t j = 0; j < g.size(); ++j)
+				gd[j] += g[j];
+		}
+		double err = 0.0;
+		for(size_t j = 0; j < w.size(); ++j)
+			err = max(err, fabs(gs[j] - gd[j]));
+		cout << "LR gradient max difference: " << err << endl;
+		ok &= err < 1e-9;
+	}catch(exception& e){
+		cerr << "error:\n" << e.what() << endl;
+		return 1;
+	}
+	cout << (ok ? "ok" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
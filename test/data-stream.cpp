@@ -0,0 +1,142 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <random>
+#include <stdexcept>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "data/DataLoader.h"
+#include "data/DataCache.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+string residentMemory(){
+	ifstream fin("/proc/self/status");
+	string line;
+	while(getline(fin, line))
+		if(line.compare(0, 6, "VmRSS:") == 0)
+			return line.substr(6);
+	return "unknown";
+}
+
+// scan all data points in batches, like a worker does
+double scan(const DataHolder& dh, const size_t batch, const size_t nepoch){
+	double sum = 0.0;
+	for(size_t e = 0; e < nepoch; ++e){
+		for(size_t start = 0; start < dh.size(); start += batch){
+			dh.hint(start, batch);
+			size_t end = min(start + batch, dh.size());
+			for(size_t i = start; i < end; ++i){
+				auto dp = dh.get(i);
+				for(auto unit : dp.x)
+					for(double v : unit)
+						sum += v;
+				for(double v : dp.y)
+					sum += v;
+			}
+		}
+	}
+	return sum;
+}
+
+// the caches are written to <dir>, so nothing is left next to the data files
+string cachePath(const string& fn, const string& dir){
+	DataCacheKey key;
+	key.dir = dir;
+	return DataCache::cachePath(fn, key);
+}
+
+// variable-length data is streamed once it comes from the cache
+bool checkList(const string& dir, const size_t chunk){
+	const string fn = dir + "/stream.list";
+	{
+		mt19937 gen(1);
+		uniform_int_distribution<int> len(0, 20);
+		uniform_real_distribution<double> val(-1.0, 1.0);
+		ofstream fout(fn);
+		for(size_t i = 0; i < 5000; ++i){
+			fout << i % 2;
+			for(int j = 2 * len(gen); j > 0; --j)
+				fout << "," << val(gen);
+			fout << "\n";
+		}
+	}
+	DataLoader dl;
+	dl.init("list", 1, 0, false);
+	dl.setCache(true, dir);
+	dl.bindParameterVarLen(",", 2, { 0 });
+	DataHolder ref = dl.load(fn, true);
+	DataHolder dh = dl.load(fn, true);
+	dh.enableStreaming(chunk / 64);
+	double s1 = scan(ref, 100, 2), s2 = scan(dh, 100, 2);
+	bool ok = dh.isMapped() && dh.isStreaming() && s1 == s2;
+	cout << "list: mapped: " << dh.isMapped() << "\tstreaming: " << dh.isStreaming()
+		<< "\tsum=" << s2 << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+// sparse data cannot be cached, streaming it is an error instead of a silent full load
+bool checkSparse(const string& dir){
+	const string fn = dir + "/stream.libsvm";
+	{
+		ofstream fout(fn);
+		fout << "1 1:0.5 7:1\n0 3:-1\n";
+	}
+	DataLoader dl;
+	dl.init("libsvm", 1, 0, false);
+	dl.setCache(true, dir);
+	dl.bindParameterSparse(0);
+	DataHolder dh = dl.load(fn, true);
+	bool ok = false;
+	try{
+		dh.enableStreaming(1 << 20);
+	} catch(invalid_argument&){
+		ok = !dh.isStreaming();
+	}
+	cout << "sparse: rejected" << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	string prefix = argc > 1 ? argv[1] : "E:/Code/FSB/dataset/";
+	string name = argc > 2 ? argv[2] : "affairs.csv";
+	size_t chunk = argc > 3 ? stoul(argv[3]) : 1 << 20;
+	const string dir = "data-stream-dir";
+	mkdir(dir.c_str(), 0755);
+	bool ok = true;
+	try{
+		DataLoader dl;
+		dl.init("csv", 1, 0, false);
+		dl.setCache(true, dir);
+		dl.bindParameterTable(",", { 0 }, { 9 }, true);
+		DataHolder ref = dl.load(prefix + name, true); // make sure the cache exists
+		DataHolder dh = dl.load(prefix + name, true);
+		cout << "points: " << dh.size() << "\tmapped: " << dh.isMapped() << endl;
+
+		Timer tmr;
+		dh.enableStreaming(chunk);
+		cout << "streaming: " << dh.isStreaming() << "\tchunk=" << chunk << endl;
+		double s2 = scan(dh, 1000, 2);
+		cout << "streaming: sum=" << s2 << "\ttime=" << tmr.elapseSd() << "\tRSS:" << residentMemory() << endl;
+
+		tmr.restart();
+		double s1 = scan(ref, 1000, 2);
+		cout << "whole: sum=" << s1 << "\ttime=" << tmr.elapseSd() << "\tRSS:" << residentMemory() << endl;
+		cout << (s1 == s2 ? "same" : "DIFFERENT") << endl;
+		ok = s1 == s2;
+		ok &= checkList(dir, chunk);
+		ok &= checkSparse(dir);
+	}catch(exception& e){
+		cerr << "load error:\n" << e.what() << endl;
+		ok = false;
+	}
+	remove(cachePath(prefix + name, dir).c_str());
+	for(const char* f : { "/stream.list", "/stream.libsvm" }){
+		remove(cachePath(dir + f, dir).c_str());
+		remove((dir + f).c_str());
+	}
+	rmdir(dir.c_str());
+	return ok ? 0 : 1;
+}
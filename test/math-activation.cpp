@@ -0,0 +1,107 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <string>
+#include "math/activation_func.h"
+#include "math/simd.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// compare the fast array activations of every SIMD level with the exact ones, and time them
+
+struct Error {
+	double exp = 0.0, sigmoid = 0.0, tanh = 0.0;
+};
+
+template <typename T>
+Error measure(const vector<T>& x){
+	const size_t n = x.size();
+	vector<T> e0(n), s0(n), t0(n), e1(n), s1(n), t1(n);
+	activation_set_mode(ActivationMode::Exact);
+	exp_array(x.data(), e0.data(), n);
+	sigmoid_array(x.data(), s0.data(), n);
+	tanh_array(x.data(), t0.data(), n);
+	activation_set_mode(ActivationMode::Fast);
+	exp_array(x.data(), e1.data(), n);
+	sigmoid_array(x.data(), s1.data(), n);
+	tanh_array(x.data(), t1.data(), n);
+	Error err;
+	for(size_t i = 0; i < n; ++i){
+		err.exp = max<double>(err.exp, abs(e0[i] - e1[i]) / e0[i]);
+		if(s0[i] > 0)
+			err.sigmoid = max<double>(err.sigmoid, abs(s0[i] - s1[i]) / s0[i]);
+		err.tanh = max<double>(err.tanh, abs(t0[i] - t1[i]));
+	}
+	return err;
+}
+
+template <typename T>
+bool check(const char* name, const Error& err, const double rel, const double abs){
+	bool ok = err.exp <= rel && err.sigmoid <= rel && err.tanh <= abs;
+	cout << "  " << name << "\texp: " << err.exp << "\tsigmoid: " << err.sigmoid
+		<< "\ttanh: " << err.tanh << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+bool special(){
+	// the tails of the vector loops, the saturated ends, the signed zero and NaN
+	bool ok = true;
+	for(size_t n = 0; n < 40; ++n){
+		vector<double> x(n, 0.5), y(n + 1, -1.0);
+		sigmoid_array(x.data(), y.data(), n);
+		for(size_t i = 0; i < n; ++i)
+			ok &= abs(y[i] - sigmoid(0.5)) < 1e-14;
+		ok &= y[n] == -1.0; // not touched
+	}
+	vector<double> x = { -1e4, 1e4, -0.0, NAN };
+	vector<double> s(x.size()), t(x.size()), e(x.size());
+	sigmoid_array(x.data(), s.data(), x.size());
+	tanh_array(x.data(), t.data(), x.size());
+	exp_array(x.data(), e.data(), x.size());
+	ok &= s[0] < 1e-300 && s[1] == 1.0 && s[2] == 0.5 && std::isnan(s[3]);
+	ok &= t[0] == -1.0 && t[1] == 1.0 && t[2] == 0.0 && signbit(t[2]) && std::isnan(t[3]);
+	ok &= e[0] < 1e-300 && e[2] == 1.0 && std::isnan(e[3]);
+	vector<float> xf(x.begin(), x.end()), sf(x.size());
+	sigmoid_array(xf.data(), sf.data(), xf.size());
+	ok &= sf[0] < 1e-30f && sf[1] == 1.0f && sf[2] == 0.5f && std::isnan(sf[3]);
+	cout << "  special values" << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	size_t n = argc > 1 ? stoul(argv[1]) : 1000;
+	size_t rep = argc > 2 ? stoul(argv[2]) : 10000;
+	mt19937 gen(1);
+	uniform_real_distribution<double> dis(-30.0, 30.0);
+	vector<double> x(max<size_t>(n, 100000));
+	for(auto& v : x)
+		v = dis(gen);
+	vector<float> xf(x.begin(), x.end());
+	vector<double> y(n);
+	bool ok = true;
+	SimdLevel best = simd_detect();
+	for(int l = 0; l <= static_cast<int>(best); ++l){
+		SimdLevel level = static_cast<SimdLevel>(l);
+		simd_set_level(level);
+		cout << simd_name(level) << endl;
+		ok &= check<double>("double", measure(x), 1e-14, 1e-15);
+		ok &= check<float>("float", measure(xf), 1e-6, 1e-6);
+		ok &= special();
+		for(ActivationMode mode : { ActivationMode::Exact, ActivationMode::Fast }){
+			activation_set_mode(mode);
+			Timer tmr;
+			for(size_t r = 0; r < rep; ++r)
+				sigmoid_array(x.data(), y.data(), n);
+			double ts = tmr.elapseSd();
+			tmr.restart();
+			for(size_t r = 0; r < rep; ++r)
+				tanh_array(x.data(), y.data(), n);
+			cout << "  " << (mode == ActivationMode::Fast ? "fast" : "exact") << "\tsigmoid time: " << ts
+				<< "\ttanh time: " << tmr.elapseSd() << endl;
+		}
+	}
+	simd_set_level(best);
+	return ok ? 0 : 1;
+}
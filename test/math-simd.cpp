@@ -0,0 +1,69 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <string>
+#include "math/simd.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// compare every SIMD level supported by this CPU with the scalar one, and time them
+
+bool check(const SimdLevel level, const vector<double>& x, const vector<double>& y){
+	bool ok = true;
+	for(size_t n : { 0, 1, 3, 7, 8, 15, 16, 17, 33, 100, 1000 }){
+		simd_set_level(SimdLevel::Scalar);
+		double d0 = simd_dot(x.data(), y.data(), n);
+		vector<double> r0(y.begin(), y.begin() + n + 1);
+		simd_axpy(0.3, x.data(), r0.data(), n);
+		simd_set_level(level);
+		double d1 = simd_dot(x.data(), y.data(), n);
+		vector<double> r1(y.begin(), y.begin() + n + 1);
+		simd_axpy(0.3, x.data(), r1.data(), n);
+		if(abs(d0 - d1) > 1e-9 * (1 + abs(d0)))
+			ok = false;
+		for(size_t i = 0; i <= n; ++i) // r[n] must not be touched
+			if(abs(r0[i] - r1[i]) > 1e-12 * (1 + abs(r0[i])))
+				ok = false;
+		// float32 versions against the double result
+		vector<float> xf(x.begin(), x.begin() + n + 1), yf(y.begin(), y.begin() + n + 1);
+		float df = simd_dot(xf.data(), yf.data(), n);
+		simd_axpy(0.3f, xf.data(), yf.data(), n);
+		if(abs(d0 - df) > 1e-4 * (sqrt(double(n)) + abs(d0)))
+			ok = false;
+		for(size_t i = 0; i <= n; ++i)
+			if(abs(r0[i] - yf[i]) > 1e-5 * (1 + abs(r0[i])))
+				ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	size_t n = argc > 1 ? stoul(argv[1]) : 1000;
+	size_t rep = argc > 2 ? stoul(argv[2]) : 100000;
+	mt19937 gen(1);
+	normal_distribution<double> dis;
+	vector<double> x(max<size_t>(n, 1001)), y(x.size());
+	for(size_t i = 0; i < x.size(); ++i){
+		x[i] = dis(gen);
+		y[i] = dis(gen);
+	}
+	bool ok = true;
+	SimdLevel best = simd_detect();
+	cout << "detected: " << simd_name(best) << endl;
+	for(int l = 0; l <= static_cast<int>(best); ++l){
+		SimdLevel level = static_cast<SimdLevel>(l);
+		bool f = check(level, x, y);
+		ok &= f;
+		simd_set_level(level);
+		Timer tmr;
+		double s = 0.0;
+		for(size_t r = 0; r < rep; ++r){
+			s += simd_dot(x.data(), y.data(), n);
+			simd_axpy(1e-9, x.data(), y.data(), n);
+		}
+		cout << simd_name(level) << "\ttime: " << tmr.elapseSd() << "\t" << s << (f ? " ok" : " FAILED") << endl;
+	}
+	return ok ? 0 : 1;
+}
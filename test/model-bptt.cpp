@@ -0,0 +1,115 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <cmath>
+#include "model/app/RNN.h"
+#include "math/activation_func.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// check the sequence mode of RNN: the BPTT gradient against finite differences,
+// a batch against one sequence at a time, and time the full and the truncated backward passes
+
+struct Data {
+	vector<vector<double>> x, y;
+	vector<DataPointView> dps;
+};
+
+Data make(const size_t n, const size_t nx, const size_t ny, const size_t maxLen, mt19937& gen){
+	uniform_real_distribution<double> dis(-1.0, 1.0);
+	uniform_int_distribution<size_t> dl(0, maxLen);
+	Data d;
+	for(size_t i = 0; i < n; ++i){
+		d.x.emplace_back(dl(gen) * nx);
+		for(auto& v : d.x.back())
+			v = dis(gen);
+		d.y.emplace_back(ny);
+		for(auto& v : d.y.back())
+			v = dis(gen) > 0 ? 1.0 : 0.0;
+	}
+	for(size_t i = 0; i < n; ++i)
+		d.dps.push_back({ FeatureListView(d.x[i].data(), d.x[i].size() / nx, nx), FeatureView(d.y[i]) });
+	return d;
+}
+
+double maxDiff(const vector<double>& a, const vector<double>& b, double& mx){
+	double diff = 0.0;
+	mx = 0.0;
+	for(size_t i = 0; i < a.size(); ++i){
+		diff = max(diff, abs(a[i] - b[i]));
+		mx = max(mx, abs(a[i]));
+	}
+	return diff;
+}
+
+int main(int argc, char* argv[]){
+	size_t npoint = argc > 1 ? stoul(argv[1]) : 512;
+	size_t maxLen = argc > 2 ? stoul(argv[2]) : 200;
+	size_t trunc = argc > 3 ? stoul(argv[3]) : 10;
+	const string shape = "6-1rt5-3rs4-2f";
+	mt19937 gen(1);
+	bool ok = true;
+
+	RNN m;
+	m.init(shape + "-seq");
+	vector<double> w(m.lengthParameter());
+	uniform_real_distribution<double> dis(-0.5, 0.5);
+	for(auto& v : w)
+		v = dis(gen);
+
+	// finite differences on a few sequences
+	activation_set_mode(ActivationMode::Exact);
+	Data small = make(4, 6, 2, 12, gen);
+	double fdDiff = 0.0;
+	for(auto& dp : small.dps){
+		vector<double> g(w.size(), 0.0), pred;
+		m.lossAndGradient(dp.x, w, dp.y, g, &pred);
+		vector<double> p0 = m.predict(dp.x, w);
+		for(size_t i = 0; i < p0.size(); ++i)
+			ok &= p0[i] == pred[i];
+		// like the per-line mode, the gradient is the one of 0.5 * loss
+		const double eps = 1e-6;
+		for(size_t i = 0; i < w.size(); ++i){
+			vector<double> wp(w), wm(w);
+			wp[i] += eps;
+			wm[i] -= eps;
+			double fd = (m.loss(m.predict(dp.x, wp), dp.y) - m.loss(m.predict(dp.x, wm), dp.y)) / (4 * eps);
+			fdDiff = max(fdDiff, abs(fd - g[i]) / (1e-4 + abs(fd)));
+		}
+	}
+	ok &= fdDiff < 1e-5;
+	cout << "finite difference: " << fdDiff << (fdDiff < 1e-5 ? " ok" : " FAILED") << endl;
+	activation_set_mode(ActivationMode::Fast);
+
+	// a batch against one sequence at a time, without and with truncation
+	Data d = make(npoint, 6, 2, maxLen, gen);
+	for(size_t t : { size_t(0), trunc }){
+		RNN mt;
+		mt.init(shape + "-seq" + (t != 0 ? ":" + to_string(t) : ""));
+		vector<double> g1(w.size(), 0.0), gb(w.size(), 0.0), l1(npoint), lb(npoint);
+		Timer tmr;
+		for(size_t i = 0; i < npoint; ++i)
+			l1[i] = mt.lossAndGradient(d.dps[i].x, w, d.dps[i].y, g1);
+		double t1 = tmr.elapseSd();
+		tmr.restart();
+		mt.batchGradient(d.dps.data(), npoint, w, gb, lb.data());
+		double tb = tmr.elapseSd();
+		double mx, ml;
+		double diff = maxDiff(g1, gb, mx);
+		double dl = maxDiff(l1, lb, ml);
+		bool f = diff <= 1e-10 * (1.0 + mx) && dl <= 1e-12 * (1.0 + ml);
+		ok &= f;
+		cout << "truncation " << t << "\tone by one: " << t1 << "\tbatch: " << tb
+			<< "\tmax diff: " << diff << (f ? " ok" : " FAILED") << endl;
+	}
+	// per-line mode for reference
+	RNN ml;
+	ml.init(shape);
+	vector<double> gl(w.size(), 0.0);
+	Timer tmr;
+	ml.batchGradient(d.dps.data(), npoint, w, gl);
+	cout << "per-line mode: " << tmr.elapseSd() << endl;
+	return ok ? 0 : 1;
+}
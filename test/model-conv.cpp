@@ -0,0 +1,89 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <cmath>
+#include "model/impl/NodeBase.h"
+
+using namespace std;
+
+// check the gradients of the convolution nodes against finite differences of sum(pre * y)
+
+struct Case {
+	NodeType type;
+	vector<int> shape; // node shape
+	vector<int> in; // input shape
+};
+
+double objective(const NodeBase* node, const vector<double>& x, const vector<double>& w,
+	const vector<double>& pre)
+{
+	vector<double> y(node->nout);
+	node->predict(x.data(), w.data(), y.data(), nullptr);
+	double r = 0.0;
+	for(size_t i = 0; i < y.size(); ++i)
+		r += pre[i] * y[i];
+	return r;
+}
+
+bool run(const Case& c, mt19937& gen){
+	// the weights of the node do not start at 0, the entries around them must stay untouched
+	const size_t off = 3;
+	NodeBase* node = generateNode(c.type, off, c.shape);
+	node->setInputShape(c.in);
+	uniform_real_distribution<double> dis(-1.0, 1.0);
+	vector<double> x(node->nin), w(off + node->nweight() + 2), pre(node->nout);
+	for(auto& v : x)
+		v = dis(gen);
+	for(auto& v : w)
+		v = dis(gen);
+	for(auto& v : pre)
+		v = dis(gen);
+	vector<double> y(node->nout), grad(w.size(), 0.0), dx(x.size(), 0.0);
+	node->predict(x.data(), w.data(), y.data(), nullptr);
+	node->gradient(grad.data(), x.data(), w.data(), y.data(), pre.data(), dx.data(), nullptr);
+
+	// the objective is linear in each of x and w, so the central difference is exact up to rounding
+	const double eps = 1e-3;
+	double diff = 0.0;
+	for(size_t i = 0; i < w.size(); ++i){
+		vector<double> wp(w), wm(w);
+		wp[i] += eps;
+		wm[i] -= eps;
+		double fd = i < off || i >= off + node->nweight() ? 0.0
+			: (objective(node, x, wp, pre) - objective(node, x, wm, pre)) / (2 * eps);
+		diff = max(diff, abs(fd - grad[i]) / (1.0 + abs(fd)));
+	}
+	for(size_t i = 0; i < x.size(); ++i){
+		vector<double> xp(x), xm(x);
+		xp[i] += eps;
+		xm[i] -= eps;
+		double fd = (objective(node, xp, w, pre) - objective(node, xm, w, pre)) / (2 * eps);
+		diff = max(diff, abs(fd - dx[i]) / (1.0 + abs(fd)));
+	}
+	bool ok = diff < 1e-9;
+	string s;
+	for(int v : c.shape)
+		s += to_string(v) + " ";
+	cout << c.in.size() << "D shape: " << s << "\tmax diff: " << diff << (ok ? " ok" : " FAILED") << endl;
+	delete node;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	mt19937 gen(1);
+	// output rows of 1, odd and SIMD-multiple lengths
+	vector<Case> cases = {
+		{ NodeType::Conv1D, { 1 }, { 7 } },
+		{ NodeType::Conv1D, { 4 }, { 23 } },
+		{ NodeType::Conv2D, { 5, 5, 5, 5 }, { 5, 5 } },
+		{ NodeType::Conv2D, { 9, 12, 3, 4 }, { 9, 12 } },
+		{ NodeType::Conv2D, { 28, 28, 5, 5 }, { 28, 28 } },
+		{ NodeType::Conv3D, { 4, 5, 6, 2, 3, 3 }, { 4, 5, 6 } },
+		{ NodeType::Conv3D, { 6, 7, 11, 3, 2, 4 }, { 6, 7, 11 } },
+	};
+	bool ok = true;
+	for(const Case& c : cases)
+		ok &= run(c, gen);
+	return ok ? 0 : 1;
+}
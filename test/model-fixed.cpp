@@ -0,0 +1,105 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <memory>
+#include <typeinfo>
+#include <cmath>
+#include "model/KernelFactory.h"
+#include "model/app/MLPFixed.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// compare the kernels of fixed shapes made by KernelFactory with the generic ones, and time them
+
+double maxDiff(const vector<double>& a, const vector<double>& b, double& mx){
+	double diff = 0.0;
+	mx = 0.0;
+	for(size_t i = 0; i < a.size(); ++i){
+		diff = max(diff, abs(a[i] - b[i]));
+		mx = max(mx, abs(a[i]));
+	}
+	return diff;
+}
+
+bool run(const string& param, const size_t npoint, const int rep){
+	unique_ptr<Kernel> g(KernelFactory::generate("mlp"));
+	unique_ptr<Kernel> f(KernelFactory::generate("mlp", param));
+	g->init(param);
+	f->init(param);
+	if(typeid(*f) == typeid(MLP)){
+		cout << param << "\tnot specialized FAILED" << endl;
+		return false;
+	}
+	const vector<int> shape = getIntList(param, ",");
+	const size_t nx = shape.front(), ny = shape.back();
+	mt19937 gen(1);
+	uniform_real_distribution<double> dis(-1.0, 1.0);
+	vector<double> w(g->lengthParameter());
+	for(auto& v : w)
+		v = 0.1 * dis(gen);
+	// sparse-ish inputs like images
+	vector<vector<double>> xs(npoint, vector<double>(nx)), ys(npoint, vector<double>(ny, 0.0));
+	vector<DataPointView> dps;
+	for(size_t i = 0; i < npoint; ++i){
+		for(auto& v : xs[i])
+			v = dis(gen) > 0.5 ? dis(gen) : 0.0;
+		ys[i][i % ny] = 1.0;
+		dps.push_back({ FeatureListView(xs[i]), FeatureView(ys[i]) });
+	}
+	bool ok = true;
+	for(bool fp32 : { false, true }){
+		g->setFloat32(fp32);
+		f->setFloat32(fp32);
+		vector<double> gg(w.size(), 0.0), gf(w.size(), 0.0), lg(npoint), lf(npoint);
+		Timer tmr;
+		for(int r = 0; r < rep; ++r)
+			g->batchGradient(dps.data(), npoint, w, gg, lg.data());
+		double tg = tmr.elapseSd();
+		tmr.restart();
+		for(int r = 0; r < rep; ++r)
+			f->batchGradient(dps.data(), npoint, w, gf, lf.data());
+		double tf = tmr.elapseSd();
+		double mx, ml;
+		double diff = maxDiff(gg, gf, mx);
+		double dl = maxDiff(lg, lf, ml);
+		// the sums are done in another order
+		bool b = diff <= 1e-10 * (1.0 + mx) && dl <= 1e-10 * (1.0 + ml);
+		ok &= b;
+		cout << param << (fp32 ? "\tfloat32" : "\tdouble") << "\tgeneric: " << tg << "\tfixed: " << tf
+			<< "\tmax diff: " << diff << (b ? " ok" : " FAILED") << endl;
+	}
+	double diff = 0.0;
+	Timer tmr;
+	vector<vector<double>> pg;
+	for(size_t i = 0; i < npoint; ++i)
+		pg.push_back(g->predict(dps[i].x, w));
+	double tg = tmr.elapseSd();
+	tmr.restart();
+	for(size_t i = 0; i < npoint; ++i){
+		vector<double> p = f->predict(dps[i].x, w);
+		for(size_t j = 0; j < ny; ++j)
+			diff = max(diff, abs(p[j] - pg[i][j]));
+	}
+	double tf = tmr.elapseSd();
+	ok &= diff <= 1e-12;
+	cout << param << "\tpredict\tgeneric: " << tg << "\tfixed: " << tf
+		<< "\tmax diff: " << diff << (diff <= 1e-12 ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	size_t npoint = argc > 1 ? stoul(argv[1]) : 256;
+	int rep = argc > 2 ? stoi(argv[2]) : 10;
+	bool ok = true;
+	// all the registered shapes
+	for(const char* param : { "784,300,10", "784,100,10", "784,500,300,10" })
+		ok &= run(param, npoint, rep);
+	// unregistered shapes fall back to the generic kernel
+	unique_ptr<Kernel> k(KernelFactory::generate("mlp", "20,16,1"));
+	bool generic = typeid(*k) == typeid(MLP);
+	ok &= generic;
+	cout << "20,16,1\tgeneric kernel" << (generic ? " ok" : " FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include "data/DataHolder.h"
+#include "model/Model.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// compare the mini-batch gradient of a kernel computed in double and in float32, and time them
+
+int main(int argc, char* argv[]){
+	string name = argc > 1 ? argv[1] : "mlp";
+	string param = argc > 2 ? argv[2] : "100,64,32,1";
+	size_t npoint = argc > 3 ? stoul(argv[3]) : 2000;
+	int rep = argc > 4 ? stoi(argv[4]) : 5;
+
+	Model m;
+	m.init(name, param, 123456u);
+	size_t nx = stoul(param.substr(0, param.find_first_of(",-")));
+	mt19937 gen(1);
+	uniform_real_distribution<double> dis(-1.0, 1.0);
+	DataHolder dh(1, 0);
+	dh.setLength(nx, 1);
+	for(size_t i = 0; i < npoint; ++i){
+		vector<double> x(nx);
+		for(auto& v : x)
+			v = dis(gen);
+		dh.add(move(x), { dis(gen) > 0 ? 1.0 : 0.0 });
+	}
+	m.checkData(dh.xlength(), dh.ylength());
+	vector<DataPointView> dps;
+	for(size_t i = 0; i < npoint; ++i)
+		dps.push_back(dh.get(i));
+
+	vector<double> g64, g32, l64(npoint), l32(npoint);
+	double t64 = 0.0, t32 = 0.0;
+	for(int r = 0; r < rep; ++r){
+		m.setFloat32(false);
+		g64.assign(m.paramWidth(), 0.0);
+		Timer tmr;
+		m.batchGradient(dps.data(), npoint, g64, l64.data());
+		t64 += tmr.elapseSd();
+		if(!m.setFloat32(true)){
+			cout << name << " has no float32 version" << endl;
+			return 0;
+		}
+		g32.assign(m.paramWidth(), 0.0);
+		tmr.restart();
+		m.batchGradient(dps.data(), npoint, g32, l32.data());
+		t32 += tmr.elapseSd();
+	}
+	double diff = 0.0, norm = 0.0, ldiff = 0.0, lsum = 0.0;
+	for(size_t i = 0; i < g64.size(); ++i){
+		diff += (g64[i] - g32[i]) * (g64[i] - g32[i]);
+		norm += g64[i] * g64[i];
+	}
+	for(size_t i = 0; i < npoint; ++i){
+		ldiff += abs(l64[i] - l32[i]);
+		lsum += l64[i];
+	}
+	double rg = sqrt(diff / norm), rl = ldiff / lsum;
+	bool ok = rg < 1e-4 && rl < 1e-4;
+	cout << name << "\tdouble: " << t64 / rep << "\tfloat32: " << t32 / rep
+		<< "\trelative error of gradient: " << rg << " loss: " << rl << (ok ? " ok" : " FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include "data/DataHolder.h"
+#include "model/Model.h"
+#include "train/PSGD.h"
+#include "train/EM_KMeans.h"
+#include "util/Timer.h"
+#include <atomic>
+
+using namespace std;
+
+// run k-means with the bounded assignment and check every assignment against a full scan (predict).
+// then run it with PSGD, which keeps no hidden state: each trained point is added to its center.
+// last, EM_KMeans goes over the data in a random order with the hidden states of the right points
+
+int main(int argc, char* argv[]){
+	size_t n = argc > 1 ? stoul(argv[1]) : 20000;
+	size_t k = argc > 2 ? stoul(argv[2]) : 100;
+	size_t d = argc > 3 ? stoul(argv[3]) : 16;
+	int niter = argc > 4 ? stoi(argv[4]) : 20;
+
+	// points around <k> random centers
+	mt19937 gen(1);
+	uniform_real_distribution<double> ud(-10.0, 10.0);
+	normal_distribution<double> nd(0.0, 1.0);
+	vector<vector<double>> centers(k, vector<double>(d));
+	for(auto& c : centers)
+		for(auto& v : c)
+			v = ud(gen);
+	DataHolder dh(1, 0);
+	dh.setLength(d, 0);
+	for(size_t i = 0; i < n; ++i){
+		const vector<double>& c = centers[gen() % k];
+		vector<double> x(d);
+		for(size_t j = 0; j < d; ++j)
+			x[j] = c[j] + nd(gen);
+		dh.add(move(x), {});
+	}
+
+	Model m;
+	m.init("km", to_string(k) + "," + to_string(d), 0.0);
+	m.checkData(dh.xlength(), dh.ylength());
+	Kernel* kern = m.getKernel();
+	vector<vector<double>> h(n, vector<double>(kern->lengthHidden()));
+	for(size_t i = 0; i < n; ++i)
+		kern->initVariables(dh.get(i).x, m.getParameter().weights, dh.get(i).y, &h[i]);
+
+	const size_t chunk = 64;
+	vector<DataPointView> dps(n);
+	for(size_t i = 0; i < n; ++i)
+		dps[i] = dh.get(i);
+	vector<double> loss(n);
+	size_t mismatch = 0;
+	double tb = 0.0, tf = 0.0;
+	for(int it = 0; it < niter; ++it){
+		vector<double> grad(m.paramWidth(), 0.0);
+		Timer tmr;
+		for(size_t i = 0; i < n; i += chunk)
+			m.batchGradient(dps.data() + i, min(chunk, n - i), grad, loss.data() + i, h.data() + i);
+		double t = tmr.elapseSd();
+		tb += t;
+		// the full scan with the same parameter
+		tmr.restart();
+		size_t changed = 0;
+		double obj = 0.0;
+		for(size_t i = 0; i < n; ++i){
+			vector<double> p = m.predict(dps[i]);
+			if(p[0] != h[i][0] || abs(p[1] - loss[i]) > 1e-9 * (1 + p[1]))
+				++mismatch;
+			obj += p[1];
+		}
+		double t2 = tmr.elapseSd();
+		tf += t2;
+		for(size_t c = 0; c < k; ++c)
+			changed += grad[c * (d + 1) + d] > 0 ? static_cast<size_t>(grad[c * (d + 1) + d]) : 0;
+		m.accumulateParameter(grad);
+		cout << "iteration " << it << "\tobjective: " << obj << "\tmoved points: " << changed
+			<< "\ttime bounded: " << t << "\tfull scan: " << t2 << endl;
+		if(changed == 0)
+			break;
+	}
+	cout << "bounded: " << tb << "\tfull scan: " << tf << "\tmismatch: " << mismatch
+		<< (mismatch == 0 ? " ok" : " FAILED") << endl;
+	bool ok = mismatch == 0;
+
+	// the per-point calls, with the parameter checked on each call or once per pass.
+	// the parameter changes between the passes, so the fixed one comes last
+	for(bool fix : { false, true }){
+		vector<double> grad(m.paramWidth(), 0.0), pred;
+		size_t pm = 0;
+		Timer tmr;
+		if(fix)
+			m.fixParameter();
+		for(size_t i = 0; i < n; ++i)
+			loss[i] = m.lossAndGradient(dps[i], grad, &pred, &h[i]);
+		double t = tmr.elapseSd();
+		for(size_t i = 0; i < n; ++i){
+			vector<double> p = m.predict(dps[i]);
+			if(p[0] != h[i][0] || abs(p[1] - loss[i]) > 1e-9 * (1 + p[1]))
+				++pm;
+		}
+		m.accumulateParameter(grad);
+		ok &= pm == 0;
+		cout << "per point" << (fix ? ", fixed parameter: " : ": ") << t << "\tmismatch: " << pm
+			<< (pm == 0 ? " ok" : " FAILED") << endl;
+	}
+
+	// a negative rate adds the gradient, the top 10% of the points are trained in each iteration
+	Model mp;
+	mp.init("km", to_string(k) + "," + to_string(d), 0.0);
+	mp.checkData(dh.xlength(), dh.ylength());
+	PSGD psgd;
+	psgd.init({ "-1", "0.1", "0.01", "l", "l", "k" });
+	psgd.bindDataset(&dh);
+	psgd.bindModel(&mp);
+	psgd.prepare();
+	psgd.ready();
+	atomic_bool flag(true);
+	size_t trained = 0;
+	double ploss = 0.0;
+	for(int it = 0; it < 3; ++it){
+		Trainer::DeltaResult dr = psgd.batchDelta(flag, 0, n, false);
+		psgd.applyDelta(dr.delta);
+		trained += dr.n_reported;
+		ploss = dr.loss;
+	}
+	double count = 0.0;
+	for(size_t c = 0; c < k; ++c)
+		count += mp.getParameter().weights[c * (d + 1) + d];
+	bool fp = count == static_cast<double>(n + trained) && std::isfinite(ploss);
+	ok &= fp;
+	cout << "psgd: trained points: " << trained << "\tpoints in centers: " << count
+		<< "\tloss: " << ploss << (fp ? " ok" : " FAILED") << endl;
+	bool rejected = false;
+	try{
+		psgd.setDataOrder(DataOrder::Mode::Point, 1, 1);
+	} catch(invalid_argument&){
+		rejected = true;
+	}
+	ok &= rejected;
+	cout << "psgd: random order" << (rejected ? " rejected ok" : " accepted FAILED") << endl;
+
+	// the second pass uses the same parameter: no point moves, and the objective is the one of
+	// the first half of the points in the order
+	Model me;
+	me.init("km", to_string(k) + "," + to_string(d), 0.0);
+	me.checkData(dh.xlength(), dh.ylength());
+	EM_KMeans em;
+	em.bindDataset(&dh);
+	em.bindModel(&me);
+	em.prepare();
+	Trainer::DeltaResult d1 = em.batchDelta(flag, 0, n, false);
+	em.setDataOrder(DataOrder::Mode::Point, 1, 1);
+	Trainer::DeltaResult d2 = em.batchDelta(flag, 0, n / 2, false);
+	double moved = 0.0, expected = 0.0;
+	for(double v : d2.delta)
+		moved += abs(v);
+	for(size_t p = 0; p < n / 2; ++p)
+		expected += me.loss(dh.get(em.dataIndex(p)));
+	bool fo = d1.n_scanned == n && moved == 0.0 && abs(expected - d2.loss) <= 1e-9 * expected;
+	ok &= fo;
+	cout << "em-kmeans: random order objective: " << d2.loss << "\texpected: " << expected
+		<< "\tmoved: " << moved << (fo ? " ok" : " FAILED") << endl;
+	return ok ? 0 : 1;
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cmath>
+#include <algorithm>
 #include "logging/logging.h"
 #include "data/DataHolder.h"
 #include "model/Model.h"
@@ -79,8 +81,8 @@ int main(int argc, char* argv[]){
 	}
 	if(opt.doNormalize)
 		dh.normalize(false);
-	LOG(INFO) << "data[0]: " << dh.get(0).x << " -> " << dh.get(0).y;
-	LOG(INFO) << "data[1]: " << dh.get(1).x << " -> " << dh.get(1).y;
+	LOG(INFO) << "data[0]: " << dh.get(0).x.toVector() << " -> " << dh.get(0).y.toVector();
+	LOG(INFO) << "data[1]: " << dh.get(1).x.toVector() << " -> " << dh.get(1).y.toVector();
 
 	Model m;
 	if(!opt.fnData.empty()){
@@ -110,10 +112,30 @@ int main(int argc, char* argv[]){
 		diff += v * v;
 	}
 	LOG(INFO) << diff << "\t" << loss << endl;
+	// the batch version against the sum of the per-point ones
+	vector<double> gs(g.size(), 0.0), gb(g.size(), 0.0);
+	vector<DataPointView> dps;
+	for(size_t i = 0; i < dh.size(); ++i){
+		m.accumulateGradient(dh.get(i), gs);
+		dps.push_back(dh.get(i));
+	}
+	m.batchGradient(dps.data(), dps.size(), gb);
+	diff = 0.0;
+	double mx = 0.0;
+	for(size_t i = 0; i < gs.size(); ++i){
+		diff = max(diff, abs(gs[i] - gb[i]));
+		mx = max(mx, abs(gs[i]));
+	}
+	// the sums are done in another order
+	if(diff > 1e-10 * (1.0 + mx)){
+		LOG(ERROR) << "batch gradient difference: " << diff << " FAILED";
+		return 1;
+	}
+	LOG(INFO) << "batch gradient difference: " << diff << " ok";
 
 	LOG(INFO) << "start";
 	show(trainer.pm->getParameter().weights, {}, trainer.loss());
-	atomic_bool flag;
+	atomic_bool flag(true);
 	size_t p = 0;
 	for(int iter = 0; iter < opt.niter; ++iter){
 		LOG(INFO) << "Iteration: " << iter;
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <cmath>
+#include "model/impl/NodeBase.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// check the pooling nodes against a window scan, and time their forward and backward passes
+
+struct Case {
+	NodeType tmax, tmin;
+	vector<int> shape; // node shape
+	vector<int> in; // input shape
+};
+
+// reference: scan every window, the first winner in row-major order gets pre
+void reference(const Case& c, const bool isMax, const vector<double>& x, const vector<double>& pre,
+	vector<double>& y, vector<double>& dx)
+{
+	const size_t d = c.in.size();
+	vector<int> dim(c.in), k(c.shape.end() - d, c.shape.end()), on(d);
+	size_t ny = 1;
+	for(size_t i = 0; i < d; ++i){
+		on[i] = (dim[i] + k[i] - 1) / k[i];
+		ny *= on[i];
+	}
+	y.assign(ny, 0.0);
+	dx.assign(x.size(), 0.0);
+	for(size_t o = 0; o < ny; ++o){
+		vector<int> oi(d);
+		for(size_t i = d, t = o; i-- > 0; t /= on[i])
+			oi[i] = static_cast<int>(t % on[i]);
+		long best = -1;
+		vector<int> wi(d, 0);
+		while(true){
+			bool inside = true;
+			long idx = 0;
+			for(size_t i = 0; i < d; ++i){
+				int v = oi[i] * k[i] + wi[i];
+				inside &= v < dim[i];
+				idx = idx * dim[i] + v;
+			}
+			if(inside && (best < 0 || (isMax ? x[idx] > x[best] : x[idx] < x[best])))
+				best = idx;
+			size_t i = d;
+			while(i-- > 0 && ++wi[i] == k[i])
+				wi[i] = 0;
+			if(i == size_t(-1))
+				break;
+		}
+		y[o] = x[best];
+		dx[best] += pre[o];
+	}
+}
+
+bool run(const Case& c, const bool isMax, mt19937& gen, const int rep){
+	NodeBase* node = generateNode(isMax ? c.tmax : c.tmin, 0, c.shape);
+	node->setInputShape(c.in);
+	uniform_real_distribution<double> dis(-1.0, 1.0);
+	vector<double> x(node->nin), pre(node->nout), y(node->nout), dx(node->nin, 0.0), st(node->nst);
+	for(auto& v : x)
+		v = dis(gen);
+	for(auto& v : pre)
+		v = dis(gen);
+	vector<double> ry, rdx;
+	reference(c, isMax, x, pre, ry, rdx);
+	node->predict(x.data(), nullptr, y.data(), st.data());
+	node->gradient(nullptr, x.data(), nullptr, y.data(), pre.data(), dx.data(), st.data());
+	bool ok = y == ry && dx == rdx;
+	Timer tmr;
+	for(int r = 0; r < rep; ++r){
+		node->predict(x.data(), nullptr, y.data(), st.data());
+		node->gradient(nullptr, x.data(), nullptr, y.data(), pre.data(), dx.data(), st.data());
+	}
+	double t = tmr.elapseSd();
+	string s;
+	for(int v : c.shape)
+		s += to_string(v) + " ";
+	cout << (isMax ? "max " : "min ") << c.in.size() << "D shape: " << s << "\ttime: " << t
+		<< (ok ? " ok" : " FAILED") << endl;
+	delete node;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	int rep = argc > 1 ? stoi(argv[1]) : 1000;
+	mt19937 gen(1);
+	vector<Case> cases = {
+		{ NodeType::PoolMax1D, NodeType::PoolMin1D, { 3 }, { 20 } },
+		{ NodeType::PoolMax2D, NodeType::PoolMin2D, { 24, 24, 2, 2 }, { 24, 24 } }, // the 2x2 path
+		{ NodeType::PoolMax2D, NodeType::PoolMin2D, { 9, 10, 2, 2 }, { 9, 10 } },
+		{ NodeType::PoolMax2D, NodeType::PoolMin2D, { 24, 24, 3, 3 }, { 24, 24 } },
+		{ NodeType::PoolMax3D, NodeType::PoolMin3D, { 6, 5, 7, 2, 2, 3 }, { 6, 5, 7 } },
+	};
+	bool ok = true;
+	for(const Case& c : cases){
+		ok &= run(c, true, gen, rep);
+		ok &= run(c, false, gen, rep);
+	}
+	return ok ? 0 : 1;
+}
@@ -93,8 +93,8 @@ int main(int argc, char* argv[]){
 
 	if(opt.doNormalize)
 		dh.normalize(false);
-	LOG(INFO) << "data[0]: " << dh.get(0).x << " -> " << dh.get(0).y;
-	LOG(INFO) << "data[1]: " << dh.get(1).x << " -> " << dh.get(1).y;
+	LOG(INFO) << "data[0]: " << dh.get(0).x.toVector() << " -> " << dh.get(0).y.toVector();
+	LOG(INFO) << "data[1]: " << dh.get(1).x.toVector() << " -> " << dh.get(1).y.toVector();
 
 	vector<double> pred = m.predict(dh.get(0));
 	double loss = m.loss(pred, dh.get(0).y);
@@ -107,7 +107,7 @@ int main(int argc, char* argv[]){
 
 	LOG(INFO) << "start";
 	show(trainer.pm->getParameter().weights, {}, trainer.loss());
-	atomic_bool flag;
+	atomic_bool flag(true);
 	size_t p = 0;
 	for(int iter = 0; iter < opt.niter; ++iter){
 		LOG(INFO) << "Iteration: " << iter;
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <atomic>
+#include "data/DataHolder.h"
+#include "model/Model.h"
+#include "train/GD.h"
+#include "util/Timer.h"
+
+using namespace std;
+
+// compare the delta of a mini-batch computed by 1 thread and by <n> threads (one workspace each)
+
+struct Case {
+	string name;
+	string param;
+	size_t nx, ny;
+};
+
+bool run(const Case& c, const size_t npoint, const size_t nthread, const int rep){
+	mt19937 gen(1);
+	uniform_real_distribution<double> dis(-1.0, 1.0);
+	DataHolder dh(1, 0);
+	dh.setLength(c.nx, c.ny);
+	for(size_t i = 0; i < npoint; ++i){
+		vector<double> x(c.nx), y(c.ny);
+		for(auto& v : x)
+			v = dis(gen);
+		for(auto& v : y)
+			v = dis(gen) > 0 ? 1.0 : 0.0;
+		dh.add(move(x), move(y));
+	}
+	Model m;
+	m.init(c.name, c.param, 123456u);
+	m.checkData(dh.xlength(), dh.ylength());
+	GD trainer;
+	trainer.setRate(0.1);
+	trainer.bindDataset(&dh);
+	trainer.bindModel(&m);
+	trainer.prepare();
+
+	atomic_bool flag(true);
+	vector<double> d1, dn;
+	double t1 = 0.0, tn = 0.0;
+	for(int r = 0; r < rep; ++r){
+		trainer.setThreads(1);
+		Timer tmr;
+		d1 = trainer.batchDelta(flag, 0, npoint, true).delta;
+		t1 += tmr.elapseSd();
+		trainer.setThreads(nthread);
+		tmr.restart();
+		dn = trainer.batchDelta(flag, 0, npoint, true).delta;
+		tn += tmr.elapseSd();
+	}
+	// the sums are done in another order
+	double diff = 0.0, mx = 0.0;
+	for(size_t i = 0; i < d1.size(); ++i){
+		diff = max(diff, abs(d1[i] - dn[i]));
+		mx = max(mx, abs(d1[i]));
+	}
+	bool ok = d1.size() == dn.size() && diff <= 1e-12 * (1.0 + mx);
+	cout << c.name << "\t1 thread: " << t1 / rep << "\t" << nthread << " threads: " << tn / rep
+		<< "\tmax diff: " << diff << (ok ? " ok" : " FAILED") << endl;
+	return ok;
+}
+
+int main(int argc, char* argv[]){
+	size_t npoint = argc > 1 ? stoul(argv[1]) : 2000;
+	size_t nthread = argc > 2 ? stoul(argv[2]) : 4;
+	int rep = argc > 3 ? stoi(argv[3]) : 3;
+	vector<Case> cases = {
+		{ "lr", "20", 20, 1 },
+		{ "mlp", "20,16,8,1", 20, 1 },
+		{ "cnn", "12*12-3c3*3-max:2*2-2c2*2-1f", 144, 1 },
+	};
+	bool ok = true;
+	for(auto& c : cases)
+		ok &= run(c, npoint, nthread, rep);
+	return ok ? 0 : 1;
+}
@@ -66,7 +66,7 @@ void test_1m1w(DataHolder& dh){
 	trainer.bindDataset(&dh);
 	trainer.setRate(0.1);
 	vector<double> w_grad;
-	atomic_bool flag;
+	atomic_bool flag(true);
 
 	// start working
 	cout << "start working" << endl;
@@ -123,7 +123,7 @@ void test_1m2w(DataHolder& dh){
 	size_t nx = dh.xlength();
 	DummyNetwork net;
 	Runner m(dh), w1(dh), w2(dh);
-	atomic_bool flag;
+	atomic_bool flag(true);
 
 	// init of master
 	m.bf_param.init(nx, 0.05, 0.1, 0);
@@ -81,7 +81,7 @@ public:
 		trainer.bindDataset(&dh);
 	}
 	vector<double> getDalta(const size_t start, const size_t cnt){
-		atomic_bool flag;
+		atomic_bool flag(true);
 		bf_grad = trainer.batchDelta(flag, start, cnt, true).delta;
 		return bf_grad;
 	}
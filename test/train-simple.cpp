@@ -45,7 +45,7 @@ int main(int argc, char* argv[]){
 	trainer.bindDataset(&dh);
 	trainer.setRate(0.1);
 
-	atomic_bool flag;
+	atomic_bool flag(true);
 	for(int i = 0; i < 5; i++){
 		auto dr = trainer.batchDelta(flag, i * 500, 500);
 		trainer.applyDelta(dr.delta);
@@ -150,6 +150,8 @@ void test_worker(DataHolder& dh, const int nid){
 	conf.optimizer = "gd";
 	conf.optimizerParam = { "1" };
 	conf.mode = "sync";
+	conf.nThread = 1;
+	conf.float32 = false; // master_thread() sends the parameter in double
 	conf.adjustSpeedHetero = conf.adjustSpeedRandom = false;
 
 	if(nid == 0){